@@ -24,17 +24,469 @@
 DflowMapPass::DflowMapPass(Act *a,
                            const char *name,
                            Metrics *metrics,
-                           ChpBackend *backend) : ActPass(a, name) {
+                           ChpBackend *backend,
+                           bool collectFUs) : ActPass(a, name) {
   this->metrics = metrics;
+  mappingFingerprint =
+      metrics->validMetrics() ? metrics->getMappingFingerprint() : 0;
   this->backend = backend;
+  this->collectFUs = collectFUs;
+  procList = nullptr;
   _count = 0;
 }
 
 void *DflowMapPass::local_op(Process *p, int mode) {
   if (!p) return nullptr;
   if (!p->isExpanded() || !p->isDefined()) return nullptr;
-  auto proc_generator = new ProcGenerator(metrics, backend);
-  proc_generator->run(p);
-  _count++;
+  if (procList) {
+    procList->push_back(p);
+    return nullptr;
+  }
+  if (!GEN_NETLIST && collectFUs
+      && readProcCache(p, getProcFingerprint(p), nullptr, nullptr)) {
+    /* its FUs were characterized when it was mapped */
+    return nullptr;
+  }
+  if (!GEN_NETLIST && !collectFUs) {
+    mapCachedProcess(p);
+    _count++;
+    return nullptr;
+  }
+  ProcGenerator proc_generator(metrics, backend, collectFUs);
+  proc_generator.run(p);
+  if (!collectFUs) {
+    _count++;
+  }
   return nullptr;
 }
+
+static void writeString(FILE *fp, const String &str) {
+  size_t len = str.size();
+  fwrite(&len, sizeof(len), 1, fp);
+  fwrite(str.data(), 1, len, fp);
+}
+
+static bool readString(FILE *fp, String &str) {
+  size_t len;
+  if (fread(&len, sizeof(len), 1, fp) != 1) return false;
+  str.resize(len);
+  return fread(&str[0], 1, len, fp) == len;
+}
+
+static void writeChunks(FILE *fp, Vector<OutputChunk> &chunks) {
+  size_t numChunks = chunks.size();
+  fwrite(&numChunks, sizeof(numChunks), 1, fp);
+  for (auto &chunk: chunks) {
+    writeString(fp, chunk.key);
+    fwrite(&chunk.begin, sizeof(chunk.begin), 1, fp);
+    fwrite(&chunk.end, sizeof(chunk.end), 1, fp);
+  }
+}
+
+static bool readChunks(FILE *fp, Vector<OutputChunk> &chunks) {
+  size_t numChunks;
+  if (fread(&numChunks, sizeof(numChunks), 1, fp) != 1) return false;
+  chunks.resize(numChunks);
+  for (auto &chunk: chunks) {
+    if (!readString(fp, chunk.key)
+        || (fread(&chunk.begin, sizeof(chunk.begin), 1, fp) != 1)
+        || (fread(&chunk.end, sizeof(chunk.end), 1, fp) != 1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void writeCornerConfs(FILE *fp, Vector<CornerConf> &cornerConfs) {
+  size_t numConfs = cornerConfs.size();
+  fwrite(&numConfs, sizeof(numConfs), 1, fp);
+  for (auto &cornerConf: cornerConfs) {
+    writeString(fp, cornerConf.instance);
+    for (auto &conf: cornerConf.confs) {
+      writeString(fp, conf);
+    }
+  }
+}
+
+static bool readCornerConfs(FILE *fp, Vector<CornerConf> &cornerConfs) {
+  size_t numConfs;
+  if (fread(&numConfs, sizeof(numConfs), 1, fp) != 1) return false;
+  cornerConfs.resize(numConfs);
+  for (auto &cornerConf: cornerConfs) {
+    if (!readString(fp, cornerConf.instance)) return false;
+    cornerConf.confs.resize(num_corners - 1);
+    for (auto &conf: cornerConf.confs) {
+      if (!readString(fp, conf)) return false;
+    }
+  }
+  return true;
+}
+
+static void writeStatRecords(FILE *fp, Vector<StatRecord> &records) {
+  size_t numRecords = records.size();
+  fwrite(&numRecords, sizeof(numRecords), 1, fp);
+  for (auto &record: records) {
+    fwrite(&record.type, sizeof(record.type), 1, fp);
+    writeString(fp, record.instance);
+    fwrite(record.metric, sizeof(double), Metrics::metricSize(), fp);
+    fwrite(&record.bitwidth, sizeof(record.bitwidth), 1, fp);
+    fwrite(&record.numOutputs, sizeof(record.numOutputs), 1, fp);
+    writeString(fp, record.cycle);
+  }
+}
+
+static bool readStatRecords(FILE *fp, Vector<StatRecord> &records) {
+  size_t numRecords;
+  if (fread(&numRecords, sizeof(numRecords), 1, fp) != 1) return false;
+  records.resize(numRecords);
+  for (auto &record: records) {
+    if ((fread(&record.type, sizeof(record.type), 1, fp) != 1)
+        || !readString(fp, record.instance)
+        || (fread(record.metric, sizeof(double), Metrics::metricSize(), fp)
+            != Metrics::metricSize())
+        || (fread(&record.bitwidth, sizeof(record.bitwidth), 1, fp) != 1)
+        || (fread(&record.numOutputs, sizeof(record.numOutputs), 1, fp)
+            != 1)
+        || !readString(fp, record.cycle)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void writeInstances(FILE *fp, Vector<InstanceRecord> &instances) {
+  size_t numInstances = instances.size();
+  fwrite(&numInstances, sizeof(numInstances), 1, fp);
+  for (auto &record: instances) {
+    writeString(fp, record.process);
+    writeString(fp, record.instName);
+    writeString(fp, record.instance);
+    fwrite(record.energy, sizeof(double), num_corners, fp);
+    fwrite(&record.sendsPerToken, sizeof(record.sendsPerToken), 1, fp);
+    fwrite(&record.receivesPerToken, sizeof(record.receivesPerToken), 1, fp);
+  }
+}
+
+static bool readInstances(FILE *fp, Vector<InstanceRecord> &instances) {
+  size_t numInstances;
+  if (fread(&numInstances, sizeof(numInstances), 1, fp) != 1) return false;
+  instances.resize(numInstances);
+  for (auto &record: instances) {
+    if (!readString(fp, record.process)
+        || !readString(fp, record.instName)
+        || !readString(fp, record.instance)
+        || (fread(record.energy, sizeof(double), num_corners, fp)
+            != num_corners)
+        || (fread(&record.sendsPerToken, sizeof(record.sendsPerToken), 1, fp)
+            != 1)
+        || (fread(&record.receivesPerToken,
+                  sizeof(record.receivesPerToken), 1, fp) != 1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void writeMetricDeps(FILE *fp, StringMap<String> &metricDeps) {
+  size_t numDeps = metricDeps.size();
+  fwrite(&numDeps, sizeof(numDeps), 1, fp);
+  for (auto &metricDepsIt: metricDeps) {
+    writeString(fp, metricDepsIt.first);
+    writeString(fp, metricDepsIt.second);
+  }
+}
+
+static bool readMetricDeps(FILE *fp, StringMap<String> &metricDeps) {
+  size_t numDeps;
+  if (fread(&numDeps, sizeof(numDeps), 1, fp) != 1) return false;
+  for (size_t i = 0; i < numDeps; i++) {
+    String instance;
+    String lines;
+    if (!readString(fp, instance) || !readString(fp, lines)) return false;
+    metricDeps.insert({instance, lines});
+  }
+  return true;
+}
+
+static void writeProcOutput(FILE *fp,
+                            ProcOutput &procOutput,
+                            Vector<StatRecord> &statRecords) {
+  writeString(fp, procOutput.chp);
+  writeString(fp, procOutput.chpLib);
+  writeString(fp, procOutput.conf);
+  writeChunks(fp, procOutput.libChunks);
+  writeChunks(fp, procOutput.confChunks);
+  writeCornerConfs(fp, procOutput.cornerConfs);
+  writeInstances(fp, procOutput.instances);
+  writeStatRecords(fp, statRecords);
+}
+
+static bool readProcOutput(FILE *fp,
+                           ProcOutput &procOutput,
+                           Vector<StatRecord> &statRecords) {
+  return readString(fp, procOutput.chp)
+      && readString(fp, procOutput.chpLib)
+      && readString(fp, procOutput.conf)
+      && readChunks(fp, procOutput.libChunks)
+      && readChunks(fp, procOutput.confChunks)
+      && readCornerConfs(fp, procOutput.cornerConfs)
+      && readInstances(fp, procOutput.instances)
+      && readStatRecords(fp, statRecords);
+}
+
+uint64_t DflowMapPass::getProcFingerprint(Process *p) {
+  char *buf;
+  size_t len;
+  FILE *fp = open_memstream(&buf, &len);
+  if (!fp) {
+    printf("Fail to fingerprint process %s!\n", p->getName());
+    exit(-1);
+  }
+  fprintf(fp, "dflowmap procs v%d %s\n", DFLOWMAP_PROC_CACHE_VERSION,
+          LOGIC_OPTIMIZER ? "expropt" : "");
+  fprintf(fp, "metrics %016llx\n", (unsigned long long) mappingFingerprint);
+  fprintf(fp, "quiet %d cycle %.17g pipeline %d %.17g\n", quiet_mode,
+          target_cycle_time, pipeline_mode, pipeline_area_budget);
+  for (unsigned c = 0; c < num_corners; c++) {
+    fprintf(fp, "corner %s\n", corner_names[c]);
+  }
+  fprintf(fp, "process %s::%s\n", p->getns()->getName(), p->getName());
+  p->Print(fp);
+  fclose(fp);
+  uint64_t fingerprint = MetricsDB::hashName(buf, len);
+  free(buf);
+  return fingerprint;
+}
+
+/* the file of a process is named after the process, so that it is replaced
+ * when the process changes */
+String DflowMapPass::getProcCacheFile(Process *p) {
+  String name = String(p->getns()->getName()) + "::" + p->getName();
+  char file[32];
+  sprintf(file, "/%016llx.proc",
+          (unsigned long long) MetricsDB::hashName(name.c_str(), name.size()));
+  return String(proc_cache_dir) + file;
+}
+
+bool DflowMapPass::readProcCache(Process *p,
+                                 uint64_t fingerprint,
+                                 ProcOutput *procOutput,
+                                 Vector<StatRecord> *statRecords) {
+  FILE *fp = fopen(getProcCacheFile(p).c_str(), "rb");
+  if (!fp) {
+    return false;
+  }
+  uint64_t magic;
+  uint64_t cachedFingerprint;
+  StringMap<String> metricDeps;
+  ProcOutput cachedOutput;
+  Vector<StatRecord> cachedRecords;
+  bool hit = (fread(&magic, sizeof(magic), 1, fp) == 1)
+      && (magic == PROC_CACHE_MAGIC)
+      && (fread(&cachedFingerprint, sizeof(cachedFingerprint), 1, fp) == 1)
+      && (cachedFingerprint == fingerprint)
+      && readMetricDeps(fp, metricDeps)
+      && metrics->checkMetricDeps(metricDeps)
+      && (!procOutput || readProcOutput(fp, cachedOutput, cachedRecords));
+  fclose(fp);
+  if (hit && procOutput) {
+    *procOutput = std::move(cachedOutput);
+    statRecords->swap(cachedRecords);
+  }
+  if (debug_verbose) {
+    printf("process %s %s the process cache\n", p->getName(),
+           hit ? "hits" : "misses");
+  }
+  return hit;
+}
+
+void DflowMapPass::writeProcCache(Process *p,
+                                  uint64_t fingerprint,
+                                  StringMap<String> &metricDeps,
+                                  ProcOutput &procOutput,
+                                  Vector<StatRecord> &statRecords) {
+  char *buf;
+  size_t len;
+  FILE *fp = open_memstream(&buf, &len);
+  if (!fp) {
+    printf("Fail to create the process cache entry of %s!\n", p->getName());
+    exit(-1);
+  }
+  uint64_t magic = PROC_CACHE_MAGIC;
+  fwrite(&magic, sizeof(magic), 1, fp);
+  fwrite(&fingerprint, sizeof(fingerprint), 1, fp);
+  writeMetricDeps(fp, metricDeps);
+  writeProcOutput(fp, procOutput, statRecords);
+  fclose(fp);
+  writeFileAtomic(getProcCacheFile(p).c_str(), String(buf, len),
+                  "Fail to update the process cache");
+  free(buf);
+}
+
+/* map every numJobs-th process of dirtyProcs (starting from "worker") into
+ * memory buffers, and write the buffers, the statistics updates and the
+ * metric deps of each of them into resultFp */
+void DflowMapPass::mapProcess(Process *p,
+                              ProcOutput &procOutput,
+                              Vector<StatRecord> &statRecords,
+                              StringMap<String> &metricDeps) {
+  char *chpBuf, *chpLibBuf, *confBuf;
+  size_t chpLen, chpLibLen, confLen;
+  FILE *chpFp = open_memstream(&chpBuf, &chpLen);
+  FILE *chpLibFp = open_memstream(&chpLibBuf, &chpLibLen);
+  FILE *confFp = open_memstream(&confBuf, &confLen);
+  if (!chpFp || !chpLibFp || !confFp) {
+    printf("Fail to create output buffers for process %s!\n", p->getName());
+    exit(-1);
+  }
+  backend->redirectOutput(chpFp, chpLibFp, confFp);
+  metrics->recordStatistics(&statRecords);
+  metrics->recordMetricDeps(&metricDeps);
+  ProcGenerator proc_generator(metrics, backend);
+  proc_generator.run(p);
+  metrics->recordStatistics(nullptr);
+  metrics->recordMetricDeps(nullptr);
+  backend->restoreOutput();
+  fclose(chpFp);
+  fclose(chpLibFp);
+  fclose(confFp);
+  procOutput.chp = String(chpBuf, chpLen);
+  procOutput.chpLib = String(chpLibBuf, chpLibLen);
+  procOutput.conf = String(confBuf, confLen);
+  backend->collectChunks(procOutput);
+  free(chpBuf);
+  free(chpLibBuf);
+  free(confBuf);
+}
+
+void DflowMapPass::mapCachedProcess(Process *p) {
+  uint64_t fingerprint = getProcFingerprint(p);
+  ProcOutput procOutput;
+  Vector<StatRecord> statRecords;
+  if (!readProcCache(p, fingerprint, &procOutput, &statRecords)) {
+    StringMap<String> metricDeps;
+    mapProcess(p, procOutput, statRecords, metricDeps);
+    writeProcCache(p, fingerprint, metricDeps, procOutput, statRecords);
+  } else if (debug_verbose) {
+    printf("Reuse process %s\n", p->getName());
+  }
+  backend->appendOutput(procOutput);
+  metrics->replayStatistics(statRecords);
+}
+
+void DflowMapPass::mapProcesses(Vector<Process *> &procs,
+                                UIntVec &dirtyProcs,
+                                unsigned worker,
+                                unsigned numJobs,
+                                FILE *resultFp) {
+  for (unsigned j = worker; j < dirtyProcs.size(); j += numJobs) {
+    unsigned i = dirtyProcs[j];
+    ProcOutput procOutput;
+    Vector<StatRecord> statRecords;
+    StringMap<String> metricDeps;
+    mapProcess(procs[i], procOutput, statRecords, metricDeps);
+    fwrite(&i, sizeof(i), 1, resultFp);
+    writeMetricDeps(resultFp, metricDeps);
+    writeProcOutput(resultFp, procOutput, statRecords);
+  }
+}
+
+/* Take the output of the processes that have not changed since the last run
+ * from the process cache, map the others in forked workers and cache their
+ * output, then merge the outputs and statistics in the order a serial run
+ * would have generated them. A process is unchanged if its fingerprint is,
+ * and if every metric it looked up resolves to the same line of the metric
+ * files. The metrics a worker generates come back as statistics records,
+ * and only the parent writes them to the local metric file. Not for the
+ * netlist backend, which writes its own files directly. */
+void DflowMapPass::runParallel(Process *p, unsigned numJobs) {
+  Vector<Process *> procs;
+  procList = &procs;
+  run(p);
+  procList = nullptr;
+  unsigned numProcs = procs.size();
+  _count = numProcs;
+  Vector<ProcOutput> procOutputs(numProcs);
+  Vector<Vector<StatRecord>> procStatRecords(numProcs);
+  Vector<StringMap<String>> procMetricDeps(numProcs);
+  Vector<uint64_t> fingerprints(numProcs);
+  UIntVec dirtyProcs;
+  for (unsigned i = 0; i < numProcs; i++) {
+    fingerprints[i] = getProcFingerprint(procs[i]);
+    if (!readProcCache(procs[i],
+                       fingerprints[i],
+                       &procOutputs[i],
+                       &procStatRecords[i])) {
+      dirtyProcs.push_back(i);
+    }
+  }
+  unsigned numDirty = dirtyProcs.size();
+  if (numJobs > numDirty) {
+    numJobs = numDirty;
+  }
+  if (debug_verbose) {
+    printf("Reuse %u processes, map %u processes with %u jobs\n",
+           numProcs - numDirty, numDirty, numJobs);
+  }
+  /* nothing buffered in the parent may be written again by a worker, and
+   * no writer thread may hold a lock while forking */
+  fflush(nullptr);
+  metrics->flushMetricFiles();
+  OutputStream::suspendAll();
+  Vector<pid_t> workers;
+  Vector<FILE *> resultFps;
+  for (unsigned worker = 0; worker < numJobs; worker++) {
+    FILE *resultFp = tmpfile();
+    if (!resultFp) {
+      printf("Fail to create the result file for mapping worker %u!\n",
+             worker);
+      exit(-1);
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+      printf("Fail to fork mapping worker %u!\n", worker);
+      exit(-1);
+    }
+    if (pid == 0) {
+      mapProcesses(procs, dirtyProcs, worker, numJobs, resultFp);
+      metrics->flushMetricFiles();
+      fflush(resultFp);
+      fflush(stdout);
+      _exit(0);
+    }
+    workers.push_back(pid);
+    resultFps.push_back(resultFp);
+  }
+  for (unsigned worker = 0; worker < numJobs; worker++) {
+    int status;
+    waitpid(workers[worker], &status, 0);
+    if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+      printf("Mapping worker %u failed!\n", worker);
+      exit(-1);
+    }
+    FILE *resultFp = resultFps[worker];
+    rewind(resultFp);
+    unsigned i;
+    while (fread(&i, sizeof(i), 1, resultFp) == 1) {
+      if ((i >= numProcs)
+          || !readMetricDeps(resultFp, procMetricDeps[i])
+          || !readProcOutput(resultFp, procOutputs[i], procStatRecords[i])) {
+        printf("Corrupted result from mapping worker %u!\n", worker);
+        exit(-1);
+      }
+    }
+    fclose(resultFp);
+  }
+  OutputStream::resumeAll();
+  for (auto &i: dirtyProcs) {
+    writeProcCache(procs[i],
+                   fingerprints[i],
+                   procMetricDeps[i],
+                   procOutputs[i],
+                   procStatRecords[i]);
+  }
+  for (unsigned i = 0; i < numProcs; i++) {
+    backend->appendOutput(procOutputs[i]);
+    metrics->replayStatistics(procStatRecords[i]);
+  }
+}
@@ -23,19 +23,70 @@
 #define DFLOWMAP_SRC_DFLOWMAPPASS_H_
 
 #include <act/act.h>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "src/core/ProcGenerator.h"
 
+#define PROC_CACHE_MAGIC 0x33435052504d4644ULL
+
 class DflowMapPass : public ActPass {
  public:
-  DflowMapPass(Act *a, const char *name, Metrics *metrics, ChpBackend *backend);
+  DflowMapPass(Act *a,
+               const char *name,
+               Metrics *metrics,
+               ChpBackend *backend,
+               bool collectFUs = false);
 
   int numTranslated() { return _count; }
 
+  void runParallel(Process *p, unsigned numJobs);
+
  private:
   Metrics *metrics;
+  /* see Metrics::getMappingFingerprint */
+  uint64_t mappingFingerprint;
   ChpBackend *backend;
+  bool collectFUs;
+  /* if not null, local_op only records the processes to map */
+  Vector<Process *> *procList;
   void *local_op(Process *p, int mode);
 
+  /* map the process into buffers, recording its statistics and metric deps
+   * instead of applying them */
+  void mapProcess(Process *p,
+                  ProcOutput &procOutput,
+                  Vector<StatRecord> &statRecords,
+                  StringMap<String> &metricDeps);
+
+  /* take the output of the process from the process cache if it has not
+   * changed since the last run, or map it and cache its output */
+  void mapCachedProcess(Process *p);
+
+  void mapProcesses(Vector<Process *> &procs,
+                    UIntVec &dirtyProcs,
+                    unsigned worker,
+                    unsigned numJobs,
+                    FILE *resultFp);
+
+  /* hash of everything the output of the process depends on, besides the
+   * metrics it looks up */
+  uint64_t getProcFingerprint(Process *p);
+
+  String getProcCacheFile(Process *p);
+
+  /* read the output of the process from the process cache if it is up to
+   * date; with procOutput == nullptr, only check that it is */
+  bool readProcCache(Process *p,
+                     uint64_t fingerprint,
+                     ProcOutput *procOutput,
+                     Vector<StatRecord> *statRecords);
+
+  void writeProcCache(Process *p,
+                      uint64_t fingerprint,
+                      StringMap<String> &metricDeps,
+                      ProcOutput &procOutput,
+                      Vector<StatRecord> &statRecords);
+
   int _count;
 };
 
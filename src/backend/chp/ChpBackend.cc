@@ -45,6 +45,8 @@ void ChpBackend::printCopyProcs(double *metric,
 #endif
                                 unsigned numOut) {
   chpGenerator->printCopyChp(instance, inName);
+  /* a copy logs one line per output */
+  recordInstances(metric, numOut);
   chpLibGenerator->printCopyChpLib(instance, metric, numOut);
 #if GEN_NETLIST
   dflowNetBackend->printCopyNetlist(inName, bw, numOut, 1, 1);
@@ -59,6 +61,7 @@ void ChpBackend::printSink(
     const char *instance,
     const char *inName) {
   chpGenerator->printSinkChp(instance, inName);
+  recordInstances(metric, 1);
   chpLibGenerator->printSinkChpLib(instance, metric);
 #if GEN_NETLIST
   dflowNetBackend->printSinkNetlist(inName, bw);
@@ -66,7 +69,18 @@ void ChpBackend::printSink(
 }
 
 void ChpBackend::printBuff(Vector<BuffInfo> &buffInfos) {
-  chpGenerator->printBuffChp(buffInfos);
+  for (auto &buffInfo: buffInfos) {
+    Vector<BuffInfo> stage = {buffInfo};
+    chpGenerator->printBuffChp(stage);
+    /* the metric covers the whole chain; split it evenly over its stages */
+    double stageMetric[4 * MAX_CORNERS] = {0};
+    if (buffInfo.metric && buffInfo.nBuff) {
+      for (unsigned c = 0; c < num_corners; c++) {
+        stageMetric[4 * c + 1] = buffInfo.metric[4 * c + 1] / buffInfo.nBuff;
+      }
+    }
+    recordInstances(stageMetric, 1);
+  }
   chpLibGenerator->printBuffChpLib(buffInfos);
 #if GEN_NETLIST
   dflowNetBackend->printBuffNetlist(buffInfos, 1, 1);
@@ -89,6 +103,7 @@ void ChpBackend::printSource(
     const char *instance,
     const char *outName) {
   chpGenerator->printSourceChp(instance, outName);
+  recordInstances(metric, 1);
   chpLibGenerator->printSourceChpLib(instance, metric);
 #if GEN_NETLIST
   dflowNetBackend->printSourceNetlist(outName, val, bw);
@@ -115,6 +130,8 @@ void ChpBackend::printFU(
 #else
   chpGenerator->printFUChp(instance, argList, outList, buffInfos);
 #endif
+  /* the FU logs a receive and a send per token; see printFUChpLib */
+  recordInstances(metric, 1, 1);
   unsigned numArgs = argList.size();
   unsigned numOuts = outList.size();
 
@@ -164,6 +181,7 @@ void ChpBackend::printSplit(double *metric,
                             const char *instance,
 #if GEN_NETLIST
     unsigned guardBW,
+    bool pipelined,
 #endif
                             const char *splitName,
                             const char *guardName,
@@ -177,32 +195,33 @@ void ChpBackend::printSplit(double *metric,
                               inputName,
                               dataBW,
                               outNameVec);
+  recordInstances(metric, 1);
   chpLibGenerator->printSplitChpLib(instance, metric, numOutputs);
 #if GEN_NETLIST
   unsigned ADDR = 1;
-#if PIPELINE
-  unsigned C_CD = 1;
-  unsigned C_PW = 1;
-  unsigned D_CD = 1;
-  unsigned D_PW = 1;
-  dflowNetBackend->printPipeSplitNetlist(splitName,
-                                         C_CD,
-                                         C_PW,
-                                         ADDR,
-                                         D_CD,
-                                         D_PW,
-                                         numOutputs,
-                                         guardBW,
-                                         dataBW);
-#else
-  unsigned PD = 1;
-  dflowNetBackend->printUnpipeSplitNetlist(splitName,
+  if (pipelined) {
+    unsigned C_CD = 1;
+    unsigned C_PW = 1;
+    unsigned D_CD = 1;
+    unsigned D_PW = 1;
+    dflowNetBackend->printPipeSplitNetlist(splitName,
+                                           C_CD,
+                                           C_PW,
                                            ADDR,
-                                           PD,
+                                           D_CD,
+                                           D_PW,
                                            numOutputs,
                                            guardBW,
                                            dataBW);
-#endif
+  } else {
+    unsigned PD = 1;
+    dflowNetBackend->printUnpipeSplitNetlist(splitName,
+                                             ADDR,
+                                             PD,
+                                             numOutputs,
+                                             guardBW,
+                                             dataBW);
+  }
 #endif
 }
 
@@ -210,6 +229,7 @@ void ChpBackend::printMerge(double *metric,
                             const char *instance,
 #if GEN_NETLIST
     unsigned guardBW,
+    bool pipelined,
 #endif
                             const char *outName,
                             const char *guardName,
@@ -220,33 +240,34 @@ void ChpBackend::printMerge(double *metric,
                               guardName,
                               dataBW,
                               inNameVec);
+  recordInstances(metric, 1);
   chpLibGenerator->printMergeChpLib(instance, metric);
 #if GEN_NETLIST
   size_t numInputs = inNameVec.size();
   unsigned ADDR = 1;
-#if PIPELINE
-  unsigned C_CD = 1;
-  unsigned D_CD = 1;
-  unsigned PW = 1;
-  unsigned SEL = 1;
-  dflowNetBackend->printPipeMergeNetlist(outName,
-                                         C_CD,
-                                         D_CD,
-                                         PW,
-                                         ADDR,
-                                         SEL,
-                                         numInputs,
-                                         guardBW,
-                                         dataBW);
-#else
-  unsigned PD = 1;
-  dflowNetBackend->printUnpipeMergeNetlist(outName,
+  if (pipelined) {
+    unsigned C_CD = 1;
+    unsigned D_CD = 1;
+    unsigned PW = 1;
+    unsigned SEL = 1;
+    dflowNetBackend->printPipeMergeNetlist(outName,
+                                           C_CD,
+                                           D_CD,
+                                           PW,
                                            ADDR,
-                                           PD,
+                                           SEL,
                                            numInputs,
                                            guardBW,
                                            dataBW);
-#endif
+  } else {
+    unsigned PD = 1;
+    dflowNetBackend->printUnpipeMergeNetlist(outName,
+                                             ADDR,
+                                             PD,
+                                             numInputs,
+                                             guardBW,
+                                             dataBW);
+  }
 #endif
 }
 
@@ -254,6 +275,7 @@ void ChpBackend::printMixer(double *metric,
                             const char *instance,
 #if GEN_NETLIST
     unsigned guardBW,
+    bool pipelined,
 #endif
                             const char *outName,
                             const char *coutName,
@@ -264,27 +286,28 @@ void ChpBackend::printMixer(double *metric,
                               coutName,
                               dataBW,
                               inNameVec);
+  recordInstances(metric, 1);
   chpLibGenerator->printMixerChpLib(instance, metric);
 #if GEN_NETLIST
   size_t numInputs = inNameVec.size();
   unsigned ADDR = 1;
-#if PIPELINE
-  unsigned D_CD = 1;
-  unsigned D_PW = 1;
-  dflowNetBackend->printPipeMixerNetlist(outName,
-                                         ADDR,
-                                         D_CD,
-                                         D_PW,
-                                         numInputs,
-                                         dataBW,
-                                         guardBW);
-#else
-  dflowNetBackend->printUnpipeMixerNetlist(outName,
+  if (pipelined) {
+    unsigned D_CD = 1;
+    unsigned D_PW = 1;
+    dflowNetBackend->printPipeMixerNetlist(outName,
                                            ADDR,
+                                           D_CD,
+                                           D_PW,
                                            numInputs,
                                            dataBW,
                                            guardBW);
-#endif
+  } else {
+    dflowNetBackend->printUnpipeMixerNetlist(outName,
+                                             ADDR,
+                                             numInputs,
+                                             dataBW,
+                                             guardBW);
+  }
 #endif
 }
 
@@ -292,6 +315,7 @@ void ChpBackend::printArbiter(double *metric,
                               const char *instance,
 #if GEN_NETLIST
     unsigned guardBW,
+    bool pipelined,
 #endif
                               const char *outName,
                               const char *coutName,
@@ -302,24 +326,26 @@ void ChpBackend::printArbiter(double *metric,
                                 coutName,
                                 dataBW,
                                 inNameVec);
+  recordInstances(metric, 1);
   chpLibGenerator->printArbiterChpLib(instance, metric);
 #if GEN_NETLIST
   size_t numInputs = inNameVec.size();
-#if PIPELINE
-  dflowNetBackend->printPipeArbiterNetlist(outName,
-                                           dataBW,
-                                           guardBW,
-                                           numInputs);
-#else
-  dflowNetBackend->printUnpipeArbiterNetlist(outName,
+  if (pipelined) {
+    dflowNetBackend->printPipeArbiterNetlist(outName,
                                              dataBW,
                                              guardBW,
                                              numInputs);
-#endif
+  } else {
+    dflowNetBackend->printUnpipeArbiterNetlist(outName,
+                                               dataBW,
+                                               guardBW,
+                                               numInputs);
+  }
 #endif
 }
 
 void ChpBackend::printProcHeader(Process *p) {
+  curProcess = p->getName();
   chpGenerator->printProcChpHeader(p);
 #if GEN_NETLIST
   dflowNetBackend->printProcNetListHeader(p);
@@ -344,11 +370,12 @@ void ChpBackend::createChpBlock(Process *p, int where) {
 #endif  
 }
 
-void ChpBackend::printCustomNamespace(ActNamespace *ns) {
+void ChpBackend::printCustomNamespace(ActNamespace *ns,
+                                      Map<Process *, double *> &memMetrics) {
   auto stdNS = ActNamespace::Global()->findNS(Constant::STD_NAMESPACE);
   if (ns == stdNS) return;
   chpGenerator->printCustomNamespace(ns);
-  chpLibGenerator->printCustomNamespace(ns);
+  chpLibGenerator->printCustomNamespace(ns, memMetrics);
 }
 
 void ChpBackend::printFileEnding() {
@@ -358,3 +385,50 @@ void ChpBackend::printFileEnding() {
   dflowNetBackend->printNetlistFileEnding();
 #endif
 }
+
+void ChpBackend::redirectOutput(FILE *chpFp, FILE *chpLibFp, FILE *confFp) {
+  chpGenerator->redirectOutput(chpFp);
+  chpLibGenerator->redirectOutput(chpLibFp, chpFp, confFp);
+}
+
+void ChpBackend::restoreOutput() {
+  chpGenerator->restoreOutput();
+  chpLibGenerator->restoreOutput();
+}
+
+void ChpBackend::collectChunks(ProcOutput &procOutput) {
+  procOutput.libChunks = chpLibGenerator->getLibChunks();
+  procOutput.confChunks = chpLibGenerator->getConfChunks();
+  procOutput.cornerConfs = chpLibGenerator->getCornerConfs();
+  procOutput.instances.swap(instanceRecords);
+  instanceRecords.clear();
+}
+
+void ChpBackend::appendOutput(ProcOutput &procOutput) {
+  chpGenerator->appendOutput(procOutput.chp);
+  chpLibGenerator->appendOutput(procOutput.chpLib,
+                                procOutput.libChunks,
+                                procOutput.conf,
+                                procOutput.confChunks,
+                                procOutput.cornerConfs);
+  instanceRecords.insert(instanceRecords.end(),
+                         procOutput.instances.begin(),
+                         procOutput.instances.end());
+}
+
+void ChpBackend::recordInstances(double *metric,
+                                 unsigned sendsPerToken,
+                                 unsigned receivesPerToken) {
+  for (auto &newInstance: chpGenerator->takeInstances()) {
+    InstanceRecord record;
+    record.process = curProcess;
+    record.instName = newInstance.first;
+    record.instance = newInstance.second;
+    for (unsigned c = 0; c < num_corners; c++) {
+      record.energy[c] = metric ? metric[4 * c + 1] : 0;
+    }
+    record.sendsPerToken = sendsPerToken;
+    record.receivesPerToken = receivesPerToken;
+    instanceRecords.push_back(record);
+  }
+}
@@ -28,6 +28,18 @@
 #if GEN_NETLIST
 #include <act/dflow/backend/netlist/DflowNetBackend.h>
 #endif
+
+/* CHP output of one process, mapped into memory buffers by a worker */
+typedef struct procOutput {
+  String chp;
+  String chpLib;
+  String conf;
+  Vector<OutputChunk> libChunks;
+  Vector<OutputChunk> confChunks;
+  Vector<CornerConf> cornerConfs;
+  Vector<InstanceRecord> instances;
+} ProcOutput;
+
 class ChpBackend {
  public:
 #if GEN_NETLIST
@@ -89,6 +101,7 @@ class ChpBackend {
                   const char *instance,
 #if GEN_NETLIST
                   unsigned guardBW,
+                  bool pipelined,
 #endif
                   const char *splitName,
                   const char *guardName,
@@ -100,6 +113,7 @@ class ChpBackend {
                   const char *instance,
 #if GEN_NETLIST
                   unsigned guardBW,
+                  bool pipelined,
 #endif
                   const char *outName,
                   const char *guardName,
@@ -110,6 +124,7 @@ class ChpBackend {
                   const char *instance,
 #if GEN_NETLIST
                   unsigned guardBW,
+                  bool pipelined,
 #endif
                   const char *outName,
                   const char *coutName,
@@ -120,6 +135,7 @@ class ChpBackend {
                     const char *instance,
 #if GEN_NETLIST
                     unsigned guardBW,
+                    bool pipelined,
 #endif
                     const char *outName,
                     const char *coutName,
@@ -134,13 +150,33 @@ class ChpBackend {
 
   void createChpBlock(Process *p, int where);
 
-  void printCustomNamespace(ActNamespace *ns);
+  void printCustomNamespace(ActNamespace *ns,
+                            Map<Process *, double *> &memMetrics);
 
   void printFileEnding();
 
+  void redirectOutput(FILE *chpFp, FILE *chpLibFp, FILE *confFp);
+
+  void restoreOutput();
+
+  void collectChunks(ProcOutput &procOutput);
+
+  void appendOutput(ProcOutput &procOutput);
+
+  Vector<InstanceRecord> &getInstanceRecords() { return instanceRecords; }
+
  private:
   ChpGenerator *chpGenerator;
   ChpLibGenerator *chpLibGenerator;
+  /* the process being printed */
+  String curProcess;
+  /* the instances printed so far, in the order they are printed */
+  Vector<InstanceRecord> instanceRecords;
+
+  /* record the instances printed by the last call of chpGenerator */
+  void recordInstances(double *metric,
+                       unsigned sendsPerToken,
+                       unsigned receivesPerToken = 0);
 #if GEN_NETLIST
   DflowNetBackend *dflowNetBackend;
 #endif
@@ -28,6 +28,7 @@ void ChpGenerator::printSinkChp(const char *instance, const char *inName) {
   }
   const char *normalizedName = getNormActIdName(inName);
   fprintf(chpFp, "%s %s_sink(%s);\n", instance, normalizedName, inName);
+  recordInstance(instance, String(normalizedName) + "_sink");
 }
 
 void ChpGenerator::printCopyChp(const char *instance,
@@ -38,11 +39,23 @@ void ChpGenerator::printCopyChp(const char *instance,
           instance,
           normOutName,
           inputName);
+  recordInstance(instance, String(normOutName) + "copy");
   if (debug_verbose) {
     printf("[copy] %scopy\n", normOutName);
   }
 }
 
+void ChpGenerator::recordInstance(const char *instance,
+                                  const String &instName) {
+  newInstances.emplace_back(instName, instance);
+}
+
+Vector<Pair<String, String>> ChpGenerator::takeInstances() {
+  Vector<Pair<String, String>> res;
+  res.swap(newInstances);
+  return res;
+}
+
 void ChpGenerator::printEmptyLine() {
   fprintf(chpFp, "\n");
 }
@@ -57,6 +70,7 @@ void ChpGenerator::printInitChp(const char *instance,
           normOutput,
           inName,
           outName);
+  recordInstance(instance, String(normOutput) + "_inst");
   if (debug_verbose) {
     printf("[buff] %s_init\n", outName);
   }
@@ -71,6 +85,7 @@ void ChpGenerator::printOneBuffChp(const char *instance,
           outName,
           inName,
           outName);
+  recordInstance(instance, String(outName) + "_inst");
   if (debug_verbose) {
     printf("[buff] %s_init\n", outName);
   }
@@ -85,6 +100,7 @@ void ChpGenerator::printSourceChp(const char *instance,
                                   const char *outName) {
   const char *normOutName = getNormActIdName(outName);
   fprintf(chpFp, "%s %s_inst(%s);\n", instance, normOutName, outName);
+  recordInstance(instance, String(normOutName) + "_inst");
 }
 
 void ChpGenerator::printBuffChp(Vector<BuffInfo> &buffInfos) {
@@ -94,19 +110,19 @@ void ChpGenerator::printBuffChp(Vector<BuffInfo> &buffInfos) {
     unsigned long nBuff = buffInfo.nBuff;
     unsigned long initVal = buffInfo.initVal;
     bool hasInitVal = buffInfo.hasInitVal;
-    char *prevInName = new char[strlen(finalOutput) + 7];
+    char *prevInName = newScratchChars(strlen(finalOutput) + 7);
     sprintf(prevInName, "%s_bufIn", finalOutput);
-    char *onebufInstance = new char[1024];
+    char *onebufInstance = newScratchChars(1024);
     sprintf(onebufInstance, "onebuf<%u>", bw);
     for (unsigned i = 0; i < nBuff - 1; i++) {
-      char *chanName = new char[strlen(finalOutput) + 1024];
+      char *chanName = newScratchChars(strlen(finalOutput) + 1024);
       sprintf(chanName, "%s_buf%u", finalOutput, i);
       printChannelChp(chanName, bw);
       printOneBuffChp(onebufInstance, prevInName, chanName);
       prevInName = chanName;
     }
     if (hasInitVal) {
-      char *initProcName = new char[1024];
+      char *initProcName = newScratchChars(1024);
       sprintf(initProcName, "init<%lu,%u>", initVal, bw);
       printInitChp(initProcName, prevInName, finalOutput);
     } else {
@@ -128,7 +144,7 @@ const char *ChpGenerator::printFUChp(const char *instance,
       exit(-1);
     }
     size_t len = strlen(output);
-    char *actualOut = new char[7 + len];
+    char *actualOut = newScratchChars(7 + len);
     sprintf(actualOut, "%s_bufIn", output);
     unsigned bw = buffInfo.bw;
     printChannelChp(actualOut, bw);
@@ -148,8 +164,8 @@ const char *ChpGenerator::printFUChp(const char *instance,
   for (unsigned i = 0; i < numOuts; i++) {
     const char *oriOut = outList[i].c_str();
     const char *normOut = getNormActIdName(oriOut);
-    char *actualOut = new char[7 + strlen(oriOut)];
-    char *actualNormOut = new char[7 + strlen(normOut)];
+    char *actualOut = newScratchChars(7 + strlen(oriOut));
+    char *actualNormOut = newScratchChars(7 + strlen(normOut));
     if (hasInVector<unsigned>(buffOutIDs, i)) {
       sprintf(actualOut, "%s_bufIn", oriOut);
       sprintf(actualNormOut, "%s_bufIn", normOut);
@@ -162,14 +178,18 @@ const char *ChpGenerator::printFUChp(const char *instance,
   }
   fprintf(chpFp, "%s ", instance);
   /* calculate instance name */
-  char *instOutCollect = new char[MAX_INSTANCE_LEN];
+  size_t instOutLen = 1;
+  for (auto &normOutput: normOutputVec) {
+    instOutLen += 1 + strlen(normOutput);
+  }
+  char *instOutCollect = newScratchChars(instOutLen);
   instOutCollect[0] = '\0';
   for (auto &normOutput: normOutputVec) {
-    char *subInstName = new char[2 + strlen(normOutput)];
+    char *subInstName = newScratchChars(2 + strlen(normOutput));
     sprintf(subInstName, "%s_", normOutput);
     strcat(instOutCollect, subInstName);
   }
-  char *fuInstName = new char[5 + strlen(instOutCollect)];
+  char *fuInstName = newScratchChars(5 + strlen(instOutCollect));
   sprintf(fuInstName, "%sinst", instOutCollect);
   if (debug_verbose) {
     printf("[fu]: %s\n", fuInstName);
@@ -188,6 +208,7 @@ const char *ChpGenerator::printFUChp(const char *instance,
       fprintf(chpFp, ", ");
     }
   }
+  recordInstance(instance, fuInstName);
   return fuInstName;
 }
 
@@ -209,6 +230,7 @@ void ChpGenerator::printSplitChp(const char *instance,
           guardName,
           inputName,
           splitName);
+  recordInstance(instance, splitName);
 }
 
 void ChpGenerator::printMergeChp(const char *instance,
@@ -229,6 +251,7 @@ void ChpGenerator::printMergeChp(const char *instance,
           guardStr,
           normOutput,
           outName);
+  recordInstance(instance, String(normOutput) + "_inst");
 }
 
 void ChpGenerator::printArbiterChp(const char *instance,
@@ -249,6 +272,7 @@ void ChpGenerator::printArbiterChp(const char *instance,
           normOutput,
           outName,
           coutName);
+  recordInstance(instance, String(normOutput) + "_inst");
 }
 
 void ChpGenerator::printMixerChp(const char *instance,
@@ -269,6 +293,7 @@ void ChpGenerator::printMixerChp(const char *instance,
           normOutput,
           outName,
           coutName);
+  recordInstance(instance, String(normOutput) + "_inst");
 }
 
 void ChpGenerator::printProcChpHeader(Process *p) {
@@ -31,14 +31,36 @@
 class ChpGenerator {
  private:
   FILE *chpFp;
+  /* the chp file, while the output is redirected */
+  FILE *outFp;
 #if GEN_NETLIST
 #endif
+  /* (instance name, instance) of the instances printed since the last
+   * takeInstances() */
+  Vector<Pair<String, String>> newInstances;
+
+  void recordInstance(const char *instance, const String &instName);
 
  public:
   explicit ChpGenerator(FILE *chpFp) {
     this->chpFp = chpFp;
+    outFp = chpFp;
+  }
+
+  void redirectOutput(FILE *fp) {
+    this->chpFp = fp;
+  }
+
+  void restoreOutput() {
+    chpFp = outFp;
+  }
+
+  void appendOutput(const String &chp) {
+    fwrite(chp.data(), 1, chp.size(), chpFp);
   }
 
+  Vector<Pair<String, String>> takeInstances();
+
   void printSinkChp(const char *instance, const char *inName);
 
   void printCopyChp(const char *instance,
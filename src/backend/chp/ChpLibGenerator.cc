@@ -23,12 +23,6 @@
 
 ChpLibGenerator::ChpLibGenerator(FILE *chpLibFp, FILE *chpFp,
                                  FILE *confFp) {
-  for (unsigned i = 0; i < MAX_PROCESSES; i++) {
-    processes[i] = nullptr;
-  }
-  for (unsigned i = 0; i < MAX_PROCESSES; i++) {
-    instances[i] = nullptr;
-  }
   if (!chpLibFp || !confFp) {
     printf("Invalid file handler for CHP lib generator!\n");
     exit(-1);
@@ -37,41 +31,142 @@ ChpLibGenerator::ChpLibGenerator(FILE *chpLibFp, FILE *chpFp,
   this->chpLibFp = chpLibFp;
   this->confFp = confFp;
   this->chpFp = chpFp;
+  outChpLibFp = chpLibFp;
+  outChpFp = chpFp;
+  outConfFp = confFp;
+  recordChunks = false;
 }
 
-bool ChpLibGenerator::checkAndUpdateInstance(const char *instance) {
-  for (unsigned i = 0; i < MAX_PROCESSES; i++) {
-    if (instances[i] == nullptr) {
-      instances[i] = instance;
-      return false;
-    } else if (!strcmp(instances[i], instance)) {
-      return true;
+void ChpLibGenerator::redirectOutput(FILE *chpLibFp, FILE *chpFp,
+                                     FILE *confFp) {
+  this->chpLibFp = chpLibFp;
+  this->confFp = confFp;
+  this->chpFp = chpFp;
+  recordChunks = true;
+  libChunks.clear();
+  confChunks.clear();
+  cornerConfs.clear();
+  chunkProcesses.clear();
+  chunkInstances.clear();
+}
+
+void ChpLibGenerator::restoreOutput() {
+  chpLibFp = outChpLibFp;
+  chpFp = outChpFp;
+  confFp = outConfFp;
+  recordChunks = false;
+}
+
+void ChpLibGenerator::addCornerConf(FILE *cornerConfFp) {
+  fprintf(cornerConfFp, "begin sim.chp\n");
+  cornerConfFps.push_back(cornerConfFp);
+}
+
+void ChpLibGenerator::appendChunks(FILE *fp,
+                                   const String &buff,
+                                   Vector<OutputChunk> &chunks,
+                                   bool isProcess) {
+  long pos = 0;
+  for (auto &chunk: chunks) {
+    fwrite(buff.data() + pos, 1, chunk.begin - pos, fp);
+    const char *key = chunk.key.c_str();
+    bool exist = isProcess ? checkAndUpdateProcess(key)
+                           : checkAndUpdateInstance(key);
+    if (!exist) {
+      fwrite(buff.data() + chunk.begin, 1, chunk.end - chunk.begin, fp);
     }
+    pos = chunk.end;
   }
-  return false;
+  fwrite(buff.data() + pos, 1, buff.size() - pos, fp);
+}
+
+void ChpLibGenerator::appendOutput(const String &chpLib,
+                                   Vector<OutputChunk> &chpLibChunks,
+                                   const String &conf,
+                                   Vector<OutputChunk> &confChunksToAppend,
+                                   Vector<CornerConf> &cornerConfsToAppend) {
+  appendChunks(chpLibFp, chpLib, chpLibChunks, true);
+  appendChunks(confFp, conf, confChunksToAppend, false);
+  for (auto &cornerConf: cornerConfsToAppend) {
+    printCornerConf(cornerConf);
+  }
+}
+
+bool ChpLibGenerator::checkAndUpdateInstance(const char *instance) {
+  SymbolSet &printed = recordChunks ? chunkInstances : instances;
+  return !printed.insert(SymbolTable::intern(instance)).second;
 }
 
 bool ChpLibGenerator::checkAndUpdateProcess(const char *process) {
-  for (unsigned i = 0; i < MAX_PROCESSES; i++) {
-    if (processes[i] == nullptr) {
-      processes[i] = process;
-      return false;
-    } else if (!strcmp(processes[i], process)) {
-      return true;
+  SymbolSet &printed = recordChunks ? chunkProcesses : processes;
+  return !printed.insert(SymbolTable::intern(process)).second;
+}
+
+String ChpLibGenerator::formatConf(const char *block,
+                                   StringVec &ports,
+                                   const double *metric) {
+  char line[64];
+  String conf = String("begin ") + block + "\n";
+  for (auto &port: ports) {
+    conf += "  begin " + port + "\n";
+    snprintf(line, sizeof(line), "    int D %ld\n", (long) metric[2]);
+    conf += line;
+    snprintf(line, sizeof(line), "    int E %ld\n", (long) metric[1]);
+    conf += line;
+    conf += "  end\n";
+  }
+  snprintf(line, sizeof(line), "  real leakage %lde-9\n", (long) metric[0]);
+  conf += line;
+  snprintf(line, sizeof(line), "  int area %ld\n", (long) metric[3]);
+  conf += line;
+  conf += "end\n";
+  return conf;
+}
+
+void ChpLibGenerator::printConfBlock(const char *instance,
+                                     const char *block,
+                                     StringVec &ports,
+                                     double *metric) {
+  long begin = recordChunks ? ftell(confFp) : 0;
+  String conf = formatConf(block, ports, metric);
+  fwrite(conf.data(), 1, conf.size(), confFp);
+  if (recordChunks) {
+    confChunks.push_back({instance, begin, ftell(confFp)});
+  }
+  if (num_corners > 1) {
+    CornerConf cornerConf;
+    cornerConf.instance = instance;
+    for (unsigned c = 1; c < num_corners; c++) {
+      cornerConf.confs.push_back(formatConf(block, ports, metric + 4 * c));
+    }
+    if (recordChunks) {
+      cornerConfs.push_back(cornerConf);
+    } else {
+      printCornerConf(cornerConf);
     }
   }
-  return false;
 }
 
-void ChpLibGenerator::printMemConfig(const char *procName) {
-  fprintf(confFp, "begin mem::%s\n", procName);
-  fprintf(confFp, "  begin DO\n");
-  fprintf(confFp, "    int D 0\n");
-  fprintf(confFp, "    int E 0\n");
-  fprintf(confFp, "  end\n");
-  fprintf(confFp, "  real leakage 0\n");
-  fprintf(confFp, "  int area 0\n");
-  fprintf(confFp, "end\n");
+void ChpLibGenerator::printCornerConf(CornerConf &cornerConf) {
+  if (!cornerInstances.insert(SymbolTable::intern(cornerConf.instance.c_str()))
+      .second) {
+    return;
+  }
+  for (unsigned i = 0; i < cornerConfFps.size(); i++) {
+    const String &conf = cornerConf.confs[i];
+    fwrite(conf.data(), 1, conf.size(), cornerConfFps[i]);
+  }
+}
+
+void ChpLibGenerator::printMemConfig(const char *procName, double *metric) {
+  double zeroMetric[4 * MAX_CORNERS] = {0};
+  if (!metric) {
+    metric = zeroMetric;
+  }
+  char *block = newScratchChars(strlen(procName) + 8);
+  sprintf(block, "mem::%s", procName);
+  StringVec ports = {"DO"};
+  printConfBlock(block, block, ports, metric);
 }
 
 void ChpLibGenerator::printConf(double *metric,
@@ -86,16 +181,11 @@ void ChpLibGenerator::printConf(double *metric,
     return;
   }
   if (!checkAndUpdateInstance(instance)) {
-    fprintf(confFp, "begin %s\n", instance);
+    StringVec ports;
     for (unsigned i = 0; i < numOutputs; i++) {
-      fprintf(confFp, "  begin out%d\n", i);
-      fprintf(confFp, "    int D %ld\n", (long) metric[2]);
-      fprintf(confFp, "    int E %ld\n", (long) metric[1]);
-      fprintf(confFp, "  end\n");
+      ports.push_back("out" + std::to_string(i));
     }
-    fprintf(confFp, "  real leakage %lde-9\n", (long) metric[0]);
-    fprintf(confFp, "  int area %ld\n", (long) metric[3]);
-    fprintf(confFp, "end\n");
+    printConfBlock(instance, instance, ports, metric);
   }
 }
 
@@ -108,14 +198,8 @@ void ChpLibGenerator::printConf(double *metric, const char *instance) {
     return;
   }
   if (!checkAndUpdateInstance(instance)) {
-    fprintf(confFp, "begin %s\n", instance);
-    fprintf(confFp, "  begin out\n");
-    fprintf(confFp, "    int D %ld\n", (long) metric[2]);
-    fprintf(confFp, "    int E %ld\n", (long) metric[1]);
-    fprintf(confFp, "  end\n");
-    fprintf(confFp, "  real leakage %lde-9\n", (long) metric[0]);
-    fprintf(confFp, "  int area %ld\n", (long) metric[3]);
-    fprintf(confFp, "end\n");
+    StringVec ports = {"out"};
+    printConfBlock(instance, instance, ports, metric);
   }
 }
 
@@ -132,7 +216,7 @@ void ChpLibGenerator::printFUChpLib(const char *instance,
     printf("Invalid instance name %s\n", instance);
     exit(-1);
   }
-  char *outSend = new char[10240];
+  char *outSend = newScratchChars(10240);
   sprintf(outSend, "      ");
   unsigned i = 0;
   Vector<unsigned> resSuffixVec;
@@ -140,7 +224,7 @@ void ChpLibGenerator::printFUChpLib(const char *instance,
     unsigned outID = outRecordIt.first;
     unsigned resSuffix = outRecordIt.second;
     resSuffixVec.push_back(resSuffix);
-    char *subSend = new char[1024];
+    char *subSend = newScratchChars(1024);
     if (i < numOuts - 1) {
       sprintf(subSend, "out%u!res%u, ", outID, resSuffix);
     } else {
@@ -149,15 +233,15 @@ void ChpLibGenerator::printFUChpLib(const char *instance,
     strcat(outSend, subSend);
     i++;
   }
-  char *log = new char[1500];
+  char *log = newScratchChars(1500);
   if (!quiet_mode) {
   sprintf(log, "      log(\"send (\", ");
   for (auto &outResSuffix: resSuffixVec) {
-    char *subLog = new char[100];
+    char *subLog = newScratchChars(100);
     sprintf(subLog, "res%u, \",\", ", outResSuffix);
     strcat(log, subLog);
   }
-  char *subLog = new char[100];
+  char *subLog = newScratchChars(100);
   sprintf(subLog, "\")\")");
   strcat(log, subLog);
   }
@@ -184,6 +268,7 @@ void ChpLibGenerator::printFUChpLib(const char *procName,
                                     double *metric,
                                     UIntVec &resBW) {
   if (!checkAndUpdateProcess(procName)) {
+    long begin = recordChunks ? ftell(chpLibFp) : 0;
     fprintf(chpLibFp, "template<pint ");
     unsigned numTemplateVars = numArgs + numOuts;
     /* generate template for input/output channels */
@@ -242,6 +327,9 @@ void ChpLibGenerator::printFUChpLib(const char *procName,
     fprintf(chpLibFp, "%s", calc);
     fprintf(chpLibFp, "%s", outSend);
     fprintf(chpLibFp, "\n    ]\n  }\n}\n\n");
+    if (recordChunks) {
+      libChunks.push_back({procName, begin, ftell(chpLibFp)});
+    }
   }
   printConf(metric, instance, numOuts, LOGIC_OPTIMIZER);
 }
@@ -283,12 +371,12 @@ void ChpLibGenerator::printBuffChpLib(Vector<BuffInfo> &buffInfos) {
     bool hasInitVal = buffInfo.hasInitVal;
     double *metric = buffInfo.metric;
     if ((numBuff > 1) || (!hasInitVal)) {
-      char *buffInstance = new char[1024];
+      char *buffInstance = newScratchChars(1024);
       sprintf(buffInstance, "onebuf<%u>", bw);
       printOneBuffChpLib(buffInstance, metric);
     }
     if (hasInitVal) {
-      char *initInstance = new char[1024];
+      char *initInstance = newScratchChars(1024);
       unsigned long initVal = buffInfo.initVal;
       sprintf(initInstance, "init<%lu,%u>", initVal, bw);
       printInitChpLib(initInstance, metric);
@@ -321,7 +409,9 @@ void ChpLibGenerator::printChpBlock(Process *p, int where) {
   }
 }
 
-void ChpLibGenerator::printCustomNamespace(ActNamespace *ns) {
+void ChpLibGenerator::printCustomNamespace(
+    ActNamespace *ns,
+    Map<Process *, double *> &memMetrics) {
   const char *nsName = ns->getName();
   fprintf(chpLibFp, "namespace %s {\n", nsName);
   ActTypeiter it(ns);
@@ -334,10 +424,13 @@ void ChpLibGenerator::printCustomNamespace(ActNamespace *ns) {
       p->Print(chpLibFp);
       if (isMEM) {
         const char *memProcName = p->getName();
-        printMemConfig(memProcName);
+        auto memMetricsIt = memMetrics.find(p);
+        printMemConfig(memProcName,
+                       (memMetricsIt != memMetrics.end())
+                       ? memMetricsIt->second : nullptr);
         if (debug_verbose) {
           unsigned len = strlen(memProcName);
-          char *memName = new char[len - 1];
+          char *memName = newScratchChars(len - 1);
           strncpy(memName, memProcName, len - 2);
           memName[len - 2] = '\0';
           printf("memName: %s\n", memName);
@@ -352,4 +445,8 @@ void ChpLibGenerator::printCustomNamespace(ActNamespace *ns) {
 void ChpLibGenerator::printFileEnding() {
   fprintf(confFp, "end\n");
   fclose(confFp);
+  for (auto &cornerConfFp: cornerConfFps) {
+    fprintf(cornerConfFp, "end\n");
+    fclose(cornerConfFp);
+  }
 }
@@ -31,11 +31,45 @@
 #include "src/common/Helper.h"
 #include "src/common/config.h"
 
+/* a deduplicated definition in a buffered output: its dedup key and its
+ * [begin, end) offsets in the buffer */
+typedef struct outputChunk {
+  String key;
+  long begin;
+  long end;
+} OutputChunk;
+
+/* the conf blocks of an instance for the corners after corner 0, which go to
+ * a conf file of their own each */
+typedef struct cornerConf {
+  String instance;
+  StringVec confs;
+} CornerConf;
+
 class ChpLibGenerator {
  public:
   ChpLibGenerator(FILE *chpLibFp, FILE *chpFp, FILE *confFp);
 
-  void printMemConfig(const char *procName);
+  void redirectOutput(FILE *chpLibFp, FILE *chpFp, FILE *confFp);
+
+  void restoreOutput();
+
+  /* the conf file of the next corner after corner 0 */
+  void addCornerConf(FILE *cornerConfFp);
+
+  Vector<OutputChunk> &getLibChunks() { return libChunks; }
+
+  Vector<OutputChunk> &getConfChunks() { return confChunks; }
+
+  Vector<CornerConf> &getCornerConfs() { return cornerConfs; }
+
+  void appendOutput(const String &chpLib,
+                    Vector<OutputChunk> &chpLibChunks,
+                    const String &conf,
+                    Vector<OutputChunk> &confChunksToAppend,
+                    Vector<CornerConf> &cornerConfsToAppend);
+
+  void printMemConfig(const char *procName, double *metric);
 
   void printConf(double *metric,
                  const char *instance,
@@ -87,19 +121,61 @@ class ChpLibGenerator {
 
   void printChpBlock(Process *p, int where);
 
-  void printCustomNamespace(ActNamespace *ns);
+  /* memMetrics holds the metric of the processes of the mem namespace */
+  void printCustomNamespace(ActNamespace *ns,
+                            Map<Process *, double *> &memMetrics);
 
   void printFileEnding();
 
  private:
-  const char *processes[MAX_PROCESSES];
-  const char *instances[MAX_PROCESSES];
+  /* processes already defined in the chplib file */
+  SymbolSet processes;
+  /* instances already configured in the conf file */
+  SymbolSet instances;
   FILE *chpLibFp;
   FILE *chpFp;
   FILE *confFp;
+  /* the files the output goes to when it is not redirected */
+  FILE *outChpLibFp;
+  FILE *outChpFp;
+  FILE *outConfFp;
+  Vector<FILE *> cornerConfFps;
+  /* instances already configured in the conf files of the other corners */
+  SymbolSet cornerInstances;
+  /* the blocks for the other corners printed since the output was
+   * redirected */
+  Vector<CornerConf> cornerConfs;
+  /* record where each deduplicated definition starts and ends, so that the
+   * buffered output of a process can be merged without duplicates */
+  bool recordChunks;
+  /* processes and instances printed since the output was redirected; the
+   * buffered output of a process holds every definition it uses, and the
+   * duplicates are dropped when it is appended */
+  SymbolSet chunkProcesses;
+  SymbolSet chunkInstances;
+  Vector<OutputChunk> libChunks;
+  Vector<OutputChunk> confChunks;
+
+  void appendChunks(FILE *fp,
+                    const String &buff,
+                    Vector<OutputChunk> &chunks,
+                    bool isProcess);
 
   bool checkAndUpdateInstance(const char *instance);
 
+  /* "begin <block>", the D and E of each port, and the leakage and area */
+  static String formatConf(const char *block,
+                           StringVec &ports,
+                           const double *metric);
+
+  /* print the block of instance to the conf file of every corner */
+  void printConfBlock(const char *instance,
+                      const char *block,
+                      StringVec &ports,
+                      double *metric);
+
+  void printCornerConf(CornerConf &cornerConf);
+
   bool checkAndUpdateProcess(const char *process);
 
 };
@@ -0,0 +1,82 @@
+/*
+ * This file is part of the ACT library
+ *
+ * Copyright (c) 2021 Rui Li
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include "Arena.h"
+
+Arena *Arena::current = nullptr;
+
+Arena::Arena(size_t blockSize) {
+  this->blockSize = blockSize;
+  cur = nullptr;
+  left = 0;
+  allocatedBytes = 0;
+}
+
+Arena::~Arena() {
+  release();
+}
+
+void *Arena::alloc(size_t size) {
+  const size_t align = alignof(std::max_align_t);
+  size = (size + align - 1) & ~(align - 1);
+  if (size > left) {
+    /* oversized requests get a block of their own, so that the rest of the
+     * current block is not wasted */
+    if (size > blockSize / 4) {
+      auto block = new char[size];
+      blocks.push_back(block);
+      allocatedBytes += size;
+      return block;
+    }
+    cur = new char[blockSize];
+    left = blockSize;
+    blocks.push_back(cur);
+    allocatedBytes += blockSize;
+  }
+  void *result = cur;
+  cur += size;
+  left -= size;
+  return result;
+}
+
+void Arena::release() {
+  for (auto &block: blocks) {
+    delete[] block;
+  }
+  blocks.clear();
+  cur = nullptr;
+  left = 0;
+  allocatedBytes = 0;
+}
+
+char *newScratchChars(size_t len) {
+  Arena *arena = Arena::getCurrent();
+  if (!arena) {
+    return new char[len];
+  }
+  return (char *) arena->alloc(len);
+}
+
+char *newScratchStr(const char *str) {
+  char *result = newScratchChars(1 + strlen(str));
+  strcpy(result, str);
+  return result;
+}
@@ -0,0 +1,99 @@
+/*
+ * This file is part of the ACT library
+ *
+ * Copyright (c) 2021 Rui Li
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef DFLOWMAP_SRC_COMMON_ARENA_H_
+#define DFLOWMAP_SRC_COMMON_ARENA_H_
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include "common.h"
+
+#define ARENA_BLOCK_SIZE 1048576
+
+/* Bump allocator for the scratch memory (names, expressions, CHP snippets)
+ * used while mapping one process. Nothing is freed individually; all of the
+ * blocks are released at once when the arena is destroyed. */
+class Arena {
+ public:
+  explicit Arena(size_t blockSize = ARENA_BLOCK_SIZE);
+
+  ~Arena();
+
+  void *alloc(size_t size);
+
+  void release();
+
+  size_t getAllocatedBytes() { return allocatedBytes; }
+
+  static Arena *getCurrent() { return current; }
+
+  static void setCurrent(Arena *arena) { current = arena; }
+
+ private:
+  /* the arena of the process being mapped, if any */
+  static Arena *current;
+
+  Vector<char *> blocks;
+
+  char *cur;
+
+  size_t left;
+
+  size_t blockSize;
+
+  size_t allocatedBytes;
+};
+
+/* make "arena" the current arena until the end of the scope */
+class ArenaScope {
+ public:
+  explicit ArenaScope(Arena *arena) {
+    prev = Arena::getCurrent();
+    Arena::setCurrent(arena);
+  }
+
+  ~ArenaScope() {
+    Arena::setCurrent(prev);
+  }
+
+ private:
+  Arena *prev;
+};
+
+/* scratch buffer of "len" chars from the current arena, or from the heap if no
+ * process is being mapped */
+char *newScratchChars(size_t len);
+
+/* scratch copy of "str" */
+char *newScratchStr(const char *str);
+
+/* zero-initialized scratch object of POD type T */
+template<class T>
+T *newScratch() {
+  Arena *arena = Arena::getCurrent();
+  if (!arena) {
+    return new T();
+  }
+  return new(arena->alloc(sizeof(T))) T();
+}
+
+#endif //DFLOWMAP_SRC_COMMON_ARENA_H_
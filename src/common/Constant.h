@@ -32,6 +32,10 @@ public:
   static constexpr const char* SPLIT_PREFIX = "split";
   static constexpr const char* MEM_NAMESPACE = "mem";
   static constexpr const char* STD_NAMESPACE = "std";
+  /* the data ports of a mem process; a port with a suffix, such as "DI1",
+   * is another port of the same kind */
+  static constexpr const char* MEM_WRITE_PORT = "DI";
+  static constexpr const char* MEM_READ_PORT = "DO";
 };
 
 #endif //DFLOWMAP_CONSTANT_H
@@ -19,6 +19,14 @@
  * Boston, MA  02110-1301, USA.
  */
 
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
 #include "Helper.h"
 
 void normalizeName(char *src, char toDel, char newChar) {
@@ -30,18 +38,13 @@ void normalizeName(char *src, char toDel, char newChar) {
 }
 
 const char *getNormInstanceName(const char *src) {
-  char *result = new char[1 + strlen(src)];
-  sprintf(result, "%s", src);
-  normalizeName(result, '<', '_');
-  normalizeName(result, '>', '_');
-  normalizeName(result, ',', '_');
-  return result;
+  SymbolId id = SymbolTable::getNormInstance(SymbolTable::intern(src));
+  return SymbolTable::getName(id);
 }
+
 const char *getNormActIdName(const char *src) {
-  char *result = new char[1 + strlen(src)];
-  sprintf(result, "%s", src);
-  normalizeName(result, '.', '_');
-  return result;
+  SymbolId id = SymbolTable::getNormActId(SymbolTable::intern(src));
+  return SymbolTable::getName(id);
 }
 
 void printIntVec(IntVec &intVec) {
@@ -68,7 +71,7 @@ int searchStringVec(StringVec &strVec, const char *str) {
 }
 
 Expr *genExprFromStr(const char *str, int exprType) {
-  Expr *expr = new Expr;
+  Expr *expr = newScratch<Expr>();
   auto newLActId = ActId::parseId(str);
   expr->type = exprType;
   expr->u.e.l = (Expr *) (newLActId);
@@ -76,7 +79,7 @@ Expr *genExprFromStr(const char *str, int exprType) {
 }
 
 Expr *genExprFromInt(unsigned long val) {
-  Expr *expr = new Expr;
+  Expr *expr = newScratch<Expr>();
   expr->type = E_INT;
   expr->u.v = val;
   expr->u.v_extra = nullptr;
@@ -117,6 +120,10 @@ void getActIdName(Scope *sc, ActId *actId, char *buff, int sz) {
   delete uid;
 }
 
+const char *getActIdName(Scope *sc, ActId *actId) {
+  return SymbolTable::getName(SymbolTable::intern(actId->Canonical(sc)));
+}
+
 void getCurProc(const char *str, char *val) {
   char curProc[100];
   if (strstr(str, "res")) {
@@ -141,6 +148,10 @@ void getActConnectionName(act_connection *actConnection,
   delete uid;
 }
 
+const char *getActConnectionName(act_connection *actConnection) {
+  return SymbolTable::getName(SymbolTable::intern(actConnection));
+}
+
 void print_dflow(FILE *fp, list_t *dflow) {
   listitem_t *li;
   act_dataflow_element *e;
@@ -176,6 +187,38 @@ void createFileIfNotExist(const char *file, std::ios_base::openmode mode) {
   }
 }
 
+bool parseCount(const char *str,
+                unsigned shift,
+                unsigned long max,
+                unsigned long &value) {
+  /* strtoul accepts a sign, and wraps negative numbers around */
+  if (!isdigit((unsigned char) str[0])) {
+    return false;
+  }
+  char *end;
+  errno = 0;
+  unsigned long count = strtoul(str, &end, 10);
+  if ((errno == ERANGE) || (*end != '\0') || (count == 0)
+      || (count > (max >> shift))) {
+    return false;
+  }
+  value = count << shift;
+  return true;
+}
+
+const char *getCornerFile(const char *file, const char *corner) {
+  if (strcmp(corner, "typ") == 0) {
+    return file;
+  }
+  const char *base = strrchr(file, '/');
+  const char *ext = strrchr(base ? base : file, '.');
+  size_t stemLen = ext ? (size_t) (ext - file) : strlen(file);
+  char *cornerFile = new char[strlen(file) + strlen(corner) + 2];
+  sprintf(cornerFile, "%.*s_%s%s", (int) stemLen, file, corner,
+          ext ? ext : "");
+  return cornerFile;
+}
+
 void copyFileToTargetDir(const char *srcFile,
                          const char *targetDir,
                          const char *errMsg) {
@@ -190,4 +233,170 @@ void copyFileToTargetDir(const char *srcFile,
     printf("%s. Reason is: %s\n", errMsg, e.what());
     exit(-1);
   }
-}
\ No newline at end of file
+}
+static bool isIdChar(char c) {
+  return isalnum((unsigned char) c) || (c == '_');
+}
+
+/* rename the process or module declared as fromName; other identifiers
+ * that contain it, and references to it, are left alone */
+static void renameDecl(String &content,
+                       const char *fromName,
+                       const char *toName) {
+  size_t fromLen = strlen(fromName);
+  size_t toLen = strlen(toName);
+  for (size_t pos = content.find(fromName); pos != String::npos;
+       pos = content.find(fromName, pos + 1)) {
+    size_t end = pos + fromLen;
+    if (((pos > 0) && isIdChar(content[pos - 1]))
+        || ((end < content.size()) && isIdChar(content[end]))) {
+      continue;
+    }
+    size_t wordEnd = pos;
+    while ((wordEnd > 0) && isspace((unsigned char) content[wordEnd - 1])) {
+      wordEnd--;
+    }
+    size_t wordBegin = wordEnd;
+    while ((wordBegin > 0) && isIdChar(content[wordBegin - 1])) {
+      wordBegin--;
+    }
+    String word = content.substr(wordBegin, wordEnd - wordBegin);
+    if ((wordEnd == pos) || ((word != "defproc") && (word != "module"))) {
+      continue;
+    }
+    content.replace(pos, fromLen, toName);
+    pos += toLen - 1;
+  }
+}
+
+String readFileRenaming(const char *srcFile,
+                        const char *fromName,
+                        const char *toName,
+                        const char *errMsg) {
+  String content;
+  if (!readFile(srcFile, content)) {
+    printf("%s. Reason is: could not read %s\n", errMsg, srcFile);
+    exit(-1);
+  }
+  renameDecl(content, fromName, toName);
+  return content;
+}
+
+bool copyFileRenaming(const char *srcFile,
+                      const char *dstFile,
+                      const char *fromName,
+                      const char *toName,
+                      const char *errMsg) {
+  String content;
+  if (!readFile(srcFile, content)) {
+    return false;
+  }
+  renameDecl(content, fromName, toName);
+  writeFileAtomic(dstFile, content, errMsg);
+  return true;
+}
+
+bool readFile(const char *file, String &content) {
+  std::ifstream src(file);
+  if (src.fail()) {
+    return false;
+  }
+  std::stringstream buff;
+  buff << src.rdbuf();
+  content = buff.str();
+  return true;
+}
+
+void writeFileAtomic(const char *dstFile,
+                     const String &content,
+                     const char *errMsg) {
+  /* unique per process and per thread */
+  static std::atomic<unsigned> numTmpFiles(0);
+  char tmpSuffix[64];
+  sprintf(tmpSuffix, ".tmp%d.%u", (int) getpid(), numTmpFiles++);
+  String tmpFile = String(dstFile) + tmpSuffix;
+  std::ofstream dst(tmpFile);
+  dst << content;
+  dst.close();
+  if (dst.fail() || (rename(tmpFile.c_str(), dstFile) != 0)) {
+    unlink(tmpFile.c_str());
+    printf("%s. Reason is: could not write %s\n", errMsg, dstFile);
+    exit(-1);
+  }
+}
+
+/* open file and take the advisory lock op on it; the file may be unlinked
+ * or replaced by its previous holder, so retry until the locked file is the
+ * one at the path. Returns -1 if it can not be opened or a LOCK_NB lock is
+ * busy */
+static int openLocked(const char *file, int flags, int op) {
+  while (true) {
+    int fd = open(file, flags | O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      return -1;
+    }
+    while (flock(fd, op) != 0) {
+      if (errno != EINTR) {
+        close(fd);
+        return -1;
+      }
+    }
+    struct stat fdStat, fileStat;
+    if ((fstat(fd, &fdStat) == 0) && (stat(file, &fileStat) == 0)
+        && (fdStat.st_ino == fileStat.st_ino)
+        && (fdStat.st_dev == fileStat.st_dev)) {
+      return fd;
+    }
+    close(fd);
+  }
+}
+
+void appendFileLocked(const char *file,
+                      const String &content,
+                      const char *errMsg) {
+  int fd = openLocked(file, O_APPEND, LOCK_EX);
+  if (fd < 0) {
+    printf("%s. Reason is: could not open %s\n", errMsg, file);
+    exit(-1);
+  }
+  String data = content;
+  struct stat fdStat;
+  char last;
+  if ((fstat(fd, &fdStat) == 0) && (fdStat.st_size > 0)
+      && (pread(fd, &last, 1, fdStat.st_size - 1) == 1) && (last != '\n')) {
+    /* end a line torn by a crash, so that it is not merged with ours */
+    data.insert(0, "\n");
+  }
+  const char *buf = data.data();
+  size_t left = data.size();
+  while (left > 0) {
+    ssize_t len = write(fd, buf, left);
+    if (len < 0) {
+      if (errno == EINTR) continue;
+      printf("%s. Reason is: could not write %s\n", errMsg, file);
+      exit(-1);
+    }
+    buf += len;
+    left -= len;
+  }
+  flock(fd, LOCK_UN);
+  close(fd);
+}
+
+int lockFile(const char *lockFile) {
+  int fd = openLocked(lockFile, 0, LOCK_EX);
+  if (fd < 0) {
+    printf("Could not lock %s!\n", lockFile);
+    exit(-1);
+  }
+  return fd;
+}
+
+int tryLockFile(const char *lockFile) {
+  return openLocked(lockFile, 0, LOCK_EX | LOCK_NB);
+}
+
+void unlockFile(int fd) {
+  flock(fd, LOCK_UN);
+  close(fd);
+}
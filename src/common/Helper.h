@@ -27,6 +27,8 @@
 #include <fstream>
 #include "Constant.h"
 #include "common.h"
+#include "Arena.h"
+#include "SymbolTable.h"
 
 void normalizeName(char *src, char toDel, char newChar);
 
@@ -53,10 +55,15 @@ bool isBinType(int exprType);
 
 void getActIdName(Scope *sc, ActId *actId, char *buff, int sz);
 
+/* interned canonical name of actId */
+const char *getActIdName(Scope *sc, ActId *actId);
+
 void getCurProc(const char *str, char *val);
 
 void getActConnectionName(act_connection *actConnection, char *buff, int sz);
 
+const char *getActConnectionName(act_connection *actConnection);
+
 void print_dflow(FILE *fp, list_t *dflow);
 
 void removeDirectoryIfExist(const char *dir);
@@ -65,10 +72,61 @@ void createDirectoryIfNotExist(const char *dir);
 
 void createFileIfNotExist(const char *file, std::ios_base::openmode mode);
 
+/* parse a positive decimal number and multiply it by 2^shift; false if str
+ * is not one, or if the result exceeds max */
+bool parseCount(const char *str,
+                unsigned shift,
+                unsigned long max,
+                unsigned long &value);
+
+/* the metric file of a corner: "typ" uses file itself, any other corner the
+ * file with "_<corner>" before its extension */
+const char *getCornerFile(const char *file, const char *corner);
+
 void copyFileToTargetDir(const char *srcFile,
                          const char *targetDir,
                          const char *errMsg);
 
+/* contents of srcFile with the process or module declared as "fromName"
+ * renamed to "toName" */
+String readFileRenaming(const char *srcFile,
+                        const char *fromName,
+                        const char *toName,
+                        const char *errMsg);
+
+/* copy srcFile to dstFile, renaming the process or module declared as
+ * "fromName" to "toName"; false if srcFile could not be read */
+bool copyFileRenaming(const char *srcFile,
+                      const char *dstFile,
+                      const char *fromName,
+                      const char *toName,
+                      const char *errMsg);
+
+/* false if file could not be read */
+bool readFile(const char *file, String &content);
+
+/* replace dstFile with content; readers see either the old or the new file,
+ * never a partially written one */
+void writeFileAtomic(const char *dstFile,
+                     const String &content,
+                     const char *errMsg);
+
+/* append content to file under an exclusive advisory lock, so that lines
+ * from concurrent processes never interleave. Files that are compacted are
+ * replaced with writeFileAtomic under the same lock */
+void appendFileLocked(const char *file,
+                      const String &content,
+                      const char *errMsg);
+
+/* block until the exclusive advisory lock on lockFile is held; returns the
+ * descriptor to pass to unlockFile */
+int lockFile(const char *lockFile);
+
+/* like lockFile, but returns -1 instead of waiting if the lock is held */
+int tryLockFile(const char *lockFile);
+
+void unlockFile(int fd);
+
 template<class T>
 bool hasInVector(Vector<T> &vector, T &elem) {
   return std::find(vector.begin(), vector.end(), elem) != vector.end();
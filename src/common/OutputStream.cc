@@ -0,0 +1,193 @@
+/*
+ * This file is part of the ACT library
+ *
+ * Copyright (c) 2021 Rui Li
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <climits>
+#include <cerrno>
+#include <cstring>
+#include <sys/uio.h>
+#include "OutputStream.h"
+
+Vector<OutputStream *> OutputStream::fileStreams;
+
+OutputStream::OutputStream(int fd) {
+  this->fd = fd;
+  closed = false;
+  writeError = 0;
+  pendingBytes = 0;
+  closing = false;
+  cookie_io_functions_t io = {nullptr, cookieWrite, nullptr, cookieClose};
+  fp = fopencookie(this, "w", io);
+  if (!fp) {
+    printf("Fail to create an output stream!\n");
+    exit(-1);
+  }
+  setvbuf(fp, nullptr, _IOFBF, OUTPUT_BUFFER_SIZE);
+  if (fd >= 0) {
+    writer = std::thread(&OutputStream::writerLoop, this);
+    fileStreams.push_back(this);
+  }
+}
+
+OutputStream *OutputStream::openFile(const char *path) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return nullptr;
+  }
+  return new OutputStream(fd);
+}
+
+OutputStream *OutputStream::openMemory() {
+  return new OutputStream(-1);
+}
+
+String OutputStream::getContents() {
+  if (!closed) {
+    fflush(fp);
+  }
+  return contents;
+}
+
+OutputStream::~OutputStream() {
+  close();
+}
+
+void OutputStream::close() {
+  if (closed) return;
+  closed = true;
+  auto fileStreamsIt = std::find(fileStreams.begin(), fileStreams.end(), this);
+  if (fileStreamsIt != fileStreams.end()) {
+    fileStreams.erase(fileStreamsIt);
+  }
+  /* flushes the stdio buffer and then calls cookieClose */
+  if (fclose(fp) != 0) {
+    printf("Fail to write the output: %s\n", strerror(writeError));
+    exit(-1);
+  }
+}
+
+ssize_t OutputStream::cookieWrite(void *cookie, const char *buf, size_t size) {
+  auto stream = (OutputStream *) cookie;
+  if (stream->fd < 0) {
+    stream->contents.append(buf, size);
+    return size;
+  }
+  std::unique_lock<std::mutex> lock(stream->mutex);
+  stream->hasRoom.wait(lock, [stream] {
+    return stream->pendingBytes < OUTPUT_MAX_PENDING;
+  });
+  stream->pending.emplace_back(buf, size);
+  stream->pendingBytes += size;
+  stream->hasPending.notify_one();
+  return size;
+}
+
+int OutputStream::cookieClose(void *cookie) {
+  auto stream = (OutputStream *) cookie;
+  if (stream->fd < 0) {
+    return 0;
+  }
+  {
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    stream->closing = true;
+  }
+  stream->hasPending.notify_one();
+  stream->writer.join();
+  if ((::close(stream->fd) != 0) && !stream->writeError) {
+    stream->writeError = errno;
+  }
+  return stream->writeError ? -1 : 0;
+}
+
+void OutputStream::stopWriter() {
+  fflush(fp);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    closing = true;
+  }
+  hasPending.notify_one();
+  writer.join();
+  closing = false;
+}
+
+void OutputStream::suspendAll() {
+  for (auto &stream: fileStreams) {
+    stream->stopWriter();
+  }
+}
+
+void OutputStream::resumeAll() {
+  for (auto &stream: fileStreams) {
+    stream->writer = std::thread(&OutputStream::writerLoop, stream);
+  }
+}
+
+void OutputStream::writerLoop() {
+  while (true) {
+    Vector<String> chunks;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      hasPending.wait(lock, [this] { return closing || !pending.empty(); });
+      if (pending.empty()) {
+        return;
+      }
+      chunks.swap(pending);
+      pendingBytes = 0;
+    }
+    hasRoom.notify_all();
+    /* after an error the output is dropped; close() reports it */
+    if (!writeError) {
+      writeChunks(chunks);
+    }
+  }
+}
+
+void OutputStream::writeChunks(Vector<String> &chunks) {
+  size_t numChunks = chunks.size();
+  size_t i = 0;
+  size_t offset = 0;
+  while (i < numChunks) {
+    struct iovec iov[IOV_MAX];
+    int numIov = 0;
+    for (size_t j = i; (j < numChunks) && (numIov < IOV_MAX); j++) {
+      size_t skip = (j == i) ? offset : 0;
+      iov[numIov].iov_base = (void *) (chunks[j].data() + skip);
+      iov[numIov].iov_len = chunks[j].size() - skip;
+      numIov++;
+    }
+    ssize_t written = writev(fd, iov, numIov);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      writeError = errno;
+      return;
+    }
+    /* skip what has been written, which may end in the middle of a chunk */
+    auto left = (size_t) written;
+    while ((i < numChunks) && (left >= chunks[i].size() - offset)) {
+      left -= chunks[i].size() - offset;
+      offset = 0;
+      i++;
+    }
+    offset += left;
+  }
+}
@@ -0,0 +1,109 @@
+/*
+ * This file is part of the ACT library
+ *
+ * Copyright (c) 2021 Rui Li
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef DFLOWMAP_SRC_COMMON_OUTPUTSTREAM_H_
+#define DFLOWMAP_SRC_COMMON_OUTPUTSTREAM_H_
+
+#include <cstdio>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "common.h"
+
+/* stdio buffer of every output stream */
+#define OUTPUT_BUFFER_SIZE 1048576
+/* emission waits for the writer once this much output is pending */
+#define OUTPUT_MAX_PENDING 67108864
+
+/* An output file behind a plain FILE *, so the generators keep using fprintf.
+ * The output is collected in large in-memory chunks and drained to disk with
+ * writev by a background writer thread, so emission does not block on I/O.
+ * In-memory streams keep the output instead, e.g. to capture it in tests. */
+class OutputStream {
+ public:
+  /* returns nullptr if "path" cannot be opened for writing */
+  static OutputStream *openFile(const char *path);
+
+  static OutputStream *openMemory();
+
+  ~OutputStream();
+
+  FILE *getFp() { return fp; }
+
+  /* everything written so far, for in-memory streams */
+  String getContents();
+
+  /* flush the output and wait until the writer has drained it */
+  void close();
+
+  /* drain the output of every open file stream and stop its writer, so that
+   * a forked child inherits none of their locks; nothing may be written to
+   * them until resumeAll */
+  static void suspendAll();
+
+  static void resumeAll();
+
+ private:
+  /* the open file streams */
+  static Vector<OutputStream *> fileStreams;
+
+  explicit OutputStream(int fd);
+
+  static ssize_t cookieWrite(void *cookie, const char *buf, size_t size);
+
+  static int cookieClose(void *cookie);
+
+  void writerLoop();
+
+  void stopWriter();
+
+  void writeChunks(Vector<String> &chunks);
+
+  FILE *fp;
+
+  /* -1 for in-memory streams */
+  int fd;
+
+  bool closed;
+
+  /* errno of the first failed write, only touched by the writer until it is
+   * joined */
+  int writeError;
+
+  String contents;
+
+  std::mutex mutex;
+
+  std::condition_variable hasPending;
+
+  std::condition_variable hasRoom;
+
+  Vector<String> pending;
+
+  size_t pendingBytes;
+
+  bool closing;
+
+  std::thread writer;
+};
+
+#endif //DFLOWMAP_SRC_COMMON_OUTPUTSTREAM_H_
@@ -0,0 +1,41 @@
+/*
+ * This file is part of the ACT library
+ *
+ * Copyright (c) 2021 Rui Li
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+
+#include "StringBuilder.h"
+
+void StringBuilder::appendf(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  va_list argsCopy;
+  va_copy(argsCopy, args);
+  int len = vsnprintf(nullptr, 0, fmt, argsCopy);
+  va_end(argsCopy);
+  if (len < 0) {
+    printf("Fail to format the string `%s'!\n", fmt);
+    exit(-1);
+  }
+  size_t oldSize = buff.size();
+  /* the string keeps the terminating '\0' after its last char */
+  buff.resize(oldSize + len);
+  vsnprintf(&buff[oldSize], len + 1, fmt, args);
+  va_end(args);
+}
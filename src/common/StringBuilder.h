@@ -0,0 +1,68 @@
+/*
+ * This file is part of the ACT library
+ *
+ * Copyright (c) 2021 Rui Li
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef DFLOWMAP_SRC_COMMON_STRINGBUILDER_H_
+#define DFLOWMAP_SRC_COMMON_STRINGBUILDER_H_
+
+#include <cstdarg>
+#include <cstdio>
+#include "common.h"
+
+/* Append-only string with amortized growth. Every statement appended after
+ * beginStatement() is also indexed by its offset, so callers can get back to
+ * a single statement without rescanning the whole string. */
+class StringBuilder {
+ public:
+  StringBuilder() = default;
+
+  void append(const char *str) { buff.append(str); }
+
+  void appendf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+  /* the following appends belong to a new statement */
+  void beginStatement() { stmtOffsets.push_back(buff.size()); }
+
+  const char *c_str() const { return buff.c_str(); }
+
+  size_t size() const { return buff.size(); }
+
+  size_t getNumStatements() const { return stmtOffsets.size(); }
+
+  /* the text of the i-th statement, up to the end of the string */
+  const char *getStatement(size_t i) const {
+    return buff.c_str() + stmtOffsets[i];
+  }
+
+  const char *getLastStatement() const {
+    return stmtOffsets.empty() ? buff.c_str()
+                               : getStatement(stmtOffsets.size() - 1);
+  }
+
+  Vector<size_t> &getStatementOffsets() { return stmtOffsets; }
+
+ private:
+  String buff;
+
+  Vector<size_t> stmtOffsets;
+};
+
+#endif //DFLOWMAP_SRC_COMMON_STRINGBUILDER_H_
@@ -0,0 +1,88 @@
+/*
+ * This file is part of the ACT library
+ *
+ * Copyright (c) 2021 Rui Li
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+
+#include "SymbolTable.h"
+
+Vector<SymbolTable::Symbol> SymbolTable::symbols;
+std::unordered_map<std::string_view, SymbolId> SymbolTable::ids;
+std::unordered_map<act_connection *, SymbolId> SymbolTable::connectionIds;
+Arena SymbolTable::names(65536);
+
+SymbolId SymbolTable::intern(const char *name) {
+  auto idsIt = ids.find(std::string_view(name));
+  if (idsIt != ids.end()) {
+    return idsIt->second;
+  }
+  size_t len = strlen(name);
+  auto storedName = (char *) names.alloc(len + 1);
+  memcpy(storedName, name, len + 1);
+  SymbolId id = symbols.size();
+  symbols.push_back({storedName, NO_SYMBOL, NO_SYMBOL});
+  ids.insert({std::string_view(storedName, len), id});
+  return id;
+}
+
+SymbolId SymbolTable::intern(act_connection *connection) {
+  if (connection == nullptr) {
+    printf("Try to get the name of NULL act connection!\n");
+    exit(-1);
+  }
+  auto connectionIdsIt = connectionIds.find(connection);
+  if (connectionIdsIt != connectionIds.end()) {
+    return connectionIdsIt->second;
+  }
+  char buff[10240];
+  ActId *uid = connection->toid();
+  uid->sPrint(buff, 10240);
+  delete uid;
+  SymbolId id = intern(buff);
+  connectionIds.insert({connection, id});
+  return id;
+}
+
+SymbolId SymbolTable::normalize(SymbolId id, const char *toDel) {
+  const char *name = symbols[id].name;
+  if (!strpbrk(name, toDel)) {
+    return id;
+  }
+  String normName(name);
+  for (auto &c: normName) {
+    if (strchr(toDel, c)) c = '_';
+  }
+  return intern(normName.c_str());
+}
+
+SymbolId SymbolTable::getNormActId(SymbolId id) {
+  if (symbols[id].normActId == NO_SYMBOL) {
+    SymbolId normId = normalize(id, ".");
+    symbols[id].normActId = normId;
+  }
+  return symbols[id].normActId;
+}
+
+SymbolId SymbolTable::getNormInstance(SymbolId id) {
+  if (symbols[id].normInstance == NO_SYMBOL) {
+    SymbolId normId = normalize(id, "<>,");
+    symbols[id].normInstance = normId;
+  }
+  return symbols[id].normInstance;
+}
@@ -0,0 +1,82 @@
+/*
+ * This file is part of the ACT library
+ *
+ * Copyright (c) 2021 Rui Li
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef DFLOWMAP_SRC_COMMON_SYMBOLTABLE_H_
+#define DFLOWMAP_SRC_COMMON_SYMBOLTABLE_H_
+
+#include <act/act.h>
+#include <cstring>
+#include <string_view>
+#include <unordered_set>
+#include "common.h"
+#include "Arena.h"
+
+typedef unsigned SymbolId;
+
+template<class T> using SymbolMap = std::unordered_map<SymbolId, T>;
+
+typedef std::unordered_set<SymbolId> SymbolSet;
+
+/* Design-wide table of interned names. Every distinct channel, instance and
+ * process name is stored once and gets a compact id; its normalized forms are
+ * computed on first use. Interned names live until the program exits. */
+class SymbolTable {
+ public:
+  static SymbolId intern(const char *name);
+
+  /* id of the canonical name of the connection */
+  static SymbolId intern(act_connection *connection);
+
+  static const char *getName(SymbolId id) { return symbols[id].name; }
+
+  /* id of the name with '.' replaced by '_' */
+  static SymbolId getNormActId(SymbolId id);
+
+  /* id of the name with '<', '>' and ',' replaced by '_' */
+  static SymbolId getNormInstance(SymbolId id);
+
+  static unsigned size() { return symbols.size(); }
+
+ private:
+  typedef struct symbol {
+    const char *name;
+    /* ids of the normalized forms, or NO_SYMBOL if not computed yet */
+    SymbolId normActId;
+    SymbolId normInstance;
+  } Symbol;
+
+  static const SymbolId NO_SYMBOL = (SymbolId) -1;
+
+  static Vector<Symbol> symbols;
+
+  /* the keys point at the interned names */
+  static std::unordered_map<std::string_view, SymbolId> ids;
+
+  static std::unordered_map<act_connection *, SymbolId> connectionIds;
+
+  /* storage of the names */
+  static Arena names;
+
+  static SymbolId normalize(SymbolId id, const char *toDel);
+};
+
+#endif //DFLOWMAP_SRC_COMMON_SYMBOLTABLE_H_
@@ -27,13 +27,13 @@
 #include <string>
 #include <algorithm>
 #include <map>
+#include <unordered_map>
+#include "src/common/config.h"
 
 #define MAX_PROC_NAME_LEN 102400
 #define SHORT_STRING_LEN 1024
 #define MAX_INSTANCE_LEN 204800
 #define MAX_CLUSTER_PROC_NAME_LEN 102400
-#define MAX_CALC_LEN 1048576
-#define MAX_PROCESSES 500
 class act_connection;
 
 typedef std::string String;
@@ -50,6 +50,9 @@ using Map = std::map<T1, T2>;
 template<class T>
 using StringMap = std::map<String, T>;
 
+template<class T>
+using StringHashMap = std::unordered_map<String, T>;
+
 template<class T>
 using Vector = std::vector<T>;
 
@@ -66,6 +69,20 @@ typedef struct buffInfo {
   double* metric;
 } BuffInfo;
 
+/* an instance in the generated CHP, for the activity-based energy estimate */
+typedef struct instanceRecord {
+  /* the process it is instantiated in */
+  String process;
+  String instName;
+  String instance;
+  /* dynamic energy (e-15J) per token at each corner */
+  double energy[MAX_CORNERS];
+  /* send lines the instance logs in actsim for every token it handles */
+  unsigned sendsPerToken;
+  /* receive lines per token, or 0 if its receives are not counted */
+  unsigned receivesPerToken;
+} InstanceRecord;
+
 template<typename A, typename B>
 std::pair<B, A> flip_pair(const std::pair<A, B> &p) {
   return std::pair<B, A>(p.second, p.first);
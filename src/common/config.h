@@ -21,7 +21,20 @@
 
 #include "config_pkg.h"
 
-#define PIPELINE false
+/* pipeline_mode: the merges, splits, mixers and arbiters are all
+ * unpipelined, all pipelined, or each is picked by exploring the throughput
+ * and area models of its process */
+#define PIPELINE_NONE 0
+#define PIPELINE_ALL 1
+#define PIPELINE_EXPLORE 2
+/* bump whenever a change alters the netlist or the metric generated for an
+ * FU, so that the entries of the FU cache from older versions are missed */
+#define DFLOWMAP_CACHE_VERSION 1
+/* bump whenever a change alters the CHP, chplib or conf generated for a
+ * process, so that the process cache of older versions is missed */
+#define DFLOWMAP_PROC_CACHE_VERSION 1
+/* most process corners metrics are carried for in one run */
+#define MAX_CORNERS 8
 #ifdef FOUND_expropt
 #define LOGIC_OPTIMIZER true
 #else
@@ -45,3 +58,21 @@ extern char *cached_metrics;
 extern char *custom_metrics;
 extern char *custom_fu_dir;
 extern char *cache_dir;
+/* the output of every process of the last run, reused for the processes
+ * that have not changed since (see DflowMapPass) */
+extern char *proc_cache_dir;
+/* limits of the FU cache; 0 means unbounded */
+extern unsigned long cache_max_bytes;
+extern unsigned cache_max_entries;
+/* address of the shared FU cache (see CacheBackend::open), or nullptr */
+extern char *cache_server;
+/* cycle time (ps) slack matching buffers the processes for; 0 disables it */
+extern double target_cycle_time;
+extern int pipeline_mode;
+/* area (um^2) the pipelined units may add to a process in explore mode; 0
+ * means unbounded */
+extern double pipeline_area_budget;
+/* names of the process corners, each with its own metric files, .stat and
+ * .conf; corner 0 drives the mapping */
+extern unsigned num_corners;
+extern char **corner_names;
@@ -0,0 +1,203 @@
+/*
+ * This file is part of the ACT library
+ *
+ * Copyright (c) 2021 Rui Li
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+
+#include "ActivityLog.h"
+
+ActivityLog::ActivityLog(Vector<InstanceRecord> &records, Process *root)
+    : records(records) {
+  unmatchedLines = 0;
+  unsigned numRecords = records.size();
+  for (unsigned i = 0; i < numRecords; i++) {
+    recordIdx.insert({{records[i].process, records[i].instName}, i});
+  }
+  activityIdx.resize(numRecords, -1);
+  if (root) {
+    roots.push_back(root);
+    return;
+  }
+  ActNamespaceiter nsIt(ActNamespace::Global());
+  for (nsIt = nsIt.begin(); nsIt != nsIt.end(); nsIt++) {
+    ActNamespace *ns = *nsIt;
+    if (!ns) continue;
+    ActTypeiter typeIt(ns);
+    for (typeIt = typeIt.begin(); typeIt != typeIt.end(); typeIt++) {
+      auto *proc = dynamic_cast<Process *>(*typeIt);
+      if (proc && proc->isExpanded()) {
+        roots.push_back(proc);
+      }
+    }
+  }
+}
+
+static String stripIndex(const String &component) {
+  size_t pos = component.find('[');
+  return (pos == String::npos) ? component : component.substr(0, pos);
+}
+
+/* walk the instance path from proc; components[start] is an instance in
+ * proc */
+int ActivityLog::resolveFrom(Process *proc,
+                             Vector<String> &components,
+                             unsigned start) {
+  unsigned numComponents = components.size();
+  for (unsigned i = start; i < numComponents; i++) {
+    String component = stripIndex(components[i]);
+    if (i == numComponents - 1) {
+      auto recordIdxIt = recordIdx.find({proc->getName(), component});
+      return (recordIdxIt == recordIdx.end()) ? -1 : recordIdxIt->second;
+    }
+    InstType *instType = proc->CurScope()->Lookup(component.c_str());
+    if (!instType) return -1;
+    proc = dynamic_cast<Process *>(instType->BaseType());
+    if (!proc) return -1;
+  }
+  return -1;
+}
+
+/* the record of the instance at the path, or -1. The log may come from a
+ * test bench around the mapped processes, so the path is tried from each of
+ * its components downwards */
+int ActivityLog::resolvePath(const String &path) {
+  auto pathRecordsIt = pathRecords.find(path);
+  if (pathRecordsIt != pathRecords.end()) {
+    return pathRecordsIt->second;
+  }
+  Vector<String> components;
+  size_t begin = 0;
+  while (true) {
+    size_t end = path.find('.', begin);
+    components.push_back(path.substr(begin, end - begin));
+    if (end == String::npos) break;
+    begin = end + 1;
+  }
+  int res = -1;
+  unsigned numComponents = components.size();
+  for (unsigned start = 0; (start < numComponents) && (res < 0); start++) {
+    for (auto &root: roots) {
+      res = resolveFrom(root, components, start);
+      if (res >= 0) break;
+    }
+  }
+  pathRecords.insert({path, res});
+  return res;
+}
+
+void ActivityLog::read(const char *logFile) {
+  FILE *logFP = fopen(logFile, "r");
+  if (!logFP) {
+    printf("Could not open actsim log %s\n", logFile);
+    exit(-1);
+  }
+  char line[MAX_INSTANCE_LEN];
+  while (fgets(line, MAX_INSTANCE_LEN, logFP)) {
+    /* [<time>] <instance path> send (...), or receive (...) */
+    char *pos = line;
+    if (*pos == '[') {
+      pos = strchr(pos, ']');
+      if (!pos) continue;
+      pos++;
+    }
+    pos += strspn(pos, " \t");
+    size_t pathLen = strcspn(pos, " \t\n");
+    if (pathLen == 0) continue;
+    String path(pos, pathLen);
+    pos += pathLen;
+    pos += strspn(pos, " \t");
+    bool send = (strncmp(pos, "send", 4) == 0);
+    if (!send && (strncmp(pos, "receive", 7) != 0)) continue;
+    if (!path.empty() && (path.back() == ':')) {
+      path.pop_back();
+    }
+    if ((path.size() >= 2) && (path.front() == '<') && (path.back() == '>')) {
+      path = path.substr(1, path.size() - 2);
+    }
+    int record = resolvePath(path);
+    if (record < 0) {
+      unmatchedLines++;
+      continue;
+    }
+    if (activityIdx[record] < 0) {
+      activityIdx[record] = activities.size();
+      activities.push_back({(unsigned) record, 0, 0});
+    }
+    InstanceActivity &activity = activities[activityIdx[record]];
+    if (send) {
+      activity.sends++;
+    } else {
+      activity.receives++;
+    }
+  }
+  fclose(logFP);
+  if (debug_verbose) {
+    printf("Read %lu active instances from %s, %lu lines unmatched\n",
+           activities.size(), logFile, unmatchedLines);
+  }
+}
+
+void ActivityLog::print(FILE *statisticsFP, unsigned corner) {
+  /* instance, (# of tokens, dynamic energy (e-15J)) */
+  Vector<Pair<String, Pair<unsigned long, double>>> instEnergy;
+  StringMap<unsigned> instEnergyIdx;
+  double totalEnergy = 0;
+  unsigned long totalTokens = 0;
+  for (auto &activity: activities) {
+    InstanceRecord &record = records[activity.record];
+    unsigned long tokens = activity.sends / record.sendsPerToken;
+    if (record.receivesPerToken) {
+      tokens = std::max(tokens, activity.receives / record.receivesPerToken);
+    }
+    double energy = tokens * record.energy[corner];
+    totalEnergy += energy;
+    totalTokens += tokens;
+    auto instEnergyIdxIt = instEnergyIdx.find(record.instance);
+    if (instEnergyIdxIt == instEnergyIdx.end()) {
+      instEnergyIdx.insert({record.instance, instEnergy.size()});
+      instEnergy.push_back({record.instance, {tokens, energy}});
+    } else {
+      auto &entry = instEnergy[instEnergyIdxIt->second].second;
+      entry.first += tokens;
+      entry.second += energy;
+    }
+  }
+  std::stable_sort(instEnergy.begin(), instEnergy.end(),
+                   [](const Pair<String, Pair<unsigned long, double>> &lhs,
+                      const Pair<String, Pair<unsigned long, double>> &rhs) {
+                     return lhs.second.second > rhs.second.second;
+                   });
+  fprintf(statisticsFP, "Dynamic Energy Statistics:\n");
+  fprintf(statisticsFP,
+          "totalDynamicEnergy: %.2f, tokens: %lu, unmatched log lines: %lu\n",
+          totalEnergy, totalTokens, unmatchedLines);
+  fprintf(statisticsFP,
+          "instance name      # of tokens     energy     percentage\n");
+  for (auto &entry: instEnergy) {
+    double energy = entry.second.second;
+    double ratio = (totalEnergy > 0) ? energy / totalEnergy * 100 : 0;
+    fprintf(statisticsFP,
+            "%80.80s %5lu %5.2f %5.1f\n",
+            entry.first.c_str(),
+            entry.second.first,
+            energy,
+            ratio);
+  }
+  fprintf(statisticsFP, "\n");
+}
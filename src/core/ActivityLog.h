@@ -0,0 +1,82 @@
+/*
+ * This file is part of the ACT library
+ *
+ * Copyright (c) 2021 Rui Li
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef DFLOWMAP_SRC_CORE_ACTIVITYLOG_H_
+#define DFLOWMAP_SRC_CORE_ACTIVITYLOG_H_
+
+#include <cstdio>
+#include <cstring>
+#include <act/act.h>
+#include "src/common/common.h"
+#include "src/common/config.h"
+
+typedef struct instanceActivity {
+  /* index of the instance in the instance records */
+  unsigned record;
+  unsigned long sends;
+  unsigned long receives;
+} InstanceActivity;
+
+/* Dynamic energy from the activity in an actsim log of the generated CHP.
+ * The number of tokens of an instance is its number of sends divided by the
+ * sends per token. An instance that logs its receives too, like an FU, has
+ * handled at least as many tokens as it received, which also counts a token
+ * it was still working on when the log ended. Its dynamic energy is the
+ * number of tokens times its energy per token. Instances that do not log
+ * (sinks, buffers, unpipelined controls, or everything in quiet mode) are
+ * not counted. */
+class ActivityLog {
+ public:
+  /* root is the process simulated at the top, or nullptr to try every
+   * expanded process */
+  ActivityLog(Vector<InstanceRecord> &records, Process *root);
+
+  void read(const char *logFile);
+
+  /* the energy at the given corner */
+  void print(FILE *statisticsFP, unsigned corner = 0);
+
+ private:
+  Vector<InstanceRecord> &records;
+
+  Vector<Process *> roots;
+
+  /* (process, instance name), index of its record */
+  Map<Pair<String, String>, unsigned> recordIdx;
+
+  /* instance path in the log, index of its record or -1 */
+  StringMap<int> pathRecords;
+
+  /* in the order the instances are first seen */
+  Vector<InstanceActivity> activities;
+
+  /* index of the activity of each record, or -1 */
+  Vector<int> activityIdx;
+
+  unsigned long unmatchedLines;
+
+  int resolvePath(const String &path);
+
+  int resolveFrom(Process *proc, Vector<String> &components, unsigned start);
+};
+
+#endif //DFLOWMAP_SRC_CORE_ACTIVITYLOG_H_
@@ -0,0 +1,444 @@
+/*
+ * This file is part of the ACT library
+ *
+ * Copyright (c) 2021 Rui Li
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+
+#include <cctype>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include "src/common/Helper.h"
+#include "src/common/config.h"
+#include "MetricsDB.h"
+#include "CacheBackend.h"
+
+CacheBackend *CacheBackend::open(const char *spec) {
+  if (!strncmp(spec, "unix:", 5) || !strncmp(spec, "tcp:", 4)) {
+    return new RemoteCacheBackend(spec);
+  }
+  return new LocalCacheBackend(spec);
+}
+
+bool CacheBackend::isValidKey(const char *fuKey) {
+  if (!fuKey[0]) {
+    return false;
+  }
+  for (const char *c = fuKey; *c; c++) {
+    if (!isalnum((unsigned char) *c) && (*c != '_')) {
+      return false;
+    }
+  }
+  return true;
+}
+
+LocalCacheBackend::LocalCacheBackend(const char *dir) {
+  this->dir = dir;
+  indexFile = this->dir + "/fu.metrics";
+  createDirectoryIfNotExist(dir);
+  createFileIfNotExist(indexFile.c_str(), std::fstream::app);
+}
+
+String LocalCacheBackend::getPath(const char *fuKey, const char *ext) {
+  return dir + "/" + fuKey + ext;
+}
+
+String LocalCacheBackend::getNetlistFile(const char *fuKey) {
+  return getPath(fuKey, ".act");
+}
+
+bool LocalCacheBackend::getEntry(const char *fuKey, String &entry) {
+  std::ifstream entryFp(getPath(fuKey, ".metrics"));
+  if (entryFp.fail()) {
+    return false;
+  }
+  std::getline(entryFp, entry);
+  return !entry.empty();
+}
+
+bool LocalCacheBackend::get(const char *fuKey,
+                            String &entry,
+                            String &netlist) {
+  /* the netlist is published first, so it exists if the entry does */
+  return getEntry(fuKey, entry)
+      && readFile(getNetlistFile(fuKey).c_str(), netlist);
+}
+
+void LocalCacheBackend::put(const char *fuKey,
+                            const String &entry,
+                            const String &netlist) {
+  String line = entry;
+  if (line.empty() || (line.back() != '\n')) {
+    line.push_back('\n');
+  }
+  writeFileAtomic(getNetlistFile(fuKey).c_str(), netlist,
+                  "Fail to publish the cached netlist");
+  writeFileAtomic(getPath(fuKey, ".metrics").c_str(), line,
+                  "Fail to publish the cache entry");
+  /* the entry is complete without its index row; a row lost in a crash is
+   * added back by the next compaction */
+  std::lock_guard<std::mutex> guard(pendingMutex);
+  pendingIndex += line;
+}
+
+void LocalCacheBackend::flush() {
+  std::lock_guard<std::mutex> guard(pendingMutex);
+  if (pendingIndex.empty()) {
+    return;
+  }
+  appendFileLocked(indexFile.c_str(), pendingIndex,
+                   "Fail to update the cached metric file");
+  pendingIndex.clear();
+}
+
+int LocalCacheBackend::lock(const char *fuKey) {
+  return lockFile(getPath(fuKey, ".lock").c_str());
+}
+
+void LocalCacheBackend::touch(const char *fuKey) {
+  utimensat(AT_FDCWD, getPath(fuKey, ".metrics").c_str(), nullptr, 0);
+}
+
+void LocalCacheBackend::compact(unsigned long maxBytes, unsigned maxEntries) {
+  /* block appends to the index while it is rewritten; this also serializes
+   * the compaction of concurrent runs */
+  int indexFd = lockFile(indexFile.c_str());
+  std::ifstream indexFp(indexFile);
+  String line;
+  /* FU key, its line in the index, in the order the keys were first added */
+  Vector<Pair<String, String>> indexLines;
+  StringMap<unsigned> indexIdx;
+  unsigned numIndexLines = 0;
+  while (std::getline(indexFp, line)) {
+    String key;
+    double metric[4];
+    int metricCount =
+        MetricsDB::parseLine(line.c_str(), line.size(), key, metric);
+    if (metricCount == -1) continue;
+    numIndexLines++;
+    if ((metricCount != 4) || (indexIdx.find(key) != indexIdx.end())) {
+      continue;
+    }
+    indexIdx.insert({key, indexLines.size()});
+    indexLines.push_back({key, line});
+  }
+  indexFp.close();
+  /* FU key, (last use, size in bytes) of its entry */
+  StringMap<Pair<int64_t, uintmax_t>> entries;
+  uintmax_t totalSize = 0;
+  std::error_code ec;
+  for (auto &dirEntry: std::filesystem::directory_iterator(dir, ec)) {
+    const std::filesystem::path &path = dirEntry.path();
+    if ((path.extension() != ".metrics")
+        || (path.filename() == "fu.metrics")) {
+      continue;
+    }
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) continue;
+    String key = path.stem().string();
+    uintmax_t size = st.st_size;
+    std::filesystem::path netlist = path;
+    netlist.replace_extension(".act");
+    uintmax_t netlistSize = std::filesystem::file_size(netlist, ec);
+    if (!ec) size += netlistSize;
+    int64_t lastUse = (int64_t) st.st_mtim.tv_sec * 1000000000LL
+        + st.st_mtim.tv_nsec;
+    entries.insert({key, {lastUse, size}});
+    totalSize += size;
+  }
+  /* index rows from caches written before per-entry files; keep the ones
+   * whose netlist still exists */
+  for (auto &indexLine: indexLines) {
+    const char *key = indexLine.first.c_str();
+    if (entries.find(key) != entries.end()) continue;
+    uintmax_t netlistSize =
+        std::filesystem::file_size(getNetlistFile(key), ec);
+    if (ec) continue;
+    writeFileAtomic(getPath(key, ".metrics").c_str(), indexLine.second + "\n",
+                    "Fail to migrate the cache entry");
+    entries.insert({key, {0, indexLine.second.size() + 1 + netlistSize}});
+    totalSize += indexLine.second.size() + 1 + netlistSize;
+  }
+  /* evict the least recently used entries until the cache fits */
+  Vector<Pair<int64_t, String>> lru;
+  for (auto &entry: entries) {
+    lru.push_back({entry.second.first, entry.first});
+  }
+  std::sort(lru.begin(), lru.end());
+  unsigned numEvicted = 0;
+  for (auto &victim: lru) {
+    bool tooBig = (maxBytes > 0) && (totalSize > maxBytes);
+    bool tooMany = (maxEntries > 0) && (entries.size() > maxEntries);
+    if (!tooBig && !tooMany) break;
+    const char *key = victim.second.c_str();
+    /* an entry that is being used right now is not cold */
+    int lockFd = tryLockFile(getPath(key, ".lock").c_str());
+    if (lockFd < 0) continue;
+    unlink(getPath(key, ".metrics").c_str());
+    unlink(getNetlistFile(key).c_str());
+    /* a run waiting on the lock file notices it is gone and locks the
+     * new one */
+    unlink(getPath(key, ".lock").c_str());
+    unlockFile(lockFd);
+    totalSize -= entries.find(victim.second)->second.second;
+    entries.erase(victim.second);
+    numEvicted++;
+  }
+  /* rewrite the index without duplicates, broken or evicted rows; entries
+   * whose row got lost are added back */
+  String index;
+  unsigned numLive = 0;
+  for (auto &indexLine: indexLines) {
+    if (entries.find(indexLine.first) == entries.end()) continue;
+    index += indexLine.second + "\n";
+    numLive++;
+  }
+  for (auto &entry: entries) {
+    if (indexIdx.find(entry.first) != indexIdx.end()) continue;
+    if (getEntry(entry.first.c_str(), line)) {
+      index += line + "\n";
+    }
+    numLive++;
+  }
+  if ((numLive != numIndexLines) || numEvicted) {
+    writeFileAtomic(indexFile.c_str(), index, "Fail to compact the cache");
+    if (debug_verbose) {
+      printf("Compact the cache %s: %u entries (%ju bytes), %u evicted\n",
+             dir.c_str(), numLive, totalSize, numEvicted);
+    }
+  }
+  unlockFile(indexFd);
+}
+
+RemoteCacheBackend::RemoteCacheBackend(const char *address) {
+  this->address = address;
+  fd = -1;
+  owner = 0;
+  failed = false;
+}
+
+RemoteCacheBackend::~RemoteCacheBackend() {
+  if ((fd >= 0) && (owner == getpid())) {
+    close(fd);
+  }
+}
+
+static int openSocket(const char *address, bool server) {
+  int sock = -1;
+  if (!strncmp(address, "unix:", 5)) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(address + 5) >= sizeof(addr.sun_path)) {
+      return -1;
+    }
+    strcpy(addr.sun_path, address + 5);
+    sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+      return -1;
+    }
+    if (server) {
+      unlink(addr.sun_path);
+    }
+    int rc = server ? bind(sock, (struct sockaddr *) &addr, sizeof(addr))
+                    : connect(sock, (struct sockaddr *) &addr, sizeof(addr));
+    if (rc != 0) {
+      close(sock);
+      return -1;
+    }
+  } else if (!strncmp(address, "tcp:", 4)) {
+    String host = address + 4;
+    size_t colon = host.rfind(':');
+    if (colon == String::npos) {
+      return -1;
+    }
+    String port = host.substr(colon + 1);
+    host.resize(colon);
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = server ? AI_PASSIVE : 0;
+    struct addrinfo *addrs = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(),
+                    &hints, &addrs) != 0) {
+      return -1;
+    }
+    for (struct addrinfo *ai = addrs; ai; ai = ai->ai_next) {
+      sock = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                    ai->ai_protocol);
+      if (sock < 0) continue;
+      int one = 1;
+      if (server) {
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+      }
+      int rc = server ? bind(sock, ai->ai_addr, ai->ai_addrlen)
+                      : connect(sock, ai->ai_addr, ai->ai_addrlen);
+      if (rc == 0) break;
+      close(sock);
+      sock = -1;
+    }
+    freeaddrinfo(addrs);
+  }
+  if ((sock >= 0) && server && (listen(sock, 64) != 0)) {
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+int RemoteCacheBackend::connectTo(const char *address) {
+  return openSocket(address, false);
+}
+
+int RemoteCacheBackend::listenOn(const char *address) {
+  return openSocket(address, true);
+}
+
+bool RemoteCacheBackend::sendAll(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t sent = send(fd, data, len, MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += sent;
+    len -= sent;
+  }
+  return true;
+}
+
+bool RemoteCacheBackend::recvAll(int fd, String &data, size_t len) {
+  data.resize(len);
+  size_t got = 0;
+  while (got < len) {
+    ssize_t n = recv(fd, &data[got], len - got, 0);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    if (n == 0) {
+      return false;
+    }
+    got += n;
+  }
+  return true;
+}
+
+bool RemoteCacheBackend::recvLine(int fd, String &line) {
+  line.clear();
+  while (line.size() < 1024) {
+    char c;
+    ssize_t n = recv(fd, &c, 1, 0);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    if (n == 0) {
+      return false;
+    }
+    if (c == '\n') {
+      return true;
+    }
+    line.push_back(c);
+  }
+  return false;
+}
+
+bool RemoteCacheBackend::ensureConnected() {
+  if (failed) {
+    return false;
+  }
+  if ((fd >= 0) && (owner == getpid())) {
+    return true;
+  }
+  /* never share the connection of the parent with a forked worker; the
+   * inherited descriptor is closed in this process only */
+  if (fd >= 0) {
+    close(fd);
+  }
+  owner = getpid();
+  fd = connectTo(address.c_str());
+  if (fd < 0) {
+    disconnect("could not connect");
+    return false;
+  }
+  return true;
+}
+
+void RemoteCacheBackend::disconnect(const char *reason) {
+  printf("Cache server %s: %s; continue without it\n", address.c_str(),
+         reason);
+  if (fd >= 0) {
+    close(fd);
+    fd = -1;
+  }
+  failed = true;
+}
+
+bool RemoteCacheBackend::get(const char *fuKey,
+                             String &entry,
+                             String &netlist) {
+  if (!ensureConnected()) {
+    return false;
+  }
+  String request = String("GET ") + fuKey + "\n";
+  String reply;
+  if (!sendAll(fd, request.c_str(), request.size()) || !recvLine(fd, reply)) {
+    disconnect("lost the connection");
+    return false;
+  }
+  if (reply == "MISS") {
+    return false;
+  }
+  unsigned long entryLen, netlistLen;
+  if ((sscanf(reply.c_str(), "HIT %lu %lu", &entryLen, &netlistLen) != 2)
+      || (entryLen > MAX_CACHE_PAYLOAD) || (netlistLen > MAX_CACHE_PAYLOAD)
+      || !recvAll(fd, entry, entryLen) || !recvAll(fd, netlist, netlistLen)) {
+    disconnect("unexpected reply");
+    return false;
+  }
+  return true;
+}
+
+void RemoteCacheBackend::put(const char *fuKey,
+                             const String &entry,
+                             const String &netlist) {
+  if (!ensureConnected()) {
+    return;
+  }
+  char request[128];
+  snprintf(request, sizeof(request), "PUT %s %zu %zu\n", fuKey, entry.size(),
+           netlist.size());
+  String reply;
+  if (!sendAll(fd, request, strlen(request))
+      || !sendAll(fd, entry.c_str(), entry.size())
+      || !sendAll(fd, netlist.c_str(), netlist.size())
+      || !recvLine(fd, reply) || (reply != "OK")) {
+    disconnect("could not store an entry");
+  }
+}
@@ -0,0 +1,153 @@
+/*
+ * This file is part of the ACT library
+ *
+ * Copyright (c) 2021 Rui Li
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef DFLOWMAP_SRC_CORE_CACHEBACKEND_H_
+#define DFLOWMAP_SRC_CORE_CACHEBACKEND_H_
+
+#include <cstdio>
+#include <cstdint>
+#include <mutex>
+#include <sys/types.h>
+#include "src/common/common.h"
+
+/* no entry or netlist is anywhere near this large */
+#define MAX_CACHE_PAYLOAD (256UL << 20)
+
+/* Storage of the FU cache. An entry is addressed by its FU key and holds the
+ * metric line of the FU ("<key> <m0> <m1> <m2> <m3> ### env=.. sum=..") and
+ * its optimized netlist, in which the module is named after the key. */
+class CacheBackend {
+ public:
+  virtual ~CacheBackend() = default;
+
+  /* false if there is no entry for fuKey */
+  virtual bool get(const char *fuKey, String &entry, String &netlist) = 0;
+
+  virtual void put(const char *fuKey,
+                   const String &entry,
+                   const String &netlist) = 0;
+
+  /* "unix:<socket path>" and "tcp:<host>:<port>" connect to a cache server
+   * (see dflowcache), anything else is a cache directory */
+  static CacheBackend *open(const char *spec);
+
+  /* FU keys are used as file names, so only [A-Za-z0-9_] is accepted */
+  static bool isValidKey(const char *fuKey);
+};
+
+/* A cache directory: "<key>.metrics" holds the metric line of an entry and
+ * "<key>.act" its netlist. Both are renamed into place, the netlist first,
+ * so the entry file is the commit point of an entry. "fu.metrics" is an
+ * index of all metric lines, and "<key>.lock" serializes the generation and
+ * eviction of an entry across processes. */
+class LocalCacheBackend : public CacheBackend {
+ public:
+  explicit LocalCacheBackend(const char *dir);
+
+  bool get(const char *fuKey, String &entry, String &netlist) override;
+
+  void put(const char *fuKey,
+           const String &entry,
+           const String &netlist) override;
+
+  /* only the metric line of the entry */
+  bool getEntry(const char *fuKey, String &entry);
+
+  String getNetlistFile(const char *fuKey);
+
+  const char *getIndexFile() { return indexFile.c_str(); }
+
+  /* block until this process is the only one generating the entry of
+   * fuKey; returns the descriptor for unlockFile */
+  int lock(const char *fuKey);
+
+  /* mark the entry of fuKey as just used */
+  void touch(const char *fuKey);
+
+  /* append the index rows of the entries put since the last flush */
+  void flush();
+
+  /* evict the least recently used entries until at most maxBytes and
+   * maxEntries (0 means unbounded) are left, and rewrite the index without
+   * stale rows */
+  void compact(unsigned long maxBytes, unsigned maxEntries);
+
+ private:
+  String dir;
+
+  String indexFile;
+
+  /* index rows not written yet */
+  String pendingIndex;
+
+  std::mutex pendingMutex;
+
+  String getPath(const char *fuKey, const char *ext);
+};
+
+/* Client of a cache server. The protocol is a request line followed by the
+ * payload, one request at a time on a persistent connection:
+ *   "GET <key>\n"                           -> "HIT <m> <n>\n" entry netlist
+ *                                              or "MISS\n"
+ *   "PUT <key> <m> <n>\n" entry netlist     -> "OK\n"
+ * where m and n are the byte lengths of the entry and the netlist. A server
+ * that cannot be reached only costs cache misses. */
+class RemoteCacheBackend : public CacheBackend {
+ public:
+  explicit RemoteCacheBackend(const char *address);
+
+  ~RemoteCacheBackend() override;
+
+  bool get(const char *fuKey, String &entry, String &netlist) override;
+
+  void put(const char *fuKey,
+           const String &entry,
+           const String &netlist) override;
+
+  /* connect to or listen on "unix:<path>" or "tcp:<host>:<port>"; -1 on
+   * failure */
+  static int connectTo(const char *address);
+
+  static int listenOn(const char *address);
+
+  static bool sendAll(int fd, const char *data, size_t len);
+
+  static bool recvAll(int fd, String &data, size_t len);
+
+  static bool recvLine(int fd, String &line);
+
+ private:
+  String address;
+
+  int fd;
+
+  /* the process that owns fd; a forked worker opens its own connection */
+  pid_t owner;
+
+  bool failed;
+
+  bool ensureConnected();
+
+  void disconnect(const char *reason);
+};
+
+#endif //DFLOWMAP_SRC_CORE_CACHEBACKEND_H_
@@ -37,8 +37,6 @@ DflowGenerator::DflowGenerator(StringVec &argList,
   this->inBWMap = inBW;
   this->hiddenBWMap = hiddenBW;
   this->hiddenExprs = hiddenExprs;
-  calc = new char[MAX_CALC_LEN];
-  calc[0] = '\0';
 }
 
 bool DflowGenerator::isNewArg(const char *arg) {
@@ -49,7 +47,7 @@ bool DflowGenerator::isNewArg(const char *arg) {
 const char *DflowGenerator::handleEVar(const char *oriArgName,
                                        const char *mappedVarName,
                                        unsigned argBW) {
-  char *curArg = new char[10240];
+  char *curArg = newScratchChars(10240);
   int idx = searchStringVec(oriArgList, oriArgName);
   if (idx == -1) {
     unsigned numArgs = argList.size();
@@ -72,28 +70,26 @@ void DflowGenerator::printChpPort(const char *exprName,
                                   const int resSuffix,
                                   unsigned resBW) {
   resBWList.push_back(resBW);
-  char *subCalc = new char[1500];
-  sprintf(subCalc, "      res%d := %s;\n", resSuffix, exprName);
-  strcat(calc, subCalc);
+  calc.beginStatement();
+  calc.appendf("      res%d := %s;\n", resSuffix, exprName);
 }
 
 void DflowGenerator::printChpConcatExpr(StringVec &operandList,
                                         const int resSuffix,
                                         unsigned resBW) {
-  char *curCal = new char[MAX_CALC_LEN];
-  sprintf(curCal, "      res%d := {", resSuffix);
+  calc.beginStatement();
+  calc.appendf("      res%d := {", resSuffix);
   size_t numOps = operandList.size();
   for (size_t i = 0; i < numOps; i++) {
-    strcat(curCal, operandList[i].c_str());
+    calc.append(operandList[i].c_str());
     if (i != numOps - 1) {
-      strcat(curCal, ", ");
+      calc.append(", ");
     }
   }
-  strcat(curCal, "};\n");
-  strcat(calc, curCal);
+  calc.append("};\n");
   if (debug_verbose) {
     printf("concat expr res%d has bw %u\n", resSuffix, resBW);
-    printf("%s\n", curCal);
+    printf("%s\n", calc.getLastStatement());
   }
   if (resBW == 0) {
     printf("resBW is 0!\n");
@@ -106,12 +102,11 @@ void DflowGenerator::printChpUniExpr(const char *op,
                                      const char *exprName,
                                      const int resSuffix,
                                      unsigned resBW) {
-  char *curCal = new char[128 + strlen(exprName)];
-  sprintf(curCal, "      res%d := %s %s;\n", resSuffix, op, exprName);
-  strcat(calc, curCal);
+  calc.beginStatement();
+  calc.appendf("      res%d := %s %s;\n", resSuffix, op, exprName);
   if (debug_verbose) {
     printf("uni res%d has bw %u\n", resSuffix, resBW);
-    printf("%s\n", curCal);
+    printf("%s\n", calc.getLastStatement());
   }
   if (resBW == 0) {
     printf("resBW is 0!\n");
@@ -132,19 +127,18 @@ void DflowGenerator::printChpBinExpr(const char *op,
   }
   resBWList.push_back(resBW);
 
-  char *curCal = new char[300];
+  calc.beginStatement();
   bool binType = isBinType(exprType);
   if (binType) {
-    sprintf(curCal, "      res%d := int(%s %s %s);\n",
-            resSuffix, lexpr_name, op, rexpr_name);
+    calc.appendf("      res%d := int(%s %s %s);\n",
+                 resSuffix, lexpr_name, op, rexpr_name);
   } else {
-    sprintf(curCal, "      res%d := %s %s %s;\n",
-            resSuffix, lexpr_name, op, rexpr_name);
+    calc.appendf("      res%d := %s %s %s;\n",
+                 resSuffix, lexpr_name, op, rexpr_name);
   }
-  strcat(calc, curCal);
   if (debug_verbose) {
     printf("bin res%d has bw %u\n", resSuffix, resBW);
-    printf("%s\n", curCal);
+    printf("%s\n", calc.getLastStatement());
   }
 }
 
@@ -153,14 +147,12 @@ void DflowGenerator::printChpQueryExpr(const char *cexpr_name,
                                        const char *rexpr_name,
                                        const int resSuffix,
                                        unsigned resBW) {
-  char *curCal = new char[128 + strlen(cexpr_name) + strlen(lexpr_name)
-      + strlen(rexpr_name)];
-  sprintf(curCal, "      res%d := bool(%s) ? %s : %s;\n",
-          resSuffix, cexpr_name, lexpr_name, rexpr_name);
-  strcat(calc, curCal);
+  calc.beginStatement();
+  calc.appendf("      res%d := bool(%s) ? %s : %s;\n",
+               resSuffix, cexpr_name, lexpr_name, rexpr_name);
   if (debug_verbose) {
     printf("query res%d has bw %u\n", resSuffix, resBW);
-    printf("%s\n", curCal);
+    printf("%s\n", calc.getLastStatement());
   }
   if (resBW == 0) {
     printf("resBW is 0!\n");
@@ -192,10 +184,10 @@ void DflowGenerator::prepareQueryExprForOpt(const char *cexpr_name,
   Expr *lExpr = getExprFromName(lexpr_name, exprMap, false, lexpr_type);
   Expr *rExpr = getExprFromName(rexpr_name, exprMap, false, rexpr_type);
   Expr *rhs = getExprFromName(expr_name, exprMap, false, E_VAR);
-  Expr *expr = new Expr;
+  Expr *expr = newScratch<Expr>();
   expr->type = expr_type;
   expr->u.e.l = cExpr;
-  Expr *body_expr = new Expr;
+  Expr *body_expr = newScratch<Expr>();
   body_expr->type = body_expr_type;
   body_expr->u.e.l = lExpr;
   body_expr->u.e.r = rExpr;
@@ -221,7 +213,7 @@ void DflowGenerator::prepareBinExprForOpt(const char *lexpr_name,
   Expr *lExpr = getExprFromName(lexpr_name, exprMap, false, lexpr_type);
   Expr *rExpr = getExprFromName(rexpr_name, exprMap, false, rexpr_type);
   Expr *rhs = getExprFromName(expr_name, exprMap, false, E_VAR);
-  Expr *expr = new Expr;
+  Expr *expr = newScratch<Expr>();
   expr->type = expr_type;
   expr->u.e.l = lExpr;
   expr->u.e.r = rExpr;
@@ -243,7 +235,7 @@ void DflowGenerator::prepareUniExprForOpt(const char *lexpr_name,
                                           unsigned bw) {
   Expr *lExpr = getExprFromName(lexpr_name, exprMap, false, lexpr_type);
   Expr *rhs = getExprFromName(expr_name, exprMap, false, E_VAR);
-  Expr *expr = new Expr;
+  Expr *expr = newScratch<Expr>();
   expr->type = expr_type;
   expr->u.e.l = lExpr;
   hiddenBWMap.insert({expr_name, bw});
@@ -262,7 +254,7 @@ void DflowGenerator::prepareConcatExprForOpt(StringVec &operandList,
                                              const char *expr_name,
                                              unsigned bw) {
   Expr *rhs = getExprFromName(expr_name, exprMap, false, E_VAR);
-  Expr *expr = new Expr;
+  Expr *expr = newScratch<Expr>();
   expr->type = E_CONCAT;
   Expr *rootExpr = expr;
   size_t numOps = operandList.size();
@@ -270,7 +262,7 @@ void DflowGenerator::prepareConcatExprForOpt(StringVec &operandList,
     Expr *opExpr =
         getExprFromName(operandList[i].c_str(), exprMap, false, opTypeList[i]);
     expr->u.e.l = opExpr;
-    expr->u.e.r = new Expr;
+    expr->u.e.r = newScratch<Expr>();
     expr = expr->u.e.r;
   }
   hiddenBWMap.insert({expr_name, bw});
@@ -285,7 +277,11 @@ void DflowGenerator::prepareConcatExprForOpt(StringVec &operandList,
 }
 
 const char *DflowGenerator::getCalc() {
-  return calc;
+  return calc.c_str();
+}
+
+Vector<size_t> &DflowGenerator::getCalcStatementOffsets() {
+  return calc.getStatementOffsets();
 }
 
 StringVec &DflowGenerator::getArgList() {
@@ -332,6 +328,6 @@ void DflowGenerator::dump() {
     printf("%u ", resBW);
   }
   printf("\n");
-  printf("calc: %s\n", calc);
+  printf("calc: %s\n", calc.c_str());
 }
 
@@ -25,6 +25,7 @@
 #include <cstring>
 #include "src/common/common.h"
 #include "src/common/Helper.h"
+#include "src/common/StringBuilder.h"
 #include "src/common/config.h"
 
 class DflowGenerator {
@@ -106,6 +107,9 @@ class DflowGenerator {
 
   const char *getCalc();
 
+  /* offset of every statement in the calc body */
+  Vector<size_t> &getCalcStatementOffsets();
+
   StringVec &getArgList();
 
   UIntVec &getArgBWList();
@@ -123,7 +127,7 @@ class DflowGenerator {
   void dump();
 
  private:
-  char *calc;
+  StringBuilder calc;
   StringVec argList;
   StringVec oriArgList;
   UIntVec argBWList;
@@ -0,0 +1,180 @@
+/*
+ * This file is part of the ACT library
+ *
+ * Copyright (c) 2021 Rui Li
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+
+#include "MetricModel.h"
+
+static const char *modelFamilies[] = {"copy", "pipe_merge", "unpipe_merge",
+                                      "pipe_split", "unpipe_split"};
+
+/* parse "<family>_<p0>_<p1>_..._" */
+static bool parseParams(const char *name, const char *family, UIntVec &params) {
+  size_t familyLen = strlen(family);
+  if (strncmp(name, family, familyLen) || (name[familyLen] != '_')) {
+    return false;
+  }
+  const char *pos = name + familyLen + 1;
+  while (*pos) {
+    char *end;
+    unsigned long param = strtoul(pos, &end, 10);
+    if ((end == pos) || (*end != '_')) {
+      return false;
+    }
+    params.push_back(param);
+    pos = end + 1;
+  }
+  return true;
+}
+
+void MetricModel::addSample(const char *normInstance, const double *metric) {
+  for (auto &family: modelFamilies) {
+    UIntVec params;
+    if (!parseParams(normInstance, family, params)) continue;
+    if (!strcmp(family, "copy")) {
+      /* copy<bw,numOut> */
+      if (params.size() != 2) return;
+      samples[{family, 0}][params[1]][params[0]] = metric;
+    } else {
+      /* merge/split<numIn/numOut,guardBW,bw> */
+      if (params.size() != 3) return;
+      samples[{family, params[1]}][params[0]][params[2]] = metric;
+    }
+    return;
+  }
+}
+
+/* interpolate the points (sorted by x) at x, or extrapolate the closest
+ * two */
+static bool interpolate(Vector<Pair<unsigned, const double *>> &points,
+                        unsigned x,
+                        double metric[4]) {
+  unsigned numPoints = points.size();
+  for (auto &point: points) {
+    if (point.first == x) {
+      memcpy(metric, point.second, 4 * sizeof(double));
+      return true;
+    }
+  }
+  if (numPoints < 2) {
+    return false;
+  }
+  unsigned hi = 1;
+  while ((hi < numPoints - 1) && (points[hi].first < x)) {
+    hi++;
+  }
+  unsigned lo = hi - 1;
+  double x0 = points[lo].first;
+  double x1 = points[hi].first;
+  double t = ((double) x - x0) / (x1 - x0);
+  for (int i = 0; i < 4; i++) {
+    double y0 = points[lo].second[i];
+    double y1 = points[hi].second[i];
+    metric[i] = y0 + t * (y1 - y0);
+    if (metric[i] < 0) {
+      metric[i] = 0;
+    }
+  }
+  return true;
+}
+
+bool MetricModel::estimate(Curves &curves,
+                           unsigned fan,
+                           unsigned bw,
+                           bool exclude,
+                           unsigned excludeFan,
+                           unsigned excludeBW,
+                           double metric[4]) {
+  /* the metric at bw of every fan, then across the fans */
+  Vector<double> fanMetrics(4 * curves.size());
+  Vector<Pair<unsigned, const double *>> fanPoints;
+  for (auto &curvesIt: curves) {
+    unsigned curFan = curvesIt.first;
+    Vector<Pair<unsigned, const double *>> bwPoints;
+    for (auto &curveIt: curvesIt.second) {
+      if (exclude && (curFan == excludeFan) && (curveIt.first == excludeBW)) {
+        continue;
+      }
+      bwPoints.emplace_back(curveIt.first, curveIt.second);
+    }
+    double *fanMetric = &fanMetrics[4 * fanPoints.size()];
+    if (interpolate(bwPoints, bw, fanMetric)) {
+      fanPoints.emplace_back(curFan, fanMetric);
+    }
+  }
+  return interpolate(fanPoints, fan, metric);
+}
+
+bool MetricModel::predict(const char *family,
+                          unsigned fan,
+                          unsigned guardBW,
+                          unsigned bw,
+                          double metric[4]) {
+  if (!strcmp(family, "copy")) {
+    guardBW = 0;
+  }
+  auto samplesIt = samples.find({family, guardBW});
+  if (samplesIt == samples.end()) {
+    return false;
+  }
+  return estimate(samplesIt->second, fan, bw, false, 0, 0, metric);
+}
+
+void MetricModel::printError(FILE *statisticsFP) {
+  fprintf(statisticsFP, "Metric Model Error (leave-one-out):\n");
+  fprintf(statisticsFP,
+          "primitive      # of entries     mean error (%%)     max error (%%)\n");
+  StringMap<Pair<unsigned, Pair<double, double>>> familyErrors;
+  for (auto &samplesIt: samples) {
+    const String &family = samplesIt.first.first;
+    Curves &curves = samplesIt.second;
+    for (auto &curvesIt: curves) {
+      for (auto &curveIt: curvesIt.second) {
+        double metric[4];
+        if (!estimate(curves, curvesIt.first, curveIt.first, true,
+                      curvesIt.first, curveIt.first, metric)) {
+          continue;
+        }
+        /* the largest relative error of the four metrics */
+        double error = 0;
+        for (int i = 0; i < 4; i++) {
+          double exact = curveIt.second[i];
+          if (exact != 0) {
+            error = std::max(error, fabs(metric[i] - exact) / fabs(exact));
+          }
+        }
+        auto &record = familyErrors[family];
+        record.first++;
+        record.second.first += error;
+        record.second.second = std::max(record.second.second, error);
+      }
+    }
+  }
+  for (auto &familyErrorsIt: familyErrors) {
+    auto &record = familyErrorsIt.second;
+    fprintf(statisticsFP,
+            "%20.20s %5u %5.1f %5.1f\n",
+            familyErrorsIt.first.c_str(),
+            record.first,
+            100 * record.second.first / record.first,
+            100 * record.second.second);
+  }
+  fprintf(statisticsFP, "\n");
+}
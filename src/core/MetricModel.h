@@ -0,0 +1,71 @@
+/*
+ * This file is part of the ACT library
+ *
+ * Copyright (c) 2021 Rui Li
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef DFLOWMAP_SRC_CORE_METRICMODEL_H_
+#define DFLOWMAP_SRC_CORE_METRICMODEL_H_
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include "src/common/common.h"
+
+/* Metric of the parameterized stdlib primitives (copy, merge and split)
+ * for any bitwidth and fan-in/out, fitted from the exact entries of the
+ * metric file. Within one primitive and guard bitwidth, every fan-in/out
+ * with at least two entries is piecewise-linear in the bitwidth, and the
+ * fan-ins/outs are in turn interpolated piecewise-linearly; beyond the
+ * entries the closest two are extrapolated. */
+class MetricModel {
+ public:
+  /* use the metric of a normalized instance name if it is a primitive */
+  void addSample(const char *normInstance, const double *metric);
+
+  /* the metric of family<fan, guardBW, bw> ("copy" ignores guardBW); false
+   * if there are too few entries for it */
+  bool predict(const char *family,
+               unsigned fan,
+               unsigned guardBW,
+               unsigned bw,
+               double metric[4]);
+
+  bool empty() { return samples.empty(); }
+
+  /* leave-one-out error of the model against each exact entry */
+  void printError(FILE *statisticsFP);
+
+ private:
+  /* fan, bw, metric */
+  typedef Map<unsigned, Map<unsigned, const double *>> Curves;
+
+  /* (family, guard bitwidth), its curves */
+  Map<Pair<String, unsigned>, Curves> samples;
+
+  bool estimate(Curves &curves,
+                unsigned fan,
+                unsigned bw,
+                bool exclude,
+                unsigned excludeFan,
+                unsigned excludeBW,
+                double metric[4]);
+};
+
+#endif //DFLOWMAP_SRC_CORE_METRICMODEL_H_
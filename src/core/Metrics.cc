@@ -22,48 +22,42 @@
 #include "Metrics.h"
 
 void Metrics::updateMetrics(const char *instance, double *metric) {
-  const char *normInstance = getNormInstanceName(instance);
-  for (auto &opMetricsIt: opMetrics) {
-    if (!strcmp(opMetricsIt.first, normInstance)) {
-      if (debug_verbose) {
-        printf("We already have metric info for (%s, %s)\n",
-               instance, normInstance);
-      }
-      double *oldMetric = opMetricsIt.second;
-      if ((oldMetric[0] != metric[0])
-          || (oldMetric[1] != metric[1])
-          || (oldMetric[2] != metric[2])
-          || (oldMetric[3] != metric[3])) {
-        printf("We find different metric record for %s\n", normInstance);
-        exit(-1);
-      }
-      return;
+  SymbolId normId = getNormInstanceId(instance);
+  const char *normInstance = SymbolTable::getName(normId);
+  double *oldMetric = findOpMetric(normId);
+  if (oldMetric) {
+    if (debug_verbose) {
+      printf("We already have metric info for (%s, %s)\n",
+             instance, normInstance);
+    }
+    if (memcmp(oldMetric, metric, metricSize() * sizeof(double))) {
+      printf("We find different metric record for %s\n", normInstance);
+      exit(-1);
     }
+    recordMetricDep(normId, oldMetric);
+    return;
   }
-  opMetrics.insert(std::make_pair(normInstance, metric));
+  opMetrics.insert({normId, metric});
+  recordMetricDep(normId, metric);
 }
 
 void Metrics::updateCachedMetrics(const char *instance, double *metric) {
-  const char *normInstance = getNormInstanceName(instance);
-  for (auto &cachedMetricsIt: cachedMetrics) {
-    if (!strcmp(cachedMetricsIt.first, normInstance)) {
-      if (debug_verbose) {
-        printf("We already have metric info for (%s, %s) in the cache\n",
-               instance, normInstance);
-      }
-      double *oldMetric = cachedMetricsIt.second;
-      if ((oldMetric[0] != metric[0])
-          || (oldMetric[1] != metric[1])
-          || (oldMetric[2] != metric[2])
-          || (oldMetric[3] != metric[3])) {
-        printf("We find different metric record for %s in the cache\n",
-               normInstance);
-        exit(-1);
-      }
-      return;
+  SymbolId normId = getNormInstanceId(instance);
+  const char *normInstance = SymbolTable::getName(normId);
+  double *oldMetric = findCachedMetric(normId);
+  if (oldMetric) {
+    if (debug_verbose) {
+      printf("We already have metric info for (%s, %s) in the cache\n",
+             instance, normInstance);
+    }
+    if (memcmp(oldMetric, metric, metricSize() * sizeof(double))) {
+      printf("We find different metric record for %s in the cache\n",
+             normInstance);
+      exit(-1);
     }
+    return;
   }
-  cachedMetrics.insert(std::make_pair(normInstance, metric));
+  cachedMetrics.insert({normId, metric});
 }
 
 double *Metrics::getOpMetric(const char *instance) {
@@ -74,15 +68,15 @@ double *Metrics::getOpMetric(const char *instance) {
     printf("Try to get metric for null instance!\n");
     exit(-1);
   }
-  const char *normInstance = getNormInstanceName(instance);
+  SymbolId normId = getNormInstanceId(instance);
+  const char *normInstance = SymbolTable::getName(normId);
   if (debug_verbose) {
     printf("get op metric for (%s, %s)\n", instance, normInstance);
   }
-  for (auto &opMetricsIt: opMetrics) {
-    if (!strcmp(opMetricsIt.first, normInstance)) {
-      double *metric = opMetricsIt.second;
-      return metric;
-    }
+  double *metric = findOpMetric(normId);
+  if (metric) {
+    recordMetricDep(normId, metric);
+    return metric;
   }
   if (debug_verbose) {
     printf("We don't have metric info for (`%s`,`%s')\n",
@@ -92,7 +86,7 @@ double *Metrics::getOpMetric(const char *instance) {
   return nullptr;
 }
 
-double *Metrics::getCachedMetric(const char *instance) {
+double *Metrics::getCachedMetric(const char *instance, const char *fuKey) {
   if (!_have_metrics) {
     return NULL;
   }
@@ -100,26 +94,24 @@ double *Metrics::getCachedMetric(const char *instance) {
     printf("Try to get metric for null instance!\n");
     exit(-1);
   }
-  const char *normInstance = getNormInstanceName(instance);
+  SymbolId normId = getNormInstanceId(instance);
+  const char *normInstance = SymbolTable::getName(normId);
   if (debug_verbose) {
-    printf("get op metric for (%s, %s) from cache\n", instance, normInstance);
-  }
-  for (auto &cachedMetricsIt: cachedMetrics) {
-    if (!strcmp(cachedMetricsIt.first, normInstance)) {
-      /* copy the netlist file from cache to the output directory */
-      char *cached_netlist_file =
-          new char[strlen(cache_dir) + strlen(normInstance) + 8];
-      sprintf(cached_netlist_file, "%s/%s.act", cache_dir, normInstance);
-      char *errMsg = new char[128];
-      sprintf(errMsg,
-              "Fail to copy the optimized netlist file from cache to the output directory!\n");
-      copyFileToTargetDir(cached_netlist_file, custom_fu_dir, errMsg);
-      /* update the local metric file */
-      double *metric = cachedMetricsIt.second;
-      writeLocalMetricFile(instance, metric);
-      /* return the perf metric */
-      return metric;
+    printf("get op metric for (%s, %s) from cache entry %s\n", instance,
+           normInstance, fuKey);
+  }
+  double *metric = findCachedMetric(SymbolTable::intern(fuKey));
+  if (metric) {
+    if (!copyCachedNetlist(fuKey, normInstance)) {
+      /* the caller regenerates it */
+      cachedMetrics.erase(SymbolTable::intern(fuKey));
+      return nullptr;
     }
+    /* update the local metric file */
+    updateMetrics(instance, metric);
+    writeLocalMetricFile(instance, metric);
+    /* return the perf metric */
+    return metric;
   }
   if (debug_verbose) {
     printf("We don't have metric info for (`%s`,`%s') in the cache\n",
@@ -129,114 +121,362 @@ double *Metrics::getCachedMetric(const char *instance) {
   return nullptr;
 }
 
-double Metrics::getLP(double metric[4]) {
+bool Metrics::copyCachedNetlist(const char *fuKey, const char *normInstance) {
+  /* the cached netlist is stored under the FU key; copy it to the output
+   * directory under the name of this instance */
+  String cached_netlist_file =
+      localCache->getNetlistFile(getCornerKey(fuKey, 0));
+  char *netlist_file =
+      newScratchChars(strlen(custom_fu_dir) + strlen(normInstance) + 8);
+  sprintf(netlist_file, "%s/%s.act", custom_fu_dir, normInstance);
+  char *errMsg = newScratchChars(128);
+  sprintf(errMsg,
+          "Fail to copy the optimized netlist file from cache to the output directory!\n");
+  if (!copyFileRenaming(cached_netlist_file.c_str(), netlist_file, fuKey,
+                        normInstance, errMsg)) {
+    return false;
+  }
+  for (unsigned c = 0; c < num_corners; c++) {
+    localCache->touch(getCornerKey(fuKey, c));
+  }
+  return true;
+}
+
+double Metrics::getLP(double *metric, unsigned corner) {
   if (!metric) {
     printf("Try to extract LP for null metric!\n");
     exit(-1);
   }
-  return metric[0];
+  return metric[4 * corner + 0];
 }
 
-double Metrics::getEnergy(double metric[4]) {
+double Metrics::getEnergy(double *metric, unsigned corner) {
   if (!metric) {
     printf("Try to extract energy for null metric!\n");
     exit(-1);
   }
-  return metric[1];
+  return metric[4 * corner + 1];
 }
 
-double Metrics::getDelay(double metric[4]) {
+double Metrics::getDelay(double *metric, unsigned corner) {
   if (!metric) {
     printf("Try to extract delay for null metric!\n");
     exit(-1);
   }
-  return metric[2];
+  return metric[4 * corner + 2];
 }
 
-double Metrics::getArea(double metric[4]) {
+double Metrics::getArea(double *metric, unsigned corner) {
   if (!metric) {
     printf("Try to extract area for null metric!\n");
     exit(-1);
   }
-  return metric[3];
+  return metric[4 * corner + 3];
 }
 
 void Metrics::printOpMetrics() {
   printf("Info in opMetrics:\n");
   for (auto &opMetricsIt: opMetrics) {
-    printf("%s ", opMetricsIt.first);
+    printf("%s ", SymbolTable::getName(opMetricsIt.first));
   }
   printf("\n");
 }
 
+String Metrics::formatMetricLine(const char *instance, double *metric) {
+  std::ostringstream line;
+  line << instance << "  " << metric[0] << "  " << metric[1] << "  "
+       << metric[2] << "  " << metric[3];
+  return line.str();
+}
+
 void Metrics::writeLocalMetricFile(const char *instance, double *metric) {
-  const char *normInstance = getNormInstanceName(instance);
-  std::ofstream metricFp;
-  metricFp.open(custom_metrics, std::ios_base::app);
-  metricFp << normInstance << "  " << metric[0] << "  " << metric[1] << "  "
-           << metric[2] << "  " << metric[3] << "\n";
-  metricFp.close();
+  if (recordStatistics(METRIC_STAT, instance, metric, 0, 0)) {
+    return;
+  }
+  SymbolId normId = getNormInstanceId(instance);
+  if (!localMetrics.insert(normId).second) {
+    return;
+  }
+  const char *normInstance = SymbolTable::getName(normId);
+  bool full = false;
+  for (unsigned c = 0; c < pendingLocalMetrics.size(); c++) {
+    pendingLocalMetrics[c] +=
+        formatMetricLine(normInstance, metric + 4 * c) + "\n";
+    full = full || (pendingLocalMetrics[c].size() >= METRICS_FLUSH_SIZE);
+  }
+  if (full) {
+    flushMetricFiles();
+  }
+}
+
+void Metrics::flushMetricFiles() {
+  for (unsigned c = 0; c < pendingLocalMetrics.size(); c++) {
+    if (!pendingLocalMetrics[c].empty()) {
+      appendFileLocked(customMetricsFiles[c], pendingLocalMetrics[c],
+                       "Fail to update the local metric file");
+      pendingLocalMetrics[c].clear();
+    }
+  }
+  if (localCache) {
+    localCache->flush();
+  }
+}
+
+const char *Metrics::getCornerKey(const char *fuKey, unsigned corner) {
+  if (corner == 0) {
+    return fuKey;
+  }
+  char *key = newScratchChars(strlen(fuKey) + strlen(corner_names[corner]) + 2);
+  sprintf(key, "%s_%s", fuKey, corner_names[corner]);
+  return key;
 }
 
-void Metrics::writeCachedMetricFile(const char *instance, double *metric) {
-  const char *normInstance = getNormInstanceName(instance);
-  std::ofstream metricFp;
-  metricFp.open(cached_metrics, std::ios_base::app);
-  metricFp << normInstance << "  " << metric[0] << "  " << metric[1] << "  "
-           << metric[2] << "  " << metric[3] << "\n";
-  metricFp.close();
+void Metrics::publishCacheEntry(const char *instance,
+                                const char *fuKey,
+                                double *metric) {
+  SymbolId normId = getNormInstanceId(instance);
+  const char *normInstance = SymbolTable::getName(normId);
+  /* the netlist of the FU, with the module named after the key */
+  char *netlist_file =
+      newScratchChars(strlen(custom_fu_dir) + strlen(normInstance) + 8);
+  sprintf(netlist_file, "%s/%s.act", custom_fu_dir, normInstance);
+  /* every corner is an entry of its own, so that each one is complete */
+  for (unsigned c = 0; c < num_corners; c++) {
+    const char *key = getCornerKey(fuKey, c);
+    String entry = formatMetricLine(key, metric + 4 * c);
+    char stamp[64];
+    sprintf(stamp, "  ### env=%016llx sum=%08x\n",
+            (unsigned long long) cacheFingerprints[c],
+            MetricsDB::checksum(entry.c_str(), entry.size()));
+    entry += stamp;
+    String netlist =
+        readFileRenaming(netlist_file, normInstance, key,
+                         "Fail to read the optimized netlist file");
+    localCache->put(key, entry, netlist);
+    if (remoteCache) {
+      remoteCache->put(key, entry, netlist);
+    }
+  }
 }
 
-void Metrics::readMetricsFile(const char *metricsFP, bool forCache) {
+bool Metrics::parseCacheEntry(const char *cornerKey,
+                              const String &entry,
+                              unsigned corner,
+                              double *metric) {
+  String instance;
+  if ((MetricsDB::parseLine(entry.c_str(), entry.size(), instance, metric)
+      != 4) || (instance != cornerKey)) {
+    if (debug_verbose) {
+      printf("Skip the broken cache entry %s\n", cornerKey);
+    }
+    return false;
+  }
+  const char *env = strstr(entry.c_str(), "env=");
+  if (env && (strtoull(env + 4, nullptr, 16) != cacheFingerprints[corner])) {
+    if (debug_verbose) {
+      printf("Skip the cache entry %s of another environment\n", cornerKey);
+    }
+    return false;
+  }
+  return true;
+}
+
+bool Metrics::readCornerEntry(const char *fuKey,
+                              unsigned corner,
+                              double *metric) {
+  const char *key = getCornerKey(fuKey, corner);
+  String entry;
+  if (localCache->getEntry(key, entry)) {
+    return parseCacheEntry(key, entry, corner, metric);
+  }
+  /* fetch the entry from the shared cache, and keep a local copy */
+  String netlist;
+  if (!remoteCache || !remoteCache->get(key, entry, netlist)) {
+    return false;
+  }
+  if (!parseCacheEntry(key, entry, corner, metric)) {
+    return false;
+  }
   if (debug_verbose) {
-    printf("Read metric file: %s\n", metricsFP);
+    printf("Fetched cache entry %s from %s\n", key, cache_server);
   }
-  std::ifstream metricFp(metricsFP);
-  if (metricFp.fail()) {
+  localCache->put(key, entry, netlist);
+  return true;
+}
+
+double *Metrics::readCacheEntry(const char *fuKey) {
+  double metric[4 * MAX_CORNERS];
+  for (unsigned c = 0; c < num_corners; c++) {
+    if (!readCornerEntry(fuKey, c, metric + 4 * c)) {
+      return nullptr;
+    }
+  }
+  return newMetric(metric);
+}
+
+void Metrics::compactCache() {
+  localCache->compact(cache_max_bytes, cache_max_entries);
+}
+
+void Metrics::openMetricsDB() {
+  bool exists = true;
+  for (unsigned c = 0; c < num_corners; c++) {
+    const char *stdFile = getCornerFile(std_metrics, corner_names[c]);
+    const char *customFile = getCornerFile(custom_metrics, corner_names[c]);
+    createFileIfNotExist(customFile, std::fstream::app);
+    stdMetricsDBs.push_back(new MetricsDB(stdFile));
+    customMetricsDBs.push_back(new MetricsDB(customFile));
+    customMetricsFiles.push_back(customFile);
+    pendingLocalMetrics.emplace_back();
+    metricModels.emplace_back();
+    if ((c > 0) && stdMetricsDBs[0]->exists()
+        && !stdMetricsDBs[c]->exists()) {
+      /* without it the run would silently lose the metrics of all corners */
+      printf("The metric file %s of corner %s does not exist!\n", stdFile,
+             corner_names[c]);
+      exit(-1);
+    }
+    exists = exists && stdMetricsDBs[c]->exists()
+        && customMetricsDBs[c]->exists();
+  }
+  localCache = new LocalCacheBackend(cache_dir);
+  remoteCache = cache_server ? CacheBackend::open(cache_server) : nullptr;
+  cachedMetricsDB = new MetricsDB(localCache->getIndexFile(), true);
+  if (!exists || !cachedMetricsDB->exists()) {
     if (debug_verbose) {
-      printf ("--> failed to open file!\n");
+      printf("--> failed to open the metric files!\n");
     }
     _have_metrics = false;
-    return;
   }
-  std::string line;
-  while (std::getline(metricFp, line)) {
-    std::istringstream iss(line);
-    char *instance = new char[MAX_INSTANCE_LEN];
-    int metricCount = -1;
-    auto metric = new double[4];
-    bool emptyLine = true;
-    do {
-      std::string numStr;
-      iss >> numStr;
-      if (numStr.rfind("###", 0) == 0) break;
-      if (!numStr.empty()) {
-        emptyLine = false;
-        if (metricCount >= 0) {
-          metric[metricCount] = std::strtod(numStr.c_str(), nullptr);
-        } else {
-          sprintf(instance, "%s", numStr.c_str());
-        }
-        metricCount++;
-      }
-    } while (iss);
-    if (!emptyLine && (metricCount != 4)) {
-      printf("%s has %d metrics!\n", metricsFP, metricCount);
+  for (unsigned c = 0; c < num_corners; c++) {
+    cacheFingerprints.push_back(genCacheFingerprint(c));
+  }
+}
+
+uint64_t Metrics::genCacheFingerprint(unsigned corner) {
+  /* everything besides the FU itself that its netlist and metric depend
+   * on: the tool version, the logic optimizer, the cell library and the
+   * metrics of the bundled-data control circuit */
+  std::ostringstream env;
+  env << "dflowmap cache v" << DFLOWMAP_CACHE_VERSION << "\n";
+  env << (COMMERCIAL_LOGIC_OPTIMIZER ? "genus" : "yosys") << "\n";
+  char *act_home = getenv("ACT_HOME");
+  if (act_home) {
+    String cellLib = String(act_home) + "/act/std/cells.act";
+    std::ifstream cellLibFp(cellLib);
+    env << cellLibFp.rdbuf() << "\n";
+  }
+  if (corner > 0) {
+    /* the optimizer reports a different number for some corners */
+    env << "corner " << corner_names[corner] << "\n";
+  }
+  const char *bdCells[] = {"latch1", "10ebuf", "pulseGen", "twoToOne",
+                           "horn2"};
+  for (const char *cell: bdCells) {
+    double *metric = getOpMetric(cell);
+    if (metric) {
+      env << formatMetricLine(cell, metric + 4 * corner) << "\n";
+    } else {
+      env << cell << "  none\n";
+    }
+  }
+  String envStr = env.str();
+  uint64_t fingerprint = MetricsDB::hashName(envStr.c_str(), envStr.size());
+  if (debug_verbose) {
+    printf("Cache fingerprint of corner %s: %016llx\n", corner_names[corner],
+           (unsigned long long) fingerprint);
+  }
+  return fingerprint;
+}
+
+uint64_t Metrics::getCacheFingerprint() {
+  if (cacheFingerprints.size() <= 1) {
+    return cacheFingerprints.empty() ? 0 : cacheFingerprints[0];
+  }
+  /* the entries of the other corners found in the cache index have no env
+   * stamp to check, so the key covers their environment too */
+  return MetricsDB::hashName((const char *) cacheFingerprints.data(),
+                             cacheFingerprints.size() * sizeof(uint64_t));
+}
+
+double *Metrics::newMetric(const double *metric) {
+  auto result = new double[metricSize()];
+  for (unsigned i = 0; i < metricSize(); i++) {
+    result[i] = metric[i];
+  }
+  return result;
+}
+
+double *Metrics::findOpMetric(SymbolId normId) {
+  auto opMetricsIt = opMetrics.find(normId);
+  if (opMetricsIt != opMetrics.end()) {
+    return opMetricsIt->second;
+  }
+  if (stdMetricsDBs.empty()) {
+    return nullptr;
+  }
+  const char *normInstance = SymbolTable::getName(normId);
+  double metric[4 * MAX_CORNERS];
+  for (unsigned c = 0; c < num_corners; c++) {
+    const double *stdMetric = stdMetricsDBs[c]->lookup(normInstance);
+    const double *customMetric = customMetricsDBs[c]->lookup(normInstance);
+    if (stdMetric && customMetric
+        && memcmp(stdMetric, customMetric, 4 * sizeof(double))) {
+      printf("We find different metric record for %s\n", normInstance);
       exit(-1);
     }
-    if (emptyLine) continue;
-    if (forCache) {
-      updateCachedMetrics(instance, metric);
-    } else {
-      updateMetrics(instance, metric);
+    const double *dbMetric = stdMetric ? stdMetric : customMetric;
+    if (!dbMetric) {
+      if (c == 0) {
+        return nullptr;
+      }
+      /* characterized at corner 0 only */
+      if (debug_verbose) {
+        printf("No metric for %s at corner %s, use the one of %s\n",
+               normInstance, corner_names[c], corner_names[0]);
+      }
+      addCornerFallback(normInstance, c);
+      dbMetric = metric;
     }
+    memcpy(metric + 4 * c, dbMetric, 4 * sizeof(double));
   }
+  double *result = newMetric(metric);
+  opMetrics.insert({normId, result});
+  return result;
 }
 
-void Metrics::readMetricsFile() {
-  readMetricsFile(std_metrics, false);
-  readMetricsFile(custom_metrics, false);
-  readMetricsFile(cached_metrics, true);
+/* counted once per metric and corner, however many workers look it up */
+void Metrics::addCornerFallback(const char *name, unsigned corner) {
+  const char *key = getCornerKey(name, corner);
+  if (recordStatistics(CORNER_FALLBACK_STAT, key, nullptr, 0, 0)) {
+    return;
+  }
+  cornerFallbacks.insert(SymbolTable::intern(key));
+}
+
+double *Metrics::findCachedMetric(SymbolId normId) {
+  auto cachedMetricsIt = cachedMetrics.find(normId);
+  if (cachedMetricsIt != cachedMetrics.end()) {
+    return cachedMetricsIt->second;
+  }
+  if (!cachedMetricsDB) {
+    return nullptr;
+  }
+  const char *fuKey = SymbolTable::getName(normId);
+  double metric[4 * MAX_CORNERS];
+  for (unsigned c = 0; c < num_corners; c++) {
+    const double *dbMetric = cachedMetricsDB->lookup(getCornerKey(fuKey, c));
+    if (dbMetric) {
+      memcpy(metric + 4 * c, dbMetric, 4 * sizeof(double));
+    } else if (!readCornerEntry(fuKey, c, metric + 4 * c)) {
+      /* not published yet by a concurrent run, or a corner that was not
+       * part of the run that published the others */
+      return nullptr;
+    }
+  }
+  double *result = newMetric(metric);
+  cachedMetrics.insert({normId, result});
+  return result;
 }
 
 Metrics::Metrics(const char *customFUMetricsFP,
@@ -253,64 +493,115 @@ Metrics::Metrics(const char *customFUMetricsFP,
   splitArea = 0;
   mergeLeakPower = 0;
   splitLeakPower = 0;
+  nondetArea = 0;
+  nondetLeakPower = 0;
+  memArea = 0;
+  memLeakPower = 0;
+  slackBuffs = 0;
+  slackArea = 0;
+  slackLeakPower = 0;
+  statRecords = nullptr;
+  metricDeps = nullptr;
+  activityLog = nullptr;
+  corner = 0;
+  cachedMetricsDB = nullptr;
+  metricModelFitted = false;
+  localCache = nullptr;
+  remoteCache = nullptr;
 }
 
-unsigned Metrics::getEquivalentBW(unsigned oriBW) {
-  if (oriBW < 4) {
-    return 1;
-  } else if (oriBW < 12) {
-    return 8;
-  } else if (oriBW < 24) {
-    return 16;
-  } else if (oriBW < 48) {
-    return 32;
-  } else if (oriBW <= 64) {
-    return 64;
-  } else {
-    printf("Invalid M/S bitwidth: %u!\n", oriBW);
-    exit(-1);
+void Metrics::setCornerStatistics(unsigned corner, const char *statisticsFP) {
+  if (cornerStatistics.size() < corner) {
+    cornerStatistics.resize(corner, nullptr);
+  }
+  auto metrics = new Metrics(nullptr, nullptr, statisticsFP);
+  metrics->corner = corner;
+  cornerStatistics[corner - 1] = metrics;
+}
+
+void Metrics::setActivityLog(ActivityLog *log) {
+  activityLog = log;
+  for (auto &metrics: cornerStatistics) {
+    metrics->activityLog = log;
+  }
+}
+
+void Metrics::fitMetricModel() {
+  if (metricModelFitted || stdMetricsDBs.empty()) {
+    return;
+  }
+  metricModelFitted = true;
+  for (unsigned c = 0; c < num_corners; c++) {
+    unsigned numEntries = stdMetricsDBs[c]->size();
+    for (unsigned i = 0; i < numEntries; i++) {
+      String instance;
+      const double *metric;
+      stdMetricsDBs[c]->getEntry(i, instance, metric);
+      metricModels[c].addSample(instance.c_str(), metric);
+    }
   }
 }
 
+double *Metrics::getModelMetric(const char *family,
+                                unsigned fan,
+                                unsigned guardBW,
+                                unsigned bw) {
+  fitMetricModel();
+  if (metricModels.empty()) {
+    return nullptr;
+  }
+  double metric[4 * MAX_CORNERS];
+  for (unsigned c = 0; c < num_corners; c++) {
+    if (!metricModels[c].predict(family, fan, guardBW, bw, metric + 4 * c)) {
+      if (c == 0) {
+        return nullptr;
+      }
+      char *name = newScratchChars(strlen(family) + 48);
+      sprintf(name, "%s<%u,%u,%u>", family, fan, guardBW, bw);
+      addCornerFallback(name, c);
+      memcpy(metric + 4 * c, metric, 4 * sizeof(double));
+    }
+  }
+  if (debug_verbose) {
+    printf("Model %s<%u,%u,%u>: %f %f %f %f\n", family, fan, guardBW, bw,
+           metric[0], metric[1], metric[2], metric[3]);
+  }
+  return newMetric(metric);
+}
+
 double *Metrics::getOrGenCopyMetric(unsigned bitwidth, unsigned numOut) {
   if (!_have_metrics) {
     return NULL;
   }
   
   updateCopyStatistics(bitwidth, numOut);
-  char *instance = new char[1500];
+  char *instance = newScratchChars(1500);
   sprintf(instance, "copy<%u,%u>", bitwidth, numOut);
   double *metric = getOpMetric(instance);
   if (!metric) {
-    char *equivInstance = new char[1500];
-    int equivN = int(ceil(log2(numOut))) - 1;
-    if (equivN < 1) {
-      equivN = 1;
-    }
-    unsigned equivBW = getEquivalentBW(bitwidth);
-    if (debug_verbose) {
-      printf(
-          "We are handling copy_%u_%u, and we are using mapping it to %d "
-          "copy_%u_2_\n", bitwidth, numOut, equivN, equivBW);
-    }
-    sprintf(equivInstance, "copy<%u,2>", equivBW);
-    double *equivMetric = getOpMetric(equivInstance);
-    if (!equivMetric) {
-      printf("Missing metrics for copy %s\n", equivInstance);
-      exit(-1);
-    }
-    if (equivN == 1) {
-      metric = equivMetric;
-    } else {
-      metric = new double[4];
-      metric[0] = equivN * equivMetric[0];
-      metric[1] = equivN * equivMetric[1];
-      metric[2] = equivN * equivMetric[2];
-      metric[3] = equivN * equivMetric[3];
+    metric = getModelMetric("copy", numOut, 0, bitwidth);
+    if (!metric) {
+      int equivN = int(ceil(log2(numOut))) - 1;
+      if (equivN < 1) {
+        equivN = 1;
+      }
+      if (debug_verbose) {
+        printf(
+            "We are handling copy_%u_%u, and we are using mapping it to %d "
+            "copy_%u_2_\n", bitwidth, numOut, equivN, bitwidth);
+      }
+      double *equivMetric = getModelMetric("copy", 2, 0, bitwidth);
+      if (!equivMetric) {
+        printf("Missing metrics for copy copy<%u,2>\n", bitwidth);
+        exit(-1);
+      }
+      metric = new double[metricSize()];
+      for (unsigned i = 0; i < metricSize(); i++) {
+        metric[i] = equivN * equivMetric[i];
+      }
     }
     updateMetrics(instance, metric);
     writeLocalMetricFile(instance, metric);
-    writeCachedMetricFile(instance, metric);
   }
   if (metric) {
     updateStatistics(instance, metric);
@@ -322,7 +613,7 @@ double *Metrics::getSinkMetric() {
   if (!_have_metrics) {
     return NULL;
   }
-  char *unitInstance = new char[1500];
+  char *unitInstance = newScratchChars(1500);
   sprintf(unitInstance, "sink_1_");
   double *metric = getOpMetric(unitInstance);
   if (!metric) {
@@ -336,7 +627,7 @@ double *Metrics::getSourceMetric() {
   if (!_have_metrics) {
     return NULL;
   }
-  char *unitInstance = new char[8];
+  char *unitInstance = newScratchChars(8);
   sprintf(unitInstance, "source1");
   double *metric = getOpMetric(unitInstance);
   if (!metric) {
@@ -351,7 +642,7 @@ double *Metrics::getOrGenInitMetric(unsigned int bitwidth) {
     return NULL;
   }
 
-  char *instance = new char[100];
+  char *instance = newScratchChars(100);
   sprintf(instance, "init%u", bitwidth);
   double *metric = getOpMetric(instance);
   if (metric) {
@@ -360,21 +651,28 @@ double *Metrics::getOrGenInitMetric(unsigned int bitwidth) {
   return metric;
 }
 
-double *Metrics::getBuffMetric(unsigned nBuff, unsigned bw) {
+double *Metrics::genBuffMetric(unsigned nBuff, unsigned bw) {
   if (!_have_metrics) {
     return NULL;
   }
-  char *instance = new char[100];
-  sprintf(instance, "latch1");
-  double *uniMetric = getOpMetric(instance);
+  double *uniMetric = getOpMetric("latch1");
   double *metric = nullptr;
   if (uniMetric) {
-    metric = new double[4];
-    metric[0] = nBuff * uniMetric[0]; // leakage
-    metric[1] = nBuff * uniMetric[1]; // energy
-    metric[2] =  uniMetric[2];        // delay
-    metric[3] = nBuff * uniMetric[3]; // area
-    updateStatistics(instance, metric);
+    metric = new double[metricSize()];
+    for (unsigned c = 0; c < num_corners; c++) {
+      metric[4 * c] = nBuff * getLP(uniMetric, c);
+      metric[4 * c + 1] = nBuff * getEnergy(uniMetric, c);
+      metric[4 * c + 2] = getDelay(uniMetric, c);
+      metric[4 * c + 3] = nBuff * getArea(uniMetric, c);
+    }
+  }
+  return metric;
+}
+
+double *Metrics::getBuffMetric(unsigned nBuff, unsigned bw) {
+  double *metric = genBuffMetric(nBuff, bw);
+  if (metric) {
+    updateStatistics("latch1", metric);
   }
   return metric;
 }
@@ -382,6 +680,7 @@ double *Metrics::getBuffMetric(unsigned nBuff, unsigned bw) {
 void Metrics::callLogicOptimizer(
 #if LOGIC_OPTIMIZER
     const char *instance,
+    const char *fuKey,
     StringMap<unsigned> &inBW,
     StringMap<unsigned> &hiddenBW,
     Map<const char *, Expr *> &exprMap,
@@ -393,16 +692,45 @@ void Metrics::callLogicOptimizer(
 ) {
   if (!_have_metrics) {
 #if LOGIC_OPTIMIZER    
-    metric = new double[4];
-    metric[0] = 0;
-    metric[1] = 0;
-    metric[2] = 0;
-    metric[3] = 0;
+    metric = new double[metricSize()];
+    for (unsigned i = 0; i < metricSize(); i++) {
+      metric[i] = 0;
+    }
 #endif    
     return;
   }
     
 #if LOGIC_OPTIMIZER
+  /* another run may be optimizing the same FU; wait for it, and use its
+   * result instead of running the optimizer again */
+  int lockFd = localCache->lock(fuKey);
+  metric = getCachedMetric(instance, fuKey);
+  if (!metric) {
+    ExprBlockInfo *info = runExternalOpt(instance,
+                                         fuKey,
+                                         inBW,
+                                         hiddenBW,
+                                         exprMap,
+                                         hiddenExprs,
+                                         outRecord,
+                                         outBWList);
+    metric = genFUMetric(instance, fuKey, inBW, info);
+    useFUMetric(instance, fuKey, metric);
+  }
+  unlockFile(lockFd);
+#endif
+}
+
+#if LOGIC_OPTIMIZER
+ExprBlockInfo *Metrics::runExternalOpt(const char *instance,
+                                       const char *fuKey,
+                                       StringMap<unsigned> &inBW,
+                                       StringMap<unsigned> &hiddenBW,
+                                       Map<const char *, Expr *> &exprMap,
+                                       Map<Expr *, Expr *> &hiddenExprs,
+                                       Map<unsigned int,
+                                           unsigned int> &outRecord,
+                                       UIntVec &outBWList) {
   if (debug_verbose) {
     printf("Will run logic optimizer for %s\n", instance);
   }
@@ -410,19 +738,10 @@ void Metrics::callLogicOptimizer(
   list_t *in_expr_list = list_new();
   iHashtable *in_expr_map = ihash_new(0);
   iHashtable *in_width_map = ihash_new(0);
-  unsigned totalInBW = 0;
-  unsigned lowBWInPorts = 0;
-  unsigned highBWInPorts = 0;
   for (auto &inBWIt: inBW) {
     String inName = inBWIt.first;
     unsigned bw = inBWIt.second;
-    totalInBW += bw;
-    if (bw >= 32) {
-      highBWInPorts++;
-    } else {
-      lowBWInPorts++;
-    }
-    char *inChar = new char[strlen(inName.c_str()) + 1];
+    char *inChar = newScratchChars(strlen(inName.c_str()) + 1);
     sprintf(inChar, "%s", inName.c_str());
     if (debug_verbose) {
       printf("inChar: %s\n", inChar);
@@ -442,7 +761,7 @@ void Metrics::callLogicOptimizer(
   for (auto &hiddenBWIt: hiddenBW) {
     String hiddenName = hiddenBWIt.first;
     unsigned bw = hiddenBWIt.second;
-    char *hiddenChar = new char[1 + strlen(hiddenName.c_str())];
+    char *hiddenChar = newScratchChars(1 + strlen(hiddenName.c_str()));
     sprintf(hiddenChar, "%s", hiddenName.c_str());
     if (debug_verbose) {
       printf("hiddenChar: %s\n", hiddenChar);
@@ -469,14 +788,14 @@ void Metrics::callLogicOptimizer(
   unsigned numOuts = outRecord.size();
   for (unsigned ii = 0; ii < numOuts; ii++) {
     unsigned resID = outRecord.find(ii)->second;
-    char *resChar = new char[SHORT_STRING_LEN];
+    char *resChar = newScratchChars(SHORT_STRING_LEN);
     sprintf(resChar, "res%u", resID);
     if (debug_verbose) {
       printf("resChar: %s\n", resChar);
     }
     Expr *resExpr = getExprFromName(resChar, exprMap, true, -1);
     list_append(out_expr_list, resExpr);
-    char *outChar = new char[SHORT_STRING_LEN];
+    char *outChar = newScratchChars(SHORT_STRING_LEN);
     sprintf(outChar, "out%d", ii);
     list_append(out_expr_name_list, outChar);
     if (std::find(processedResIDs.begin(), processedResIDs.end(), resID)
@@ -526,20 +845,21 @@ void Metrics::callLogicOptimizer(
     }
     printf("\n");
   }
-  const char *normInstance = getNormInstanceName(instance);
+  SymbolId normId = getNormInstanceId(instance);
+  const char *normInstance = SymbolTable::getName(normId);
   if (debug_verbose) {
     printf("Run logic optimizer for %s\n", normInstance);
   }
-  char *rtlModuleName = new char[strlen(normInstance) + 1];
+  char *rtlModuleName = newScratchChars(strlen(normInstance) + 1);
   sprintf(rtlModuleName, "%s", normInstance);
   char *optimized_netlist_file =
-      new char[strlen(rtlModuleName) + strlen(custom_fu_dir) + 16];
+      newScratchChars(strlen(rtlModuleName) + strlen(custom_fu_dir) + 16);
   sprintf(optimized_netlist_file, "%s/%s.act", custom_fu_dir, rtlModuleName);
   expr_mapping_software software = yosys;
   if (COMMERCIAL_LOGIC_OPTIMIZER) software = genus;
   bool tie_cells = false;
   char *act_home = getenv("ACT_HOME");
-  char* stdcell_path = new char[strlen(act_home) + 128];
+  char* stdcell_path = newScratchChars(strlen(act_home) + 128);
   sprintf(stdcell_path, "%s/act/std/cells.act", act_home);
   config_set_string("expropt.act_cell_lib_bd", stdcell_path);
   config_set_string("expropt.act_cell_lib_bd_namespace", "std::cells");
@@ -554,11 +874,6 @@ void Metrics::callLogicOptimizer(
                                                     out_width_map,
                                                     hidden_expr_list,
                                                     hidden_expr_name_list);
-  /* copy the optimized netlist file to the cache */
-  char *errMsg = new char[128];
-  sprintf(errMsg,
-          "Fail to copy the optimized netlist file to the cache directory!\n");
-  copyFileToTargetDir(optimized_netlist_file, cache_dir, errMsg);
   if (debug_verbose) {
     printf("Generated block %s: Area: %e m2, Dyn Power: %e W, "
            "Leak Power: %e W, delay: %e s\n",
@@ -568,23 +883,25 @@ void Metrics::callLogicOptimizer(
            info->power_typ_static,
            info->delay_typ);
   }
+  return info;
+}
 
-  double leakpower, energy, delay, area;
-
-  if (info->delay_typ == -1) {
-    /* wires */
-    leakpower = 0;
-    energy = 0;
-    delay = 0;
-    area = 0;
-  }
-  else {
-    leakpower = info->power_typ_static * 1e9;  // Leakage power (nW)
-    energy = info->power_typ_dynamic * info->delay_typ * 1e15;  // 1e-15J
-    delay = info->delay_typ * 1e12; // Delay (ps)
-    area = info->area * 1e12;  // AREA (um^2)
+double *Metrics::genFUMetric(const char *instance,
+                             const char *fuKey,
+                             StringMap<unsigned> &inBW,
+                             ExprBlockInfo *info) {
+  unsigned totalInBW = 0;
+  unsigned lowBWInPorts = 0;
+  unsigned highBWInPorts = 0;
+  for (auto &inBWIt: inBW) {
+    unsigned bw = inBWIt.second;
+    totalInBW += bw;
+    if (bw >= 32) {
+      highBWInPorts++;
+    } else {
+      lowBWInPorts++;
+    }
   }
-  
   /* adjust perf number by adding latch, etc. */
   double *latchMetric = getOpMetric("latch1");
   double *ebufMetric = getOpMetric("10ebuf");
@@ -596,40 +913,265 @@ void Metrics::callLogicOptimizer(
     printf("No metric for the bundled-data control circuit!\n");
     exit(-1);
   }
-  double latchLP = getLP(latchMetric);
-  double latchEnergy = getEnergy(latchMetric);
-  double latchDelay = getDelay(latchMetric);
-  double latchArea = getArea(latchMetric);
-  double ebufLP = getLP(ebufMetric);
-  double ebufEnergy = getEnergy(ebufMetric);
-  double ebufDelay = getDelay(ebufMetric);
-  double ebufArea = getArea(ebufMetric);
-  double pulseGenLP = getLP(pulseGenMetric);
-  double pulseGenEnergy = getEnergy(pulseGenMetric);
-  double pulseGenArea = getArea(pulseGenMetric);
-  double twoToOneDelay = getDelay(twoToOneMetric);
-  double hornLP = getLP(hornMetric);
-  double hornEnergy = getEnergy(hornMetric);
-  double hornArea = getArea(hornMetric);
-  area = area + totalInBW * latchArea + lowBWInPorts * pulseGenArea
-      + highBWInPorts * (pulseGenArea + hornArea)
-      + delay / ebufDelay * ebufArea;
-  leakpower = leakpower + totalInBW * latchLP + lowBWInPorts * pulseGenLP
-      + highBWInPorts * (pulseGenLP + hornLP) + delay / ebufDelay * ebufLP;
-  energy = energy + totalInBW * latchEnergy + lowBWInPorts * pulseGenEnergy
-      + highBWInPorts * (pulseGenEnergy + hornEnergy)
-      + delay / ebufDelay * ebufEnergy;
-  delay = delay + twoToOneDelay + latchDelay;
-  /* get the final metric */
-  metric = new double[4];
-  metric[0] = leakpower;
-  metric[1] = energy;
-  metric[2] = delay;
-  metric[3] = area;
+  auto metric = new double[metricSize()];
+  for (unsigned c = 0; c < num_corners; c++) {
+    double blockDelay = info->delay_typ;
+    double blockDynamicPower = info->power_typ_dynamic;
+    double blockStaticPower = info->power_typ_static;
+    if (strcmp(corner_names[c], "fast") == 0) {
+      blockDelay = info->delay_min;
+      blockDynamicPower = info->power_max_dynamic;
+      blockStaticPower = info->power_max_static;
+    } else if (strcmp(corner_names[c], "slow") == 0) {
+      blockDelay = info->delay_max;
+    }
+    double leakpower, energy, delay, area;
+    if (info->delay_typ == -1) {
+      /* wires */
+      leakpower = 0;
+      energy = 0;
+      delay = 0;
+      area = 0;
+    }
+    else {
+      leakpower = blockStaticPower * 1e9;  // Leakage power (nW)
+      energy = blockDynamicPower * blockDelay * 1e15;  // 1e-15J
+      delay = blockDelay * 1e12; // Delay (ps)
+      area = info->area * 1e12;  // AREA (um^2)
+    }
+    double latchLP = getLP(latchMetric, c);
+    double latchEnergy = getEnergy(latchMetric, c);
+    double latchDelay = getDelay(latchMetric, c);
+    double latchArea = getArea(latchMetric, c);
+    double ebufLP = getLP(ebufMetric, c);
+    double ebufEnergy = getEnergy(ebufMetric, c);
+    double ebufDelay = getDelay(ebufMetric, c);
+    double ebufArea = getArea(ebufMetric, c);
+    double pulseGenLP = getLP(pulseGenMetric, c);
+    double pulseGenEnergy = getEnergy(pulseGenMetric, c);
+    double pulseGenArea = getArea(pulseGenMetric, c);
+    double twoToOneDelay = getDelay(twoToOneMetric, c);
+    double hornLP = getLP(hornMetric, c);
+    double hornEnergy = getEnergy(hornMetric, c);
+    double hornArea = getArea(hornMetric, c);
+    area = area + totalInBW * latchArea + lowBWInPorts * pulseGenArea
+        + highBWInPorts * (pulseGenArea + hornArea)
+        + delay / ebufDelay * ebufArea;
+    leakpower = leakpower + totalInBW * latchLP + lowBWInPorts * pulseGenLP
+        + highBWInPorts * (pulseGenLP + hornLP) + delay / ebufDelay * ebufLP;
+    energy = energy + totalInBW * latchEnergy + lowBWInPorts * pulseGenEnergy
+        + highBWInPorts * (pulseGenEnergy + hornEnergy)
+        + delay / ebufDelay * ebufEnergy;
+    delay = delay + twoToOneDelay + latchDelay;
+    /* get the final metric */
+    metric[4 * c] = leakpower;
+    metric[4 * c + 1] = energy;
+    metric[4 * c + 2] = delay;
+    metric[4 * c + 3] = area;
+  }
+  publishCacheEntry(instance, fuKey, metric);
+  return metric;
+}
+
+void Metrics::useFUMetric(const char *instance,
+                          const char *fuKey,
+                          double *metric) {
   updateMetrics(instance, metric);
+  updateCachedMetrics(fuKey, metric);
   writeLocalMetricFile(instance, metric);
-  writeCachedMetricFile(instance, metric);
+}
+
+void Metrics::queueFUMetric(StringMap<unsigned> &inBW,
+                            StringMap<unsigned> &hiddenBW,
+                            Map<const char *, Expr *> &exprMap,
+                            Map<Expr *, Expr *> &hiddenExprs,
+                            Map<unsigned int, unsigned int> &outRecord,
+                            UIntVec &outBWList,
+                            const char *instance,
+                            const char *fuKey) {
+  if (!_have_metrics) {
+    return;
+  }
+  SymbolId normId = getNormInstanceId(instance);
+  const char *normInstance = SymbolTable::getName(normId);
+  /* structurally identical FUs share one job */
+  SymbolId keyId = SymbolTable::intern(fuKey);
+  if (findOpMetric(normId)
+      || findCachedMetric(keyId)
+      || (fuJobIdx.find(keyId) != fuJobIdx.end())) {
+    return;
+  }
+  /* estimate how long the logic optimizer runs for this FU: every hidden
+   * expression costs its bitwidth, and mult/div/mod cost its square */
+  double cost = 0;
+  for (auto &hiddenBWIt: hiddenBW) {
+    double bw = hiddenBWIt.second;
+    Expr *hiddenRHS =
+        getExprFromName(hiddenBWIt.first.c_str(), exprMap, true, -1);
+    auto hiddenExprsIt = hiddenExprs.find(hiddenRHS);
+    if (hiddenExprsIt == hiddenExprs.end()) {
+      printf("No hidden expression for %s in %s!\n",
+             hiddenBWIt.first.c_str(), normInstance);
+      exit(-1);
+    }
+    int type = hiddenExprsIt->second->type;
+    if ((type == E_MULT) || (type == E_DIV) || (type == E_MOD)) {
+      cost += bw * bw;
+    } else {
+      cost += bw;
+    }
+  }
+  if (debug_verbose) {
+    printf("Queue logic optimizer job for %s (cost %.0f)\n", normInstance, cost);
+  }
+  FUJob job;
+  job.instance = instance;
+  job.fuKey = fuKey;
+  job.inBW = inBW;
+  job.hiddenBW = hiddenBW;
+  job.exprMap = exprMap;
+  job.hiddenExprs = hiddenExprs;
+  job.outRecord = outRecord;
+  job.outBWList = outBWList;
+  job.cost = cost;
+  fuJobIdx.insert({keyId, fuJobs.size()});
+  fuJobs.push_back(job);
+}
 #endif
+
+void Metrics::runFUJobs(unsigned numJobs) {
+#if LOGIC_OPTIMIZER
+  unsigned totalJobs = fuJobs.size();
+  if (totalJobs == 0) {
+    freeJobArenas();
+    return;
+  }
+  if (numJobs < 1) {
+    numJobs = 1;
+  }
+  if (!quiet_mode) {
+    printf("Run logic optimizer for %u FUs with %u jobs\n",
+           totalJobs, numJobs);
+  }
+  /* start with the most expensive expressions */
+  Vector<unsigned> order(totalJobs);
+  for (unsigned i = 0; i < totalJobs; i++) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](unsigned l, unsigned r) {
+    return fuJobs[l].cost > fuJobs[r].cost;
+  });
+  /* nothing pending in the parent may be written again by a worker, and no
+   * writer thread may hold a lock while forking */
+  flushMetricFiles();
+  OutputStream::suspendAll();
+  /* each job runs the optimizer in a forked worker, which publishes the
+   * cache entry and sends back its metric through a pipe */
+  Vector<double *> results(totalJobs, nullptr);
+  /* pid of the worker, (job id, read end of its pipe) */
+  Map<pid_t, Pair<unsigned, int>> running;
+  unsigned next = 0;
+  while ((next < totalJobs) || !running.empty()) {
+    while ((next < totalJobs) && (running.size() < numJobs)) {
+      unsigned jobID = order[next];
+      next++;
+      int fds[2];
+      if (pipe(fds) != 0) {
+        printf("Fail to create pipe for the logic optimizer job!\n");
+        exit(-1);
+      }
+      fflush(stdout);
+      pid_t pid = fork();
+      if (pid < 0) {
+        printf("Fail to fork the logic optimizer job!\n");
+        exit(-1);
+      }
+      if (pid == 0) {
+        close(fds[0]);
+        FUJob &job = fuJobs[jobID];
+        /* the entry stays locked until it is published, so a concurrent run
+         * waits for this one instead of optimizing the same FU */
+        int lockFd = localCache->lock(job.fuKey);
+        double fuResult[4 * MAX_CORNERS];
+        double *metric = findCachedMetric(SymbolTable::intern(job.fuKey));
+        /* published by a concurrent run while this one was waiting; the
+         * lock keeps it from being evicted while its netlist is copied */
+        if (metric
+            && !copyCachedNetlist(job.fuKey,
+                                  SymbolTable::getName(
+                                      getNormInstanceId(job.instance)))) {
+          metric = nullptr;
+        }
+        if (!metric) {
+          ExprBlockInfo *info = runExternalOpt(job.instance,
+                                               job.fuKey,
+                                               job.inBW,
+                                               job.hiddenBW,
+                                               job.exprMap,
+                                               job.hiddenExprs,
+                                               job.outRecord,
+                                               job.outBWList);
+          metric = genFUMetric(job.instance, job.fuKey, job.inBW, info);
+        }
+        unlockFile(lockFd);
+        memcpy(fuResult, metric, metricSize() * sizeof(double));
+        flushMetricFiles();
+        size_t resultLen = metricSize() * sizeof(double);
+        ssize_t len = write(fds[1], fuResult, resultLen);
+        fflush(stdout);
+        _exit((len == (ssize_t) resultLen) ? 0 : 1);
+      }
+      close(fds[1]);
+      running.insert({pid, {jobID, fds[0]}});
+    }
+    int status;
+    pid_t pid = waitpid(-1, &status, 0);
+    auto runningIt = running.find(pid);
+    if (runningIt == running.end()) {
+      continue;
+    }
+    unsigned jobID = runningIt->second.first;
+    int fd = runningIt->second.second;
+    running.erase(runningIt);
+    auto fuResult = new double[metricSize()];
+    size_t resultLen = metricSize() * sizeof(double);
+    ssize_t len = read(fd, fuResult, resultLen);
+    close(fd);
+    if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)
+        || (len != (ssize_t) resultLen)) {
+      printf("Logic optimizer job for %s failed!\n", fuJobs[jobID].instance);
+      exit(-1);
+    }
+    results[jobID] = fuResult;
+  }
+  OutputStream::resumeAll();
+  /* fill in the metrics in the order the FUs are first used. The mapping
+   * pass then finds them, and emits the same CHP as a serial run; the
+   * local metric file gets their lines ahead of the other new metrics,
+   * while a serial run interleaves them */
+  for (unsigned i = 0; i < totalJobs; i++) {
+    double *fuResult = results[i];
+    useFUMetric(fuJobs[i].instance, fuJobs[i].fuKey, newMetric(fuResult));
+    delete[] fuResult;
+  }
+  flushMetricFiles();
+  fuJobs.clear();
+  fuJobIdx.clear();
+#endif
+  freeJobArenas();
+}
+
+Arena *Metrics::newJobArena() {
+  auto arena = new Arena();
+  jobArenas.push_back(arena);
+  return arena;
+}
+
+void Metrics::freeJobArenas() {
+  for (auto &arena: jobArenas) {
+    delete arena;
+  }
+  jobArenas.clear();
 }
 
 double *Metrics::getOrGenFUMetric(
@@ -641,17 +1183,19 @@ double *Metrics::getOrGenFUMetric(
     Map<unsigned int, unsigned int> &outRecord,
     UIntVec &outBWList,
 #endif
-    const char *instance) {
+    const char *instance,
+    const char *fuKey) {
   if (!_have_metrics) {
     return NULL;
   }
   double *metric = getOpMetric(instance);
   if (!metric) {
-    metric = getCachedMetric(instance);
+    metric = getCachedMetric(instance, fuKey);
   }
   if (!metric) {
 #if LOGIC_OPTIMIZER
     callLogicOptimizer(instance,
+                       fuKey,
                        inBW,
                        hiddenBW,
                        exprMap,
@@ -667,206 +1211,507 @@ double *Metrics::getOrGenFUMetric(
   return metric;
 }
 
-double *Metrics::getOrGenMergeMetric(unsigned guardBW,
-                                     unsigned inBW,
-                                     unsigned numIn) {
+double *Metrics::genMergeMetric(unsigned guardBW,
+                                unsigned inBW,
+                                unsigned numIn,
+                                bool pipelined) {
   if (!_have_metrics) {
     return NULL;
   }
   
-  char *procName = new char[MAX_INSTANCE_LEN];
-  const char *instance =
-      NameGenerator::genMergeInstName(guardBW, inBW, numIn, procName);
+  char *procName = newScratchChars(SHORT_STRING_LEN);
+  const char *instance = NameGenerator::genMergeInstName(guardBW,
+                                                         inBW,
+                                                         numIn,
+                                                         pipelined,
+                                                         procName);
   double *metric = getOpMetric(instance);
-  unsigned equivBW = getEquivalentBW(inBW);
-  const char *equivInstance =
-      NameGenerator::genMergeInstName(guardBW, equivBW, numIn, procName);
   if (!metric) {
-    if (equivBW != inBW) {
-      metric = getOpMetric(equivInstance);
-    }
-    if (!metric) {
+    metric = getModelMetric(procName, numIn, guardBW, inBW);
+    if (metric) {
+      updateMetrics(instance, metric);
+      writeLocalMetricFile(instance, metric);
+    } else {
       double *mergeCtrlMetric = getOpMetric("mergeControl");
       double *muxMetric = getOpMetric("mux1");
       double *decodeMetric = getOpMetric("decodeTwoToFour");
-      double mergeCtrlLP = getLP(mergeCtrlMetric);
-      double mergeCtrlEnergy = getEnergy(mergeCtrlMetric);
-      double mergeCtrlDelay = getDelay(mergeCtrlMetric);
-      double mergeCtrlArea = getArea(mergeCtrlMetric);
-      double muxLP = getLP(muxMetric);
-      double muxEnergy = getEnergy(muxMetric);
-      double muxArea = getArea(muxMetric);
-      double decodeLP = getLP(decodeMetric);
-      double decodeEnergy = getEnergy(decodeMetric);
-      double decodeDelay = getDelay(decodeMetric);
-      double decodeArea = getArea(decodeMetric);
-      double lp;
-      double energy;
-      double delay;
-      double area;
-      if (PIPELINE) {
-        double *latchMetric = getOpMetric("latch1");
-        double *hornMetric = getOpMetric("horn2");
-        double *pulseGenMetric = getOpMetric("pulseGen");
-        if (!latchMetric || !hornMetric || !pulseGenMetric || !decodeMetric
-            || !mergeCtrlMetric || !muxMetric) {
-          printf("No enough info to calculate metric for (%s, %s)!\n",
-                 equivInstance, instance);
-          exit(-1);
-        }
-        double latchLP = getLP(latchMetric);
-        double latchEnergy = getEnergy(latchMetric);
-        double latchArea = getArea(latchMetric);
-        double hornLP = getLP(hornMetric);
-        double hornEnergy = getEnergy(hornMetric);
-        double hornDelay = getDelay(hornMetric);
-        double hornArea = getArea(hornMetric);
-        double pulseGenLP = getLP(pulseGenMetric);
-        double pulseGenEnergy = getEnergy(pulseGenMetric);
-        double pulseGenDelay = getDelay(pulseGenMetric);
-        double pulseGenArea = getArea(pulseGenMetric);
-        double pulseLP;
-        double pulseEnergy;
-        double pulseDelay;
-        double pulseArea;
-        if (inBW < 32) {
-          pulseLP = pulseGenLP;
-          pulseEnergy = pulseGenEnergy;
-          pulseDelay = pulseGenDelay;
-          pulseArea = pulseGenArea;
+      metric = new double[metricSize()];
+      for (unsigned c = 0; c < num_corners; c++) {
+        double mergeCtrlLP = getLP(mergeCtrlMetric, c);
+        double mergeCtrlEnergy = getEnergy(mergeCtrlMetric, c);
+        double mergeCtrlDelay = getDelay(mergeCtrlMetric, c);
+        double mergeCtrlArea = getArea(mergeCtrlMetric, c);
+        double muxLP = getLP(muxMetric, c);
+        double muxEnergy = getEnergy(muxMetric, c);
+        double muxArea = getArea(muxMetric, c);
+        double decodeLP = getLP(decodeMetric, c);
+        double decodeEnergy = getEnergy(decodeMetric, c);
+        double decodeDelay = getDelay(decodeMetric, c);
+        double decodeArea = getArea(decodeMetric, c);
+        double lp;
+        double energy;
+        double delay;
+        double area;
+        if (pipelined) {
+          double *latchMetric = getOpMetric("latch1");
+          double *hornMetric = getOpMetric("horn2");
+          double *pulseGenMetric = getOpMetric("pulseGen");
+          if (!latchMetric || !hornMetric || !pulseGenMetric || !decodeMetric
+              || !mergeCtrlMetric || !muxMetric) {
+            printf("No enough info to calculate metric for %s!\n", instance);
+            exit(-1);
+          }
+          double latchLP = getLP(latchMetric, c);
+          double latchEnergy = getEnergy(latchMetric, c);
+          double latchArea = getArea(latchMetric, c);
+          double hornLP = getLP(hornMetric, c);
+          double hornEnergy = getEnergy(hornMetric, c);
+          double hornDelay = getDelay(hornMetric, c);
+          double hornArea = getArea(hornMetric, c);
+          double pulseGenLP = getLP(pulseGenMetric, c);
+          double pulseGenEnergy = getEnergy(pulseGenMetric, c);
+          double pulseGenDelay = getDelay(pulseGenMetric, c);
+          double pulseGenArea = getArea(pulseGenMetric, c);
+          double pulseLP;
+          double pulseEnergy;
+          double pulseDelay;
+          double pulseArea;
+          if (inBW < 32) {
+            pulseLP = pulseGenLP;
+            pulseEnergy = pulseGenEnergy;
+            pulseDelay = pulseGenDelay;
+            pulseArea = pulseGenArea;
+          } else {
+            pulseLP = pulseGenLP + hornLP;
+            pulseEnergy = pulseGenEnergy + hornEnergy;
+            pulseDelay = pulseGenDelay + hornDelay;
+            pulseArea = pulseGenArea + hornArea;
+          }
+          if (debug_verbose) {
+            printf("For %s, mergeCtrlArea: %f, latchArea: %f, decodeArea: %f, "
+                   "pulseArea: %f, muxArea: %f\n",
+                   instance,
+                   mergeCtrlArea,
+                   latchArea,
+                   decodeArea,
+                   pulseArea,
+                   muxArea);
+          }
+          lp = mergeCtrlLP + latchLP * guardBW + decodeLP
+              + numIn * (pulseLP + inBW * muxLP / 2) + inBW * latchLP;
+          energy = mergeCtrlEnergy + latchEnergy * guardBW + decodeEnergy
+              + pulseEnergy + inBW * muxEnergy / 2 + inBW * latchEnergy;
+          delay = mergeCtrlDelay + decodeDelay + pulseDelay;
+          area = mergeCtrlArea + latchArea * guardBW + decodeArea
+              + numIn * (pulseArea + inBW * muxArea / 2) + inBW * latchArea;
         } else {
-          pulseLP = pulseGenLP + hornLP;
-          pulseEnergy = pulseGenEnergy + hornEnergy;
-          pulseDelay = pulseGenDelay + hornDelay;
-          pulseArea = pulseGenArea + hornArea;
-        }
-        if (debug_verbose) {
-          printf("For %s, mergeCtrlArea: %f, latchArea: %f, decodeArea: %f, "
-                 "pulseArea: %f, muxArea: %f\n",
-                 instance,
-                 mergeCtrlArea,
-                 latchArea,
-                 decodeArea,
-                 pulseArea,
-                 muxArea);
-        }
-        lp = mergeCtrlLP + latchLP * guardBW + decodeLP
-            + numIn * (pulseLP + inBW * muxLP / 2) + inBW * latchLP;
-        energy = mergeCtrlEnergy + latchEnergy * guardBW + decodeEnergy
-            + pulseEnergy + inBW * muxEnergy / 2 + inBW * latchEnergy;
-        delay = mergeCtrlDelay + decodeDelay + pulseDelay;
-        area = mergeCtrlArea + latchArea * guardBW + decodeArea
-            + numIn * (pulseArea + inBW * muxArea / 2) + inBW * latchArea;
-      } else {
-        if (!decodeMetric || !mergeCtrlMetric || !muxMetric) {
-          printf("No enough info to calculate metric for (%s, %s)!\n",
-                 equivInstance, instance);
-          exit(-1);
-        }
-        if (debug_verbose) {
-          printf("For %s, mergeCtrlArea: %f, decodeArea: %f, muxArea: %f\n",
-                 instance,
-                 mergeCtrlArea,
-                 decodeArea,
-                 muxArea);
+          if (!decodeMetric || !mergeCtrlMetric || !muxMetric) {
+            printf("No enough info to calculate metric for %s!\n", instance);
+            exit(-1);
+          }
+          if (debug_verbose) {
+            printf("For %s, mergeCtrlArea: %f, decodeArea: %f, muxArea: %f\n",
+                   instance,
+                   mergeCtrlArea,
+                   decodeArea,
+                   muxArea);
+          }
+          lp = mergeCtrlLP + decodeLP + numIn * (inBW * muxLP / 2);
+          energy = mergeCtrlEnergy + decodeEnergy + inBW * muxEnergy / 2;
+          delay = mergeCtrlDelay + decodeDelay;
+          area = mergeCtrlArea + decodeArea + numIn * (inBW * muxArea / 2);
         }
-        lp = mergeCtrlLP + decodeLP + numIn * (inBW * muxLP / 2);
-        energy = mergeCtrlEnergy + decodeEnergy + inBW * muxEnergy / 2;
-        delay = mergeCtrlDelay + decodeDelay;
-        area = mergeCtrlArea + decodeArea + numIn * (inBW * muxArea / 2);
+        metric[4 * c] = lp;
+        metric[4 * c + 1] = energy;
+        metric[4 * c + 2] = delay;
+        metric[4 * c + 3] = area;
       }
-      metric = new double[4];
-      metric[0] = lp;
-      metric[1] = energy;
-      metric[2] = delay;
-      metric[3] = area;
       updateMetrics(instance, metric);
       writeLocalMetricFile(instance, metric);
-      writeCachedMetricFile(instance, metric);
     }
   }
-  updateStatistics(instance, metric);
-  updateMergeMetrics(metric);
   return metric;
 }
 
-double *Metrics::getOrGenSplitMetric(unsigned guardBW,
+double *Metrics::getOrGenMergeMetric(unsigned guardBW,
                                      unsigned inBW,
-                                     unsigned numOut) {
+                                     unsigned numIn,
+                                     bool pipelined) {
+  double *metric = genMergeMetric(guardBW, inBW, numIn, pipelined);
+  if (!metric) {
+    return NULL;
+  }
+  char *procName = newScratchChars(SHORT_STRING_LEN);
+  updateStatistics(NameGenerator::genMergeInstName(guardBW,
+                                                   inBW,
+                                                   numIn,
+                                                   pipelined,
+                                                   procName), metric);
+  updateMergeMetrics(metric);
+  return metric;
+}
+
+double *Metrics::genSplitMetric(unsigned guardBW,
+                                unsigned inBW,
+                                unsigned numOut,
+                                bool pipelined) {
   if (!_have_metrics) {
     return NULL;
   }
   
-  char *procName = new char[MAX_INSTANCE_LEN];
-  const char *instance =
-      NameGenerator::genSplitInstName(guardBW, inBW, numOut, procName);
+  char *procName = newScratchChars(SHORT_STRING_LEN);
+  const char *instance = NameGenerator::genSplitInstName(guardBW,
+                                                         inBW,
+                                                         numOut,
+                                                         pipelined,
+                                                         procName);
   double *metric = getOpMetric(instance);
   if (!metric) {
-    unsigned equivBW = getEquivalentBW(inBW);
-    const char *equivInstance =
-        NameGenerator::genSplitInstName(guardBW, equivBW, numOut, procName);
-    metric = getOpMetric(equivInstance);
-    if (!metric) {
-      const char *basicInstance =
-          NameGenerator::genSplitInstName(1, equivBW, 2, procName);
-      double *basicMetric = getOpMetric(basicInstance);
+    metric = getModelMetric(procName, numOut, guardBW, inBW);
+    if (metric) {
+      updateMetrics(instance, metric);
+      writeLocalMetricFile(instance, metric);
+    } else {
+      /* a 2-way split of the same width, plus the decoder of the guard */
+      double *basicMetric = getModelMetric(procName, 2, 1, inBW);
+      bool latched = false;
+      if (!basicMetric && pipelined) {
+        /* no model of the pipelined split; latch the outputs of the
+         * unpipelined one */
+        char *unpipeName = newScratchChars(SHORT_STRING_LEN);
+        NameGenerator::genSplitInstName(1, inBW, 2, false, unpipeName);
+        basicMetric = getModelMetric(unpipeName, 2, 1, inBW);
+        latched = true;
+      }
       double *decodeMetric = getOpMetric("decodeTwoToFour");
       double *invMetric = getOpMetric("inv1");
       if (!basicMetric || !decodeMetric || !invMetric) {
-        printf("No enough info to calculate metric for (%s, %s)!\n",
-               equivInstance, instance);
+        printf("No enough info to calculate metric for %s!\n", instance);
         exit(-1);
       }
-      double basicLP = getLP(basicMetric);
-      double basicEnergy = getEnergy(basicMetric);
-      double basicDelay = getDelay(basicMetric);
-      double basicArea = getArea(basicMetric);
-      double decodeLP = getLP(decodeMetric);
-      double decodeEnergy = getEnergy(decodeMetric);
-      double decodeDelay = getDelay(decodeMetric);
-      double decodeArea = getArea(decodeMetric);
-      double invLP = getLP(invMetric);
-      double invEnergy = getEnergy(invMetric);
-      double invDelay = getDelay(invMetric);
-      double invArea = getArea(invMetric);
-      double lp = basicLP + decodeLP + ceil((double) numOut / 2) * invLP;
-      double energy =
-          basicEnergy + decodeEnergy + +ceil((double) numOut / 2) * invEnergy;
-      double
-          delay =
-          basicDelay + decodeDelay + ceil((double) numOut / 2) * invDelay;
-      double
-          area = basicArea + decodeArea + ceil((double) numOut / 2) * invArea;
-      metric = new double[4];
-      metric[0] = lp;
-      metric[1] = energy;
-      metric[2] = delay;
-      metric[3] = area;
+      metric = new double[metricSize()];
+      for (unsigned c = 0; c < num_corners; c++) {
+        double basicLP = getLP(basicMetric, c);
+        double basicEnergy = getEnergy(basicMetric, c);
+        double basicDelay = getDelay(basicMetric, c);
+        double basicArea = getArea(basicMetric, c);
+        double decodeLP = getLP(decodeMetric, c);
+        double decodeEnergy = getEnergy(decodeMetric, c);
+        double decodeDelay = getDelay(decodeMetric, c);
+        double decodeArea = getArea(decodeMetric, c);
+        double invLP = getLP(invMetric, c);
+        double invEnergy = getEnergy(invMetric, c);
+        double invDelay = getDelay(invMetric, c);
+        double invArea = getArea(invMetric, c);
+        double lp = basicLP + decodeLP + ceil((double) numOut / 2) * invLP;
+        double energy =
+            basicEnergy + decodeEnergy + +ceil((double) numOut / 2) * invEnergy;
+        double
+            delay =
+            basicDelay + decodeDelay + ceil((double) numOut / 2) * invDelay;
+        double
+            area = basicArea + decodeArea + ceil((double) numOut / 2) * invArea;
+        if (latched) {
+          addLatchMetric(instance, inBW, numOut, c, lp, energy, delay, area);
+        }
+        metric[4 * c] = lp;
+        metric[4 * c + 1] = energy;
+        metric[4 * c + 2] = delay;
+        metric[4 * c + 3] = area;
+      }
       updateMetrics(instance, metric);
       writeLocalMetricFile(instance, metric);
-      writeCachedMetricFile(instance, metric);
     }
   }
-  updateStatistics(instance, metric);
+  return metric;
+}
+
+double *Metrics::getOrGenSplitMetric(unsigned guardBW,
+                                     unsigned inBW,
+                                     unsigned numOut,
+                                     bool pipelined) {
+  double *metric = genSplitMetric(guardBW, inBW, numOut, pipelined);
+  if (!metric) {
+    return NULL;
+  }
+  char *procName = newScratchChars(SHORT_STRING_LEN);
+  updateStatistics(NameGenerator::genSplitInstName(guardBW,
+                                                   inBW,
+                                                   numOut,
+                                                   pipelined,
+                                                   procName), metric);
   updateSplitMetrics(metric);
   return metric;
 }
 
 double *Metrics::getArbiterMetric(unsigned numInputs,
                                   unsigned inBW,
-                                  unsigned coutBW) {
-  double *metric = getOrGenMergeMetric(coutBW, inBW, numInputs);
-  return metric;
+                                  unsigned coutBW,
+                                  bool pipelined) {
+  return getOrGenNondetMetric(true, numInputs, inBW, coutBW, pipelined);
 }
 
 double *Metrics::getMixerMetric(unsigned numInputs,
                                 unsigned inBW,
-                                unsigned coutBW) {
-  double *metric = getOrGenMergeMetric(coutBW, inBW, numInputs);
+                                unsigned coutBW,
+                                bool pipelined) {
+  return getOrGenNondetMetric(false, numInputs, inBW, coutBW, pipelined);
+}
+
+void Metrics::getMemParams(Process *p,
+                           unsigned &depth,
+                           unsigned &width,
+                           unsigned &numRead,
+                           unsigned &numWrite) {
+  depth = 0;
+  width = 0;
+  numRead = 0;
+  numWrite = 0;
+  ActInstiter inst(p->CurScope());
+  for (inst = inst.begin(); inst != inst.end(); inst++) {
+    ValueIdx *vx = *inst;
+    InstType *instType = vx->t;
+    int bw = TypeFactory::bitWidth(instType);
+    if (bw <= 0) continue;
+    if (TypeFactory::isChanType(instType)) {
+      /* the address and the read/write select are inputs too, and may be
+       * as wide as a word */
+      const char *name = vx->getName();
+      if ((instType->getDir() == Type::direction::OUT)
+          && (strncmp(name, Constant::MEM_READ_PORT,
+                      strlen(Constant::MEM_READ_PORT)) == 0)) {
+        numRead++;
+      } else if ((instType->getDir() == Type::direction::IN)
+          && (strncmp(name, Constant::MEM_WRITE_PORT,
+                      strlen(Constant::MEM_WRITE_PORT)) == 0)) {
+        numWrite++;
+      }
+    } else if (instType->arrayInfo()) {
+      unsigned size = instType->arrayInfo()->size();
+      if ((unsigned long) size * bw > (unsigned long) depth * width) {
+        depth = size;
+        width = bw;
+      }
+    }
+  }
+}
+
+double *Metrics::getOrGenMemMetric(Process *p) {
+  if (!_have_metrics) {
+    return NULL;
+  }
+
+  unsigned depth, width, numRead, numWrite;
+  getMemParams(p, depth, width, numRead, numWrite);
+  if (!depth) {
+    if (debug_verbose) {
+      printf("mem::%s has no array\n", p->getName());
+    }
+    return NULL;
+  }
+  char *instance = newScratchChars(SHORT_STRING_LEN);
+  sprintf(instance, "mem<%u,%u,%u,%u>", depth, width, numRead, numWrite);
+  double *metric = getOpMetric(instance);
+  if (!metric) {
+    /* The std cells have no SRAM macro, so the memory is a latch array:
+     * depth * width latches, and for each port a tree of 2-to-4 decoders
+     * for the word lines and a depth-way mux (read) or the latch enables
+     * (write) per bit. An access goes through one decoder per two address
+     * bits and one mux level per address bit. */
+    double *latchMetric = getOpMetric("latch1");
+    double *muxMetric = getOpMetric("mux1");
+    double *decodeMetric = getOpMetric("decodeTwoToFour");
+    if (!latchMetric || !muxMetric || !decodeMetric) {
+      printf("No enough info to calculate metric for %s!\n", instance);
+      exit(-1);
+    }
+    unsigned numPorts = std::max(numRead + numWrite, 1u);
+    double addrBits = std::max(ceil(log2((double) depth)), 1.0);
+    double decodeLevels = ceil(addrBits / 2);
+    double numDecoders = std::max(ceil((double) (depth - 1) / 3), 1.0);
+    double numBits = (double) depth * width;
+    metric = new double[metricSize()];
+    for (unsigned c = 0; c < num_corners; c++) {
+      double lp = numBits * getLP(latchMetric, c)
+          + numPorts * numDecoders * getLP(decodeMetric, c)
+          + numRead * numBits * getLP(muxMetric, c) / 2;
+      double energy = decodeLevels * getEnergy(decodeMetric, c)
+          + width * addrBits * getEnergy(muxMetric, c) / 2
+          + width * getEnergy(latchMetric, c);
+      double delay = decodeLevels * getDelay(decodeMetric, c)
+          + addrBits * getDelay(muxMetric, c) + getDelay(latchMetric, c);
+      double area = numBits * getArea(latchMetric, c)
+          + numPorts * numDecoders * getArea(decodeMetric, c)
+          + numRead * numBits * getArea(muxMetric, c) / 2;
+      if (debug_verbose) {
+        printf("For mem::%s (%s), lp: %f, energy: %f, delay: %f, area: %f\n",
+               p->getName(), instance, lp, energy, delay, area);
+      }
+      metric[4 * c] = lp;
+      metric[4 * c + 1] = energy;
+      metric[4 * c + 2] = delay;
+      metric[4 * c + 3] = area;
+    }
+    updateMetrics(instance, metric);
+    writeLocalMetricFile(instance, metric);
+  }
+  return metric;
+}
+
+void Metrics::updateMemStatistics(Process *p, double *metric) {
+  unsigned depth, width, numRead, numWrite;
+  getMemParams(p, depth, width, numRead, numWrite);
+  char *instance = newScratchChars(SHORT_STRING_LEN);
+  sprintf(instance, "mem<%u,%u,%u,%u>", depth, width, numRead, numWrite);
+  updateStatistics(instance, metric);
+  updateMemMetrics(metric);
+}
+
+void Metrics::addLatchMetric(const char *instance,
+                             unsigned bw,
+                             unsigned numOut,
+                             unsigned c,
+                             double &lp,
+                             double &energy,
+                             double &delay,
+                             double &area) {
+  double *latchMetric = getOpMetric("latch1");
+  double *hornMetric = getOpMetric("horn2");
+  double *pulseGenMetric = getOpMetric("pulseGen");
+  if (!latchMetric || !hornMetric || !pulseGenMetric) {
+    printf("No enough info to calculate metric for %s!\n", instance);
+    exit(-1);
+  }
+  lp += numOut * bw * getLP(latchMetric, c) + getLP(pulseGenMetric, c);
+  energy += bw * getEnergy(latchMetric, c) + getEnergy(pulseGenMetric, c);
+  delay += getDelay(pulseGenMetric, c);
+  area += numOut * bw * getArea(latchMetric, c) + getArea(pulseGenMetric, c);
+  if (bw >= 32) {
+    lp += getLP(hornMetric, c);
+    energy += getEnergy(hornMetric, c);
+    delay += getDelay(hornMetric, c);
+    area += getArea(hornMetric, c);
+  }
+}
+
+double *Metrics::genNondetMetric(bool arbiter,
+                                 unsigned numIn,
+                                 unsigned inBW,
+                                 unsigned coutBW,
+                                 bool pipelined) {
+  if (!_have_metrics) {
+    return NULL;
+  }
+
+  char *procName = newScratchChars(SHORT_STRING_LEN);
+  const char *instance =
+      arbiter ? NameGenerator::genArbiterInstName(coutBW,
+                                                  inBW,
+                                                  numIn,
+                                                  pipelined,
+                                                  procName)
+              : NameGenerator::genMixerInstName(coutBW,
+                                                inBW,
+                                                numIn,
+                                                pipelined,
+                                                procName);
+  double *metric = getOpMetric(instance);
+  if (!metric) {
+    /* The requests of the inputs are combined by a tree of numIn - 1
+     * two-input stages; for a mixer the inputs are exclusive and a stage only
+     * merges them, while for an arbiter every stage is a mutex that picks one
+     * of two concurrent requests. A token passes one stage per level of the
+     * tree. The data and the index of the chosen input are then steered
+     * through an numIn-way mux. */
+    double *stageMetric = getOpMetric("twoToOne");
+    double *muxMetric = getOpMetric("mux1");
+    double *encodeMetric = getOpMetric("decodeTwoToFour");
+    if (!stageMetric || !muxMetric || !encodeMetric) {
+      printf("No enough info to calculate metric for %s!\n", instance);
+      exit(-1);
+    }
+    double mutexMetric[4 * MAX_CORNERS];
+    if (arbiter) {
+      /* There is no mutex cell. A mergeControl combines the two requests, a
+       * latch1 holds the grant, and two inv1 filter the grant until the
+       * latch has resolved, so the grant waits for all of them. */
+      double *controlMetric = getOpMetric("mergeControl");
+      double *latchMetric = getOpMetric("latch1");
+      double *invMetric = getOpMetric("inv1");
+      if (!controlMetric || !latchMetric || !invMetric) {
+        printf("No enough info to calculate metric for %s!\n", instance);
+        exit(-1);
+      }
+      for (unsigned i = 0; i < metricSize(); i++) {
+        mutexMetric[i] = controlMetric[i] + latchMetric[i] + 2 * invMetric[i];
+      }
+      stageMetric = mutexMetric;
+    }
+    unsigned numStages = numIn - 1;
+    double depth = ceil(log2((double) numIn));
+    unsigned muxBW = inBW + coutBW;
+    metric = new double[metricSize()];
+    for (unsigned c = 0; c < num_corners; c++) {
+      double lp = numStages * getLP(stageMetric, c)
+          + getLP(encodeMetric, c) + numIn * (muxBW * getLP(muxMetric, c) / 2);
+      double energy = depth * getEnergy(stageMetric, c)
+          + getEnergy(encodeMetric, c) + muxBW * getEnergy(muxMetric, c) / 2;
+      double delay = depth * getDelay(stageMetric, c)
+          + getDelay(encodeMetric, c);
+      double area = numStages * getArea(stageMetric, c)
+          + getArea(encodeMetric, c)
+          + numIn * (muxBW * getArea(muxMetric, c) / 2);
+      if (pipelined) {
+        addLatchMetric(instance, muxBW, 1, c, lp, energy, delay, area);
+      }
+      if (debug_verbose) {
+        printf("For %s, lp: %f, energy: %f, delay: %f, area: %f\n",
+               instance, lp, energy, delay, area);
+      }
+      metric[4 * c] = lp;
+      metric[4 * c + 1] = energy;
+      metric[4 * c + 2] = delay;
+      metric[4 * c + 3] = area;
+    }
+    updateMetrics(instance, metric);
+    writeLocalMetricFile(instance, metric);
+  }
+  return metric;
+}
+
+double *Metrics::getOrGenNondetMetric(bool arbiter,
+                                      unsigned numIn,
+                                      unsigned inBW,
+                                      unsigned coutBW,
+                                      bool pipelined) {
+  double *metric = genNondetMetric(arbiter, numIn, inBW, coutBW, pipelined);
+  if (!metric) {
+    return NULL;
+  }
+  char *procName = newScratchChars(SHORT_STRING_LEN);
+  const char *instance =
+      arbiter ? NameGenerator::genArbiterInstName(coutBW,
+                                                  inBW,
+                                                  numIn,
+                                                  pipelined,
+                                                  procName)
+              : NameGenerator::genMixerInstName(coutBW,
+                                                inBW,
+                                                numIn,
+                                                pipelined,
+                                                procName);
+  updateStatistics(instance, metric);
+  updateNondetMetrics(metric);
   return metric;
 }
 
 void Metrics::updateCopyStatistics(unsigned bitwidth, unsigned numOutputs) {
+  if (recordStatistics(COPY_STAT, "", nullptr, bitwidth, numOutputs)) {
+    return;
+  }
+  for (unsigned c = 1; c <= cornerStatistics.size(); c++) {
+    cornerStatistics[c - 1]->updateCopyStatistics(bitwidth, numOutputs);
+  }
   auto copyStatisticsIt = copyStatistics.find(bitwidth);
   if (copyStatisticsIt != copyStatistics.end()) {
     Map<unsigned, unsigned> &record = copyStatisticsIt->second;
@@ -901,8 +1746,43 @@ void Metrics::printStatistics() {
           mergeLeakPower, ((double) 100 * mergeLeakPower / totalLeakPowewr));
   fprintf(statisticsFP, "Split LeakPower: %.2f, ratio: %5.1f\n",
           splitLeakPower, ((double) 100 * splitLeakPower / totalLeakPowewr));
+  if (memArea > 0) {
+    fprintf(statisticsFP,
+            "Memory area: %.2f, ratio: %5.1f, LeakPower: %.2f, ratio: %5.1f\n",
+            memArea, ((double) 100 * memArea / totalArea),
+            memLeakPower, ((double) 100 * memLeakPower / totalLeakPowewr));
+  }
+  if (nondetArea > 0) {
+    fprintf(statisticsFP,
+            "Mixer/arbiter area: %.2f, ratio: %5.1f, LeakPower: %.2f, "
+            "ratio: %5.1f\n",
+            nondetArea, ((double) 100 * nondetArea / totalArea),
+            nondetLeakPower,
+            ((double) 100 * nondetLeakPower / totalLeakPowewr));
+  }
+  if (slackBuffs) {
+    fprintf(statisticsFP,
+            "Slack buffers: %u, area: %.2f, ratio: %5.1f, LeakPower: %.2f, "
+            "ratio: %5.1f\n",
+            slackBuffs,
+            slackArea, ((double) 100 * slackArea / totalArea),
+            slackLeakPower, ((double) 100 * slackLeakPower / totalLeakPowewr));
+  }
   printAreaStatistics(statisticsFP);
   printLeakpowerStatistics(statisticsFP);
+  printThroughputStatistics(statisticsFP);
+  fitMetricModel();
+  if (!metricModels.empty() && !metricModels[0].empty()) {
+    metricModels[0].printError(statisticsFP);
+  }
+  if (!cornerFallbacks.empty()) {
+    fprintf(statisticsFP,
+            "%zu metrics of other corners fell back to corner %s\n\n",
+            cornerFallbacks.size(), corner_names[0]);
+  }
+  if (activityLog) {
+    activityLog->print(statisticsFP, corner);
+  }
   fclose(statisticsFP);
 }
 
@@ -919,101 +1799,210 @@ void Metrics::printCopyStatistics(FILE *statisticsFP) {
   fprintf(statisticsFP, "\n");
 }
 
-void Metrics::updateMergeMetrics(double metric[4]) {
+void Metrics::updateSlackMetrics(unsigned nBuff, double *metric) {
+  if (recordStatistics(SLACK_STAT, "", metric, 0, nBuff)) {
+    return;
+  }
+  for (unsigned c = 1; c <= cornerStatistics.size(); c++) {
+    cornerStatistics[c - 1]->updateSlackMetrics(nBuff, metric ? metric + 4 * c : nullptr);
+  }
+  slackBuffs += nBuff;
+  if (metric) {
+    slackArea += getArea(metric);
+    slackLeakPower += getLP(metric);
+  }
+}
+
+void Metrics::updateThroughput(const char *process,
+                               double cycleTime,
+                               const char *criticalCycle,
+                               unsigned corner) {
+  double metric[4 * MAX_CORNERS] = {cycleTime};
+  if (recordStatistics(THROUGHPUT_STAT, process, metric, 0, corner,
+                       criticalCycle)) {
+    return;
+  }
+  if (corner > 0) {
+    if (corner <= cornerStatistics.size()) {
+      cornerStatistics[corner - 1]->updateThroughput(process,
+                                                     cycleTime,
+                                                     criticalCycle);
+    }
+    return;
+  }
+  ThroughputStatistics record = {process, cycleTime, criticalCycle};
+  throughputStatistics.push_back(record);
+}
+
+/* the slowest process bounds the cycle time of the design; processes that
+ * deadlock come first */
+void Metrics::printThroughputStatistics(FILE *statisticsFP) {
+  fprintf(statisticsFP, "Throughput Statistics:\n");
+  Vector<unsigned> sortedIdx(throughputStatistics.size());
+  for (unsigned i = 0; i < sortedIdx.size(); i++) {
+    sortedIdx[i] = i;
+  }
+  auto cycleTime = [&](unsigned idx) {
+    double res = throughputStatistics[idx].cycleTime;
+    return (res < 0) ? INFINITY : res;
+  };
+  std::stable_sort(sortedIdx.begin(), sortedIdx.end(),
+                   [&](unsigned lhs, unsigned rhs) {
+                     return cycleTime(lhs) > cycleTime(rhs);
+                   });
+  if (!sortedIdx.empty()) {
+    const ThroughputStatistics &worst = throughputStatistics[sortedIdx[0]];
+    if (worst.cycleTime < 0) {
+      fprintf(statisticsFP, "Estimated cycle time: deadlock (%s)\n",
+              worst.process.c_str());
+    } else {
+      fprintf(statisticsFP, "Estimated cycle time: %.2f ps (%s)\n",
+              worst.cycleTime, worst.process.c_str());
+    }
+  }
+  for (auto &idx: sortedIdx) {
+    const ThroughputStatistics &record = throughputStatistics[idx];
+    if (record.cycleTime < 0) {
+      fprintf(statisticsFP, "  %s: deadlock, cycle without tokens: %s\n",
+              record.process.c_str(), record.criticalCycle.c_str());
+    } else if (record.criticalCycle.empty()) {
+      fprintf(statisticsFP, "  %s: no cycle\n", record.process.c_str());
+    } else {
+      fprintf(statisticsFP, "  %s: cycle time %.2f ps, critical cycle: %s\n",
+              record.process.c_str(), record.cycleTime,
+              record.criticalCycle.c_str());
+    }
+  }
+  fprintf(statisticsFP, "\n");
+}
+
+void Metrics::updateMergeMetrics(double *metric) {
+  if (recordStatistics(MERGE_STAT, "", metric, 0, 0)) {
+    return;
+  }
+  for (unsigned c = 1; c <= cornerStatistics.size(); c++) {
+    cornerStatistics[c - 1]->updateMergeMetrics(metric + 4 * c);
+  }
   double area = getArea(metric);
   double leakPower = getLP(metric);
   mergeArea += area;
   mergeLeakPower += leakPower;
 }
 
-void Metrics::updateSplitMetrics(double metric[4]) {
+void Metrics::updateNondetMetrics(double *metric) {
+  if (recordStatistics(NONDET_STAT, "", metric, 0, 0)) {
+    return;
+  }
+  for (unsigned c = 1; c <= cornerStatistics.size(); c++) {
+    cornerStatistics[c - 1]->updateNondetMetrics(metric + 4 * c);
+  }
+  nondetArea += getArea(metric);
+  nondetLeakPower += getLP(metric);
+}
+
+void Metrics::updateMemMetrics(double *metric) {
+  if (recordStatistics(MEM_STAT, "", metric, 0, 0)) {
+    return;
+  }
+  for (unsigned c = 1; c <= cornerStatistics.size(); c++) {
+    cornerStatistics[c - 1]->updateMemMetrics(metric + 4 * c);
+  }
+  memArea += getArea(metric);
+  memLeakPower += getLP(metric);
+}
+
+void Metrics::updateSplitMetrics(double *metric) {
+  if (recordStatistics(SPLIT_STAT, "", metric, 0, 0)) {
+    return;
+  }
+  for (unsigned c = 1; c <= cornerStatistics.size(); c++) {
+    cornerStatistics[c - 1]->updateSplitMetrics(metric + 4 * c);
+  }
   double area = getArea(metric);
   double leakPower = getLP(metric);
   splitArea += area;
   splitLeakPower += leakPower;
 }
 
-void Metrics::updateStatistics(const char *instName, double metric[4]) {
+SymbolId Metrics::getNormInstanceId(const char *instance) {
+  return SymbolTable::getNormInstance(SymbolTable::intern(instance));
+}
+
+InstStatistics &Metrics::getInstStatistics(const char *instance) {
+  auto instStatisticsIdxIt =
+      instStatisticsIdx.find(SymbolTable::intern(instance));
+  if (instStatisticsIdxIt == instStatisticsIdx.end()) {
+    printf("We could not find %s in instStatistics!\n", instance);
+    exit(-1);
+  }
+  return instStatistics[instStatisticsIdxIt->second].second;
+}
+
+void Metrics::updateStatistics(const char *instName, double *metric) {
+  if (recordStatistics(INST_STAT, instName, metric, 0, 0)) {
+    return;
+  }
+  for (unsigned c = 1; c <= cornerStatistics.size(); c++) {
+    cornerStatistics[c - 1]->updateStatistics(instName, metric + 4 * c);
+  }
   double area = getArea(metric);
   double leakPower = getLP(metric);
   totalArea += area;
   totalLeakPowewr += leakPower;
-  bool exist = false;
-  for (auto &areaStatisticsIt: areaStatistics) {
-    if (!strcmp(areaStatisticsIt.first, instName)) {
-      areaStatisticsIt.second += area;
-      exist = true;
-    }
-  }
-  if (exist) {
-    bool foundLP = false;
-    for (auto &leakpowerStatisticsIt: leakpowerStatistics) {
-      if (!strcmp(leakpowerStatisticsIt.first, instName)) {
-        leakpowerStatisticsIt.second += leakPower;
-        foundLP = true;
-        break;
-      }
-    }
-    if (!foundLP) {
-      printf(
-          "We could find %s in areaStatistics, but not in leakpowerStatistics!\n",
-          instName);
-      exit(-1);
-    }
-    for (auto &instanceCntIt: instanceCnt) {
-      if (!strcmp(instanceCntIt.first, instName)) {
-        instanceCntIt.second += 1;
-        return;
-      }
-    }
-    printf("We could find %s in areaStatistics, but not in instanceCnt!\n",
-           instName);
-    exit(-1);
+  SymbolId instId = SymbolTable::intern(instName);
+  auto instStatisticsIdxIt = instStatisticsIdx.find(instId);
+  if (instStatisticsIdxIt != instStatisticsIdx.end()) {
+    InstStatistics &record = instStatistics[instStatisticsIdxIt->second].second;
+    record.area += area;
+    record.leakPower += leakPower;
+    record.cnt += 1;
   } else {
-    areaStatistics.insert({instName, area});
-    leakpowerStatistics.insert({instName, leakPower});
-    instanceCnt.insert({instName, 1});
+    InstStatistics record = {area, leakPower, 1};
+    instStatisticsIdx.insert({instId, instStatistics.size()});
+    instStatistics.emplace_back(instName, record);
   }
 }
 
 int Metrics::getInstanceCnt(const char *instance) {
-  for (auto &instanceCntIt: instanceCnt) {
-    if (!strcmp(instanceCntIt.first, instance)) {
-      return instanceCntIt.second;
-    }
-  }
-  printf("We could not find %s in instanceCnt!\n", instance);
-  exit(-1);
+  return getInstStatistics(instance).cnt;
 }
 
 double Metrics::getInstanceArea(const char *instance) {
-  for (auto &areaStatisticsIt: areaStatistics) {
-    if (!strcmp(areaStatisticsIt.first, instance)) {
-      return areaStatisticsIt.second;
-    }
+  return getInstStatistics(instance).area;
+}
+
+/* sort the instances by area (or leak power) in descending order; instances
+ * with the same value keep the order in which they are first used */
+Vector<unsigned> Metrics::sortInstStatistics(bool byArea) {
+  Vector<unsigned> sortedIdx(instStatistics.size());
+  for (unsigned i = 0; i < sortedIdx.size(); i++) {
+    sortedIdx[i] = i;
   }
-  printf("We could not find %s in instanceCnt!\n", instance);
-  exit(-1);
+  std::stable_sort(sortedIdx.begin(), sortedIdx.end(),
+                   [&](unsigned lhs, unsigned rhs) {
+                     const InstStatistics &l = instStatistics[lhs].second;
+                     const InstStatistics &r = instStatistics[rhs].second;
+                     return byArea ? (l.area > r.area)
+                                   : (l.leakPower > r.leakPower);
+                   });
+  return sortedIdx;
 }
 
 void Metrics::printLeakpowerStatistics(FILE *statisticsFP) {
   fprintf(statisticsFP, "Leak Power Statistics:\n");
   fprintf(statisticsFP, "totalLeakPower: %.2f\n", totalLeakPowewr);
-  if (!leakpowerStatistics.empty() && (totalLeakPowewr == 0)) {
+  if (!instStatistics.empty() && (totalLeakPowewr == 0)) {
     printf("leakpowerStatistics is not empty, but totalLeakPowewr is 0!\n");
     exit(-1);
   }
-  std::multimap<double, const char *>
-      sortedLeakpowers = flip_map(leakpowerStatistics);
-  for (auto iter = sortedLeakpowers.rbegin();
-       iter != sortedLeakpowers.rend(); iter++) {
-    double leakPower = iter->first;
+  for (auto &idx: sortInstStatistics(false)) {
+    const char *instance = instStatistics[idx].first.c_str();
+    const InstStatistics &record = instStatistics[idx].second;
+    double leakPower = record.leakPower;
     double ratio = (double) leakPower / totalLeakPowewr * 100;
-    const char *instance = iter->second;
     if (ratio > 0.1) {
-      int cnt = getInstanceCnt(instance);
       fprintf(statisticsFP, "%80.50s %5.1f %5.1f %5d\n", instance, leakPower,
-              ratio, cnt);
+              ratio, record.cnt);
     }
   }
   fprintf(statisticsFP, "\n");
@@ -1022,30 +2011,183 @@ void Metrics::printLeakpowerStatistics(FILE *statisticsFP) {
 void Metrics::printAreaStatistics(FILE *statisticsFP) {
   fprintf(statisticsFP, "Area Statistics:\n");
   fprintf(statisticsFP, "totalArea: %.2f\n", totalArea);
-  if (!areaStatistics.empty() && (totalArea == 0)) {
+  if (!instStatistics.empty() && (totalArea == 0)) {
     printf("areaStatistics is not empty, but totalArea is 0!\n");
     exit(-1);
   }
-  std::multimap<double, const char *> sortedAreas = flip_map(areaStatistics);
   fprintf(statisticsFP,
           "instance name      area     percentage     # of instances\n");
-  for (auto iter = sortedAreas.rbegin(); iter != sortedAreas.rend(); iter++) {
-    double area = iter->first;
+  for (auto &idx: sortInstStatistics(true)) {
+    const char *instance = instStatistics[idx].first.c_str();
+    const InstStatistics &record = instStatistics[idx].second;
+    double area = record.area;
     double ratio = (double) area / totalArea * 100;
-    const char *instance = iter->second;
     if (ratio > 0.1) {
-      int cnt = getInstanceCnt(instance);
       fprintf(statisticsFP,
               "%80.80s %5.2f %5.1f %5d\n",
               instance,
               area,
               ratio,
-              cnt);
+              record.cnt);
     }
   }
   fprintf(statisticsFP, "\n");
 }
 
+void Metrics::recordStatistics(Vector<StatRecord> *records) {
+  statRecords = records;
+}
+
+bool Metrics::recordStatistics(StatType type,
+                               const char *instance,
+                               double *metric,
+                               unsigned bitwidth,
+                               unsigned numOutputs,
+                               const char *cycle) {
+  if (!statRecords) {
+    return false;
+  }
+  StatRecord record;
+  record.type = type;
+  record.instance = instance;
+  for (unsigned i = 0; i < metricSize(); i++) {
+    record.metric[i] = metric ? metric[i] : 0;
+  }
+  record.bitwidth = bitwidth;
+  record.numOutputs = numOutputs;
+  record.cycle = cycle;
+  statRecords->push_back(record);
+  return true;
+}
+
+void Metrics::recordMetricDeps(StringMap<String> *deps) {
+  metricDeps = deps;
+}
+
+String Metrics::formatMetricDep(const char *normInstance, double *metric) {
+  String dep;
+  for (unsigned c = 0; c < num_corners; c++) {
+    dep += formatMetricLine(normInstance, metric + 4 * c) + "\n";
+  }
+  return dep;
+}
+
+void Metrics::recordMetricDep(SymbolId normId, double *metric) {
+  if (!metricDeps) {
+    return;
+  }
+  const char *normInstance = SymbolTable::getName(normId);
+  (*metricDeps)[normInstance] = formatMetricDep(normInstance, metric);
+}
+
+/* the lines are compared rather than the metrics, since a metric generated
+ * in one run is read back from its line of the local metric file in the
+ * next */
+bool Metrics::checkMetricDeps(StringMap<String> &deps) {
+  if (!_have_metrics) {
+    return deps.empty();
+  }
+  for (auto &depsIt: deps) {
+    const char *normInstance = depsIt.first.c_str();
+    double *metric = findOpMetric(SymbolTable::intern(normInstance));
+    if (!metric || (formatMetricDep(normInstance, metric) != depsIt.second)) {
+      if (debug_verbose) {
+        printf("The metric of %s has changed\n", normInstance);
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+uint64_t Metrics::getMappingFingerprint() {
+  std::ostringstream env;
+  env << std::hex << getCacheFingerprint() << std::dec << "\n";
+  for (unsigned c = 0; c < num_corners; c++) {
+    /* the size and the modification time stand in for the contents, as for
+     * the compiled image of the file */
+    const char *stdFile = getCornerFile(std_metrics, corner_names[c]);
+    struct stat st;
+    if (stat(stdFile, &st) == 0) {
+      env << stdFile << " " << st.st_size << " " << st.st_mtim.tv_sec << "."
+          << st.st_mtim.tv_nsec << "\n";
+    } else {
+      env << stdFile << " none\n";
+    }
+  }
+  String envStr = env.str();
+  return MetricsDB::hashName(envStr.c_str(), envStr.size());
+}
+
+void Metrics::replayStatistics(Vector<StatRecord> &records) {
+  for (auto &record: records) {
+    switch (record.type) {
+      case INST_STAT: {
+        updateStatistics(record.instance.c_str(), record.metric);
+        break;
+      }
+      case MERGE_STAT: {
+        updateMergeMetrics(record.metric);
+        break;
+      }
+      case SPLIT_STAT: {
+        updateSplitMetrics(record.metric);
+        break;
+      }
+      case NONDET_STAT: {
+        updateNondetMetrics(record.metric);
+        break;
+      }
+      case MEM_STAT: {
+        updateMemMetrics(record.metric);
+        break;
+      }
+      case COPY_STAT: {
+        updateCopyStatistics(record.bitwidth, record.numOutputs);
+        break;
+      }
+      case SLACK_STAT: {
+        updateSlackMetrics(record.numOutputs, record.metric);
+        break;
+      }
+      case METRIC_STAT: {
+        /* generated by several processes, or read back from the local
+         * metric file if the process comes from the process cache */
+        const char *instance = record.instance.c_str();
+        SymbolId normId = getNormInstanceId(instance);
+        double *metric = findOpMetric(normId);
+        if (!metric) {
+          metric = newMetric(record.metric);
+          updateMetrics(instance, metric);
+        }
+        if (customMetricsDBs.empty()
+            || !customMetricsDBs[0]->lookup(SymbolTable::getName(normId))) {
+          writeLocalMetricFile(instance, metric);
+        }
+        break;
+      }
+      case CORNER_FALLBACK_STAT: {
+        cornerFallbacks.insert(SymbolTable::intern(record.instance.c_str()));
+        break;
+      }
+      case THROUGHPUT_STAT: {
+        updateThroughput(record.instance.c_str(),
+                         record.metric[0],
+                         record.cycle.c_str(),
+                         record.numOutputs);
+        break;
+      }
+      default: {
+        printf("Unknown statistics record type %d\n", record.type);
+        exit(-1);
+      }
+    }
+  }
+}
+
 void Metrics::dump() {
   printStatistics();
+  for (auto &metrics: cornerStatistics) {
+    metrics->printStatistics();
+  }
 }
@@ -27,52 +27,179 @@
 #include <cstring>
 #include <fstream>
 #include <sstream>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
 #include <act/act.h>
 #include "src/common/common.h"
 #include "src/common/Helper.h"
+#include "src/common/OutputStream.h"
 #include "src/common/config.h"
 #include "src/core/NameGenerator.h"
+#include "src/core/MetricsDB.h"
+#include "src/core/CacheBackend.h"
+#include "src/core/ActivityLog.h"
+#include "src/core/MetricModel.h"
 #if LOGIC_OPTIMIZER
 #include <act/expropt.h>
 #endif
 
+/* flush the queued metric lines once they take this many bytes */
+#define METRICS_FLUSH_SIZE (1 << 20)
+
+typedef struct instStatistics {
+  double area;
+  double leakPower;
+  int cnt;
+} InstStatistics;
+
+enum StatType {
+  INST_STAT,
+  MERGE_STAT,
+  SPLIT_STAT,
+  COPY_STAT,
+  NONDET_STAT,
+  MEM_STAT,
+  THROUGHPUT_STAT,
+  SLACK_STAT,
+  /* a metric generated while mapping a process; see writeLocalMetricFile */
+  METRIC_STAT,
+  CORNER_FALLBACK_STAT
+};
+
+typedef struct throughputStatistics {
+  String process;
+  /* ps; 0 if the process has no cycle, -1 if it deadlocks */
+  double cycleTime;
+  String criticalCycle;
+} ThroughputStatistics;
+
+/* a statistics update made while mapping one process in a worker */
+typedef struct statRecord {
+  StatType type;
+  String instance;
+  /* the metric of corner c starts at metric + 4 * c */
+  double metric[4 * MAX_CORNERS];
+  unsigned bitwidth;
+  unsigned numOutputs;
+  /* critical cycle of a THROUGHPUT_STAT */
+  String cycle;
+} StatRecord;
+
+#if LOGIC_OPTIMIZER
+/* everything the logic optimizer needs to characterize one FU */
+typedef struct fuJob {
+  const char *instance;
+  const char *fuKey;
+  StringMap<unsigned> inBW;
+  StringMap<unsigned> hiddenBW;
+  Map<const char *, Expr *> exprMap;
+  Map<Expr *, Expr *> hiddenExprs;
+  Map<unsigned int, unsigned int> outRecord;
+  UIntVec outBWList;
+  double cost;
+} FUJob;
+#endif
+
+/* A metric holds (leak power, dyn energy, delay, area) for every corner in
+ * corner_names, 4 * num_corners doubles in all; the metric of corner c
+ * starts at metric + 4 * c. Code that only looks at the first 4 doubles sees
+ * corner 0, which drives the mapping. */
 class Metrics {
  public:
   Metrics(const char *customFUMetricsFP,
           const char *stdFUMetricsFP,
           const char *statisticsFP);
 
+  /* # of doubles in a metric */
+  static unsigned metricSize() { return 4 * num_corners; }
+
+  /* the statistics of corner (> 0) are written to their own file */
+  void setCornerStatistics(unsigned corner, const char *statisticsFP);
+
   void updateMetrics(const char *instance, double *metric);
 
   void updateCachedMetrics(const char *instance, double *metric);
 
   void updateCopyStatistics(unsigned bitwidth, unsigned numOutputs);
 
-  void updateStatistics(const char *instName, double metric[4]);
+  void updateStatistics(const char *instName, double *metric);
+
+  /* record the result of the throughput analysis of a dataflow process with
+   * the delays of the given corner */
+  void updateThroughput(const char *process,
+                        double cycleTime,
+                        const char *criticalCycle,
+                        unsigned corner = 0);
 
   void printOpMetrics();
 
   double *getOpMetric(const char *instance);
 
-  double *getCachedMetric(const char *instance);
+  /* metric of the FU with content address fuKey from the shared cache */
+  double *getCachedMetric(const char *instance, const char *fuKey);
 
   int getInstanceCnt(const char *instance);
 
   double getInstanceArea(const char *instance);
 
-  void readMetricsFile();
+  /* attach the metric files; each one is loaded on its first lookup */
+  void openMetricsDB();
 
+  /* hash of the environment of every corner the FU cache entries are valid
+   * for; it is part of every FU key, so a change of it turns the old entries
+   * into misses */
+  uint64_t getCacheFingerprint();
+
+  /* queue a line for the local metric file, once per metric; see
+   * flushMetricFiles. While statistics are recorded, the metric is recorded
+   * instead, so that only the parent writes the file */
   void writeLocalMetricFile(const char *instance, double *metric);
 
-  void writeCachedMetricFile(const char *instance, double *metric);
+  /* write the queued metric lines and cache index rows; called at the end
+   * of a run and before forking workers */
+  void flushMetricFiles();
+
+  void updateMergeMetrics(double *metric);
 
-  void updateMergeMetrics(double metric[4]);
+  void updateSplitMetrics(double *metric);
 
-  void updateSplitMetrics(double metric[4]);
+  /* a mixer or an arbiter */
+  void updateNondetMetrics(double *metric);
+
+  void updateMemMetrics(double *metric);
+
+  /* nBuff buffers added by slack matching, with their total metric */
+  void updateSlackMetrics(unsigned nBuff, double *metric);
+
+  /* report the dynamic energy of the activity in the log with the other
+   * statistics */
+  void setActivityLog(ActivityLog *log);
 
   void dump();
 
-  static unsigned getEquivalentBW(unsigned oriBW);
+  /* evict the least recently used cache entries beyond the configured size
+   * and entry caps, and rewrite the cache index without stale rows */
+  void compactCache();
+
+  /* if records is not null, every statistics update is appended to it
+   * instead of applied, until replayStatistics applies it */
+  void recordStatistics(Vector<StatRecord> *records);
+
+  void replayStatistics(Vector<StatRecord> &records);
+
+  /* if deps is not null, record every instance whose metric is looked up or
+   * generated from here on, with the lines of the metric files it resolves
+   * to (one per corner) */
+  void recordMetricDeps(StringMap<String> *deps);
+
+  /* whether every recorded instance still resolves to the same lines */
+  bool checkMetricDeps(StringMap<String> &deps);
+
+  /* hash of what mapping a process depends on besides the process itself
+   * and its metric deps: the FU cache environment and the std metric files
+   * the models are fitted from */
+  uint64_t getMappingFingerprint();
 
   double *getOrGenCopyMetric(unsigned bitwidth, unsigned numOut);
 
@@ -80,11 +207,16 @@ class Metrics {
 
   double *getOrGenInitMetric(unsigned bitwidth);
 
+  /* metric of a chain of nBuff latches, without recording statistics */
+  double *genBuffMetric(unsigned nBuff, unsigned bw);
+
+  /* genBuffMetric, and add the latches to the statistics */
   double *getBuffMetric(unsigned nBuff, unsigned bw);
 
   void callLogicOptimizer(
 #if LOGIC_OPTIMIZER
       const char *instance,
+      const char *fuKey,
       StringMap<unsigned> &inBW,
       StringMap<unsigned> &hiddenBW,
       Map<const char *, Expr *> &exprMap,
@@ -104,19 +236,79 @@ class Metrics {
       Map<unsigned int, unsigned int> &outRecord,
       UIntVec &outBWList,
 #endif
-      const char *instance);
+      const char *instance,
+      const char *fuKey);
+
+#if LOGIC_OPTIMIZER
+  void queueFUMetric(StringMap<unsigned> &inBW,
+                     StringMap<unsigned> &hiddenBW,
+                     Map<const char *, Expr *> &exprMap,
+                     Map<Expr *, Expr *> &hiddenExprs,
+                     Map<unsigned int, unsigned int> &outRecord,
+                     UIntVec &outBWList,
+                     const char *instance,
+                     const char *fuKey);
+#endif
+
+  void runFUJobs(unsigned numJobs);
+
+  /* the scratch arena of a process mapped in the collect pass, freed once
+   * runFUJobs is done with the FUs queued from it */
+  Arena *newJobArena();
 
   double *getSourceMetric();
 
-  double *getOrGenMergeMetric(unsigned guardBW, unsigned inBW, unsigned numIn);
+  /* the gen*Metric functions below only look up or compose the metric of a
+   * control unit, so that both of its variants can be weighed; the
+   * getOrGen*Metric ones also record the unit in the statistics */
+  double *genMergeMetric(unsigned guardBW,
+                         unsigned inBW,
+                         unsigned numIn,
+                         bool pipelined);
 
-  double *getOrGenSplitMetric(unsigned guardBW, unsigned inBW, unsigned numOut);
+  double *getOrGenMergeMetric(unsigned guardBW,
+                              unsigned inBW,
+                              unsigned numIn,
+                              bool pipelined);
 
-  double *getArbiterMetric(unsigned numInputs, unsigned inBW, unsigned coutBW);
+  double *genSplitMetric(unsigned guardBW,
+                         unsigned inBW,
+                         unsigned numOut,
+                         bool pipelined);
+
+  double *getOrGenSplitMetric(unsigned guardBW,
+                              unsigned inBW,
+                              unsigned numOut,
+                              bool pipelined);
+
+  double *getArbiterMetric(unsigned numInputs,
+                           unsigned inBW,
+                           unsigned coutBW,
+                           bool pipelined);
 
   double *getMixerMetric(unsigned numInputs,
                          unsigned inBW,
-                         unsigned coutBW);
+                         unsigned coutBW,
+                         bool pipelined);
+
+  /* metric of a process of the mem namespace, from the size of its array
+   * and its ports */
+  double *getOrGenMemMetric(Process *p);
+
+  /* add one instance of the mem process p to the statistics */
+  void updateMemStatistics(Process *p, double *metric);
+
+  double *genNondetMetric(bool arbiter,
+                          unsigned numIn,
+                          unsigned inBW,
+                          unsigned coutBW,
+                          bool pipelined);
+
+  double *getOrGenNondetMetric(bool arbiter,
+                               unsigned numIn,
+                               unsigned inBW,
+                               unsigned coutBW,
+                               bool pipelined);
 
   bool validMetrics() { return _have_metrics; }
 
@@ -124,23 +316,61 @@ class Metrics {
 
   bool _have_metrics;
   
-  /* operator, (leak power (nW), dyn energy (e-15J), delay (ps), area (um^2)) */
-  Map<const char *, double *> opMetrics;
+  /* normalized instance name, (leak power (nW), dyn energy (e-15J), delay (ps),
+   * area (um^2)) */
+  SymbolMap<double *> opMetrics;
 
-  Map<const char *, double *> cachedMetrics;
+  SymbolMap<double *> cachedMetrics;
 
   /* copy bitwidth,< # of output, # of instances of this COPY> */
   Map<unsigned, Map<unsigned, unsigned >> copyStatistics;
 
   double totalArea;
 
-  /* instanceName, area (um^2) of all of the instances of the process */
-  Map<const char *, double> areaStatistics;
-
   double totalLeakPowewr;
 
-  /* instanceName, LeakPower (nW) of all of the instances of the process */
-  Map<const char *, double> leakpowerStatistics;
+  /* instanceName, index of its record in instStatistics */
+  SymbolMap<unsigned> instStatisticsIdx;
+
+  /* instanceName, area (um^2), LeakPower (nW) and # of instances of the
+   * process, in the order the instances are first used */
+  Vector<Pair<String, InstStatistics>> instStatistics;
+
+  /* see recordStatistics(Vector<StatRecord> *) */
+  Vector<StatRecord> *statRecords;
+
+  /* see recordMetricDeps */
+  StringMap<String> *metricDeps;
+
+  String formatMetricDep(const char *normInstance, double *metric);
+
+  void recordMetricDep(SymbolId normId, double *metric);
+
+  /* whether the update is recorded, and so must not be applied */
+  bool recordStatistics(StatType type,
+                        const char *instance,
+                        double *metric,
+                        unsigned bitwidth,
+                        unsigned numOutputs,
+                        const char *cycle = "");
+
+  /* in the order the processes are mapped */
+  Vector<ThroughputStatistics> throughputStatistics;
+
+  ActivityLog *activityLog;
+
+  /* the corner the statistics of this object are for */
+  unsigned corner;
+
+  /* the statistics of corner c > 0 are collected by cornerStatistics[c - 1],
+   * which only receives the statistics updates of this object */
+  Vector<Metrics *> cornerStatistics;
+
+  /* the corner keys of the metrics of a corner > 0 that fell back to the
+   * metric of corner 0 */
+  SymbolSet cornerFallbacks;
+
+  void addCornerFallback(const char *name, unsigned corner);
 
   double mergeArea;
 
@@ -150,11 +380,72 @@ class Metrics {
 
   double splitLeakPower;
 
-  /* instanceName, # of instances */
-  Map<const char *, int> instanceCnt;
+  double nondetArea;
+
+  double nondetLeakPower;
+
+  double memArea;
+
+  double memLeakPower;
+
+  /* depth and word width of the largest array of a mem process, and its #
+   * of read ("DO" outputs) and write ("DI" inputs) data ports */
+  static void getMemParams(Process *p,
+                           unsigned &depth,
+                           unsigned &width,
+                           unsigned &numRead,
+                           unsigned &numWrite);
+
+  unsigned slackBuffs;
+
+  double slackArea;
+
+  double slackLeakPower;
+
+  /* see newJobArena */
+  Vector<Arena *> jobArenas;
+
+  void freeJobArenas();
+
+#if LOGIC_OPTIMIZER
+  /* FUs waiting for the logic optimizer, in the order they are first used */
+  Vector<FUJob> fuJobs;
+
+  /* normalized instance name, index of its job in fuJobs */
+  SymbolMap<unsigned> fuJobIdx;
+
+  ExprBlockInfo *runExternalOpt(const char *instance,
+                                const char *fuKey,
+                                StringMap<unsigned> &inBW,
+                                StringMap<unsigned> &hiddenBW,
+                                Map<const char *, Expr *> &exprMap,
+                                Map<Expr *, Expr *> &hiddenExprs,
+                                Map<unsigned int, unsigned int> &outRecord,
+                                UIntVec &outBWList);
+
+  /* final metric of an optimized FU, published to the cache; a corner named
+   * "fast" takes the min delay and the max power of the optimizer, "slow"
+   * the max delay, and any other the typical numbers */
+  double *genFUMetric(const char *instance,
+                      const char *fuKey,
+                      StringMap<unsigned> &inBW,
+                      ExprBlockInfo *info);
+
+  /* record the metric of a freshly optimized FU for this run */
+  void useFUMetric(const char *instance, const char *fuKey, double *metric);
+#endif
+
+  /* lines for the local metric file of each corner, not written yet */
+  Vector<String> pendingLocalMetrics;
+
+  /* the metrics queued for the local metric file in this run */
+  SymbolSet localMetrics;
 
   const char *custom_metrics;
 
+  /* the local metric file of each corner */
+  Vector<const char *> customMetricsFiles;
+
   const char *std_metrics;
 
   const char *statisticsFilePath;
@@ -165,17 +456,99 @@ class Metrics {
 
   void printCopyStatistics(FILE *statisticsFP);
 
+  void printThroughputStatistics(FILE *statisticsFP);
+
+  static SymbolId getNormInstanceId(const char *instance);
+
+  InstStatistics &getInstStatistics(const char *instance);
+
+  Vector<unsigned> sortInstStatistics(bool byArea);
+
   void printStatistics();
 
-  static double getArea(double metric[4]);
+  static double getArea(double *metric, unsigned corner = 0);
+
+  static double getLP(double *metric, unsigned corner = 0);
+
+  static double getEnergy(double *metric, unsigned corner = 0);
+
+  static double getDelay(double *metric, unsigned corner = 0);
+
+  /* the std and the custom metric file of each corner */
+  Vector<MetricsDB *> stdMetricsDBs;
+
+  Vector<MetricsDB *> customMetricsDBs;
+
+  MetricsDB *cachedMetricsDB;
+
+  /* one per corner, fitted from its std metric file on first use */
+  Vector<MetricModel> metricModels;
+
+  bool metricModelFitted;
+
+  void fitMetricModel();
+
+  /* the modeled metric of family<fan, guardBW, bw>, or nullptr */
+  double *getModelMetric(const char *family,
+                         unsigned fan,
+                         unsigned guardBW,
+                         unsigned bw);
+
+  static double *newMetric(const double *metric);
+
+  /* add to the metric of corner c of the instance the output latches of a
+   * pipelined control unit: numOut outputs of bw bits, one of which fires
+   * per token, and the pulse that opens them */
+  void addLatchMetric(const char *instance,
+                      unsigned bw,
+                      unsigned numOut,
+                      unsigned c,
+                      double &lp,
+                      double &energy,
+                      double &delay,
+                      double &area);
+
+  /* metric of a normalized instance, from this run or from the metric files */
+  double *findOpMetric(SymbolId normId);
+
+  double *findCachedMetric(SymbolId normId);
+
+  /* copy the cached netlist of fuKey to the output directory as
+   * normInstance; false if the entry has been evicted meanwhile */
+  bool copyCachedNetlist(const char *fuKey, const char *normInstance);
+
+  /* the fingerprint of each corner; the FU keys use the one of corner 0 */
+  Vector<uint64_t> cacheFingerprints;
+
+  uint64_t genCacheFingerprint(unsigned corner);
+
+  /* the cache entry of a corner: fuKey for corner 0, and fuKey_<corner>
+   * for the others */
+  static const char *getCornerKey(const char *fuKey, unsigned corner);
+
+  /* the cache directory of this machine */
+  LocalCacheBackend *localCache;
+
+  /* the cache shared with other machines, or nullptr */
+  CacheBackend *remoteCache;
+
+  /* the cache entries of fuKey for all corners, from the local or else the
+   * shared cache, or nullptr if one of them is missing */
+  double *readCacheEntry(const char *fuKey);
 
-  static double getLP(double metric[4]);
+  /* read the entry of one corner into metric; false if it is missing */
+  bool readCornerEntry(const char *fuKey, unsigned corner, double *metric);
 
-  static double getEnergy(double metric[4]);
+  bool parseCacheEntry(const char *cornerKey,
+                       const String &entry,
+                       unsigned corner,
+                       double *metric);
 
-  static double getDelay(double metric[4]);
+  void publishCacheEntry(const char *instance,
+                         const char *fuKey,
+                         double *metric);
 
-  void readMetricsFile(const char *metricsFP, bool forCache);
+  static String formatMetricLine(const char *instance, double *metric);
 };
 
 #endif //DFLOWMAP_METRICS_H
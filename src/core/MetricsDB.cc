@@ -0,0 +1,330 @@
+/*
+ * This file is part of the ACT library
+ *
+ * Copyright (c) 2021 Rui Li
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstdlib>
+#include "src/common/config.h"
+#include "MetricsDB.h"
+
+#define NO_SLOT 0xffffffffU
+
+MetricsDB::MetricsDB(const char *metricsFP, bool shared) {
+  this->metricsFP = metricsFP;
+  this->shared = shared;
+  dbFP = new char[strlen(metricsFP) + 4];
+  sprintf(dbFP, "%s.db", metricsFP);
+  loaded = false;
+  base = nullptr;
+  baseLen = 0;
+  mapped = false;
+  header = nullptr;
+  entries = nullptr;
+  slots = nullptr;
+  names = nullptr;
+}
+
+MetricsDB::~MetricsDB() {
+  if (mapped) {
+    munmap((void *) base, baseLen);
+  }
+  delete[] dbFP;
+}
+
+bool MetricsDB::exists() {
+  struct stat st;
+  return stat(metricsFP, &st) == 0;
+}
+
+uint64_t MetricsDB::hashName(const char *name, size_t len) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= (unsigned char) name[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+uint32_t MetricsDB::checksum(const char *line, size_t len) {
+  uint64_t hash = hashName(line, len);
+  return (uint32_t) (hash ^ (hash >> 32));
+}
+
+int MetricsDB::parseLine(const char *line,
+                         size_t len,
+                         String &instance,
+                         double metric[4]) {
+  String buff(line, len);
+  /* "<instance> <m0> <m1> <m2> <m3>", anything from "###" on is a comment */
+  const char *sum = nullptr;
+  size_t bodyLen = len;
+  size_t commentPos = buff.find("###");
+  if (commentPos != String::npos) {
+    bodyLen = commentPos;
+    sum = strstr(buff.c_str() + commentPos, "sum=");
+  }
+  while ((bodyLen > 0) && strchr(" \t\r", buff[bodyLen - 1])) bodyLen--;
+  if (sum && (strtoul(sum + 4, nullptr, 16) != checksum(line, bodyLen))) {
+    return -2;
+  }
+  buff.resize(bodyLen);
+  int metricCount = -1;
+  char *saveptr = nullptr;
+  for (char *tok = strtok_r(&buff[0], " \t\r", &saveptr); tok;
+       tok = strtok_r(nullptr, " \t\r", &saveptr)) {
+    if (metricCount < 0) {
+      instance = tok;
+    } else if (metricCount < 4) {
+      metric[metricCount] = std::strtod(tok, nullptr);
+    }
+    metricCount++;
+  }
+  return metricCount;
+}
+
+const double *MetricsDB::lookup(const char *instance) {
+  if (!loaded) {
+    load();
+  }
+  if (!header || !header->numEntries) {
+    return nullptr;
+  }
+  size_t len = strlen(instance);
+  uint64_t hash = hashName(instance, len);
+  uint32_t mask = header->numSlots - 1;
+  for (uint32_t idx = hash & mask;; idx = (idx + 1) & mask) {
+    uint32_t slot = slots[idx];
+    if (slot == NO_SLOT) {
+      return nullptr;
+    }
+    const DBEntry &entry = entries[slot];
+    if ((entry.hash == hash) && (entry.nameLen == len)
+        && !memcmp(names + entry.nameOffset, instance, len)) {
+      return entry.metric;
+    }
+  }
+}
+
+unsigned MetricsDB::size() {
+  if (!loaded) {
+    load();
+  }
+  return header ? header->numEntries : 0;
+}
+
+void MetricsDB::getEntry(unsigned idx,
+                         String &instance,
+                         const double *&metric) {
+  if (!loaded) {
+    load();
+  }
+  const DBEntry &entry = entries[idx];
+  instance.assign(names + entry.nameOffset, entry.nameLen);
+  metric = entry.metric;
+}
+
+void MetricsDB::load() {
+  loaded = true;
+  struct stat st;
+  if (stat(metricsFP, &st) != 0) {
+    if (debug_verbose) {
+      printf("Metric file %s does not exist\n", metricsFP);
+    }
+    return;
+  }
+  auto srcSize = (uint64_t) st.st_size;
+  int64_t srcMtimeNs = (int64_t) st.st_mtim.tv_sec * 1000000000LL
+      + st.st_mtim.tv_nsec;
+  if (mapImage(srcSize, srcMtimeNs)) {
+    if (debug_verbose) {
+      printf("Map metric database %s (%u entries)\n", dbFP,
+             header->numEntries);
+    }
+    return;
+  }
+  FILE *fp = fopen(metricsFP, "r");
+  if (!fp) {
+    printf("Could not read metric file %s!\n", metricsFP);
+    exit(-1);
+  }
+  if (shared) {
+    /* hold off writers, and stamp the image with what is actually read */
+    flock(fileno(fp), LOCK_SH);
+    if (fstat(fileno(fp), &st) == 0) {
+      srcSize = (uint64_t) st.st_size;
+      srcMtimeNs = (int64_t) st.st_mtim.tv_sec * 1000000000LL
+          + st.st_mtim.tv_nsec;
+    }
+  }
+  buildImage(fp, srcSize, srcMtimeNs);
+  fclose(fp);
+  saveImage();
+  useImage(image.data(), image.size());
+  if (debug_verbose) {
+    printf("Compile metric file %s into %s (%u entries)\n", metricsFP, dbFP,
+           header->numEntries);
+  }
+}
+
+bool MetricsDB::mapImage(uint64_t srcSize, int64_t srcMtimeNs) {
+  int fd = open(dbFP, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if ((fstat(fd, &st) != 0) || ((size_t) st.st_size < sizeof(DBHeader))) {
+    close(fd);
+    return false;
+  }
+  size_t len = st.st_size;
+  void *data = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  auto dbHeader = (const DBHeader *) data;
+  uint64_t namesOffset = sizeof(DBHeader)
+      + (uint64_t) dbHeader->numEntries * sizeof(DBEntry)
+      + (uint64_t) dbHeader->numSlots * sizeof(uint32_t);
+  if ((dbHeader->magic != METRICS_DB_MAGIC)
+      || (dbHeader->version != METRICS_DB_VERSION)
+      || (dbHeader->srcSize != srcSize)
+      || (dbHeader->srcMtimeNs != srcMtimeNs)
+      || (dbHeader->namesOffset != namesOffset)
+      || (namesOffset > len)) {
+    munmap(data, len);
+    return false;
+  }
+  mapped = true;
+  useImage((const char *) data, len);
+  return true;
+}
+
+void MetricsDB::useImage(const char *data, size_t len) {
+  base = data;
+  baseLen = len;
+  header = (const DBHeader *) base;
+  entries = (const DBEntry *) (base + sizeof(DBHeader));
+  slots = (const uint32_t *) (base + sizeof(DBHeader)
+      + header->numEntries * sizeof(DBEntry));
+  names = base + header->namesOffset;
+}
+
+void MetricsDB::buildImage(FILE *fp, uint64_t srcSize, int64_t srcMtimeNs) {
+  String text;
+  text.resize(srcSize);
+  size_t len = fread(&text[0], 1, srcSize, fp);
+  text.resize(len);
+  Vector<DBEntry> dbEntries;
+  String dbNames;
+  std::unordered_map<String, unsigned> entryIdx;
+  const char *cur = text.c_str();
+  const char *end = cur + text.size();
+  while (cur < end) {
+    const char *lineEnd = (const char *) memchr(cur, '\n', end - cur);
+    if (!lineEnd) lineEnd = end;
+    const char *line = cur;
+    cur = lineEnd + 1;
+    String instance;
+    double metric[4];
+    int metricCount = parseLine(line, lineEnd - line, instance, metric);
+    if (metricCount == -1) continue;
+    if (metricCount != 4) {
+      if (shared) {
+        if (debug_verbose) {
+          printf("Skip a broken line in %s\n", metricsFP);
+        }
+        continue;
+      }
+      printf("%s has %d metrics!\n", metricsFP, metricCount);
+      exit(-1);
+    }
+    auto entryIdxIt = entryIdx.find(instance);
+    if (entryIdxIt != entryIdx.end()) {
+      if (memcmp(dbEntries[entryIdxIt->second].metric, metric,
+                 sizeof(metric)) != 0) {
+        printf("We find different metric record for %s in %s\n",
+               instance.c_str(), metricsFP);
+        exit(-1);
+      }
+      continue;
+    }
+    DBEntry entry;
+    entry.hash = hashName(instance.c_str(), instance.size());
+    entry.nameOffset = dbNames.size();
+    entry.nameLen = instance.size();
+    memcpy(entry.metric, metric, sizeof(metric));
+    entryIdx.insert({instance, dbEntries.size()});
+    dbEntries.push_back(entry);
+    dbNames.append(instance);
+    dbNames.push_back('\0');
+  }
+  /* at most half of the slots are used, so probing stays short */
+  uint32_t numSlots = 16;
+  while (numSlots < 2 * dbEntries.size()) numSlots <<= 1;
+  Vector<uint32_t> dbSlots(numSlots, NO_SLOT);
+  uint32_t mask = numSlots - 1;
+  for (uint32_t i = 0; i < dbEntries.size(); i++) {
+    uint32_t idx = dbEntries[i].hash & mask;
+    while (dbSlots[idx] != NO_SLOT) idx = (idx + 1) & mask;
+    dbSlots[idx] = i;
+  }
+  DBHeader dbHeader;
+  memset(&dbHeader, 0, sizeof(dbHeader));
+  dbHeader.magic = METRICS_DB_MAGIC;
+  dbHeader.version = METRICS_DB_VERSION;
+  dbHeader.numEntries = dbEntries.size();
+  dbHeader.srcSize = srcSize;
+  dbHeader.srcMtimeNs = srcMtimeNs;
+  dbHeader.numSlots = numSlots;
+  dbHeader.namesOffset = sizeof(DBHeader) + dbEntries.size() * sizeof(DBEntry)
+      + numSlots * sizeof(uint32_t);
+  image.clear();
+  image.reserve(dbHeader.namesOffset + dbNames.size());
+  image.append((const char *) &dbHeader, sizeof(dbHeader));
+  image.append((const char *) dbEntries.data(),
+               dbEntries.size() * sizeof(DBEntry));
+  image.append((const char *) dbSlots.data(), numSlots * sizeof(uint32_t));
+  image.append(dbNames);
+}
+
+void MetricsDB::saveImage() {
+  /* write a private copy and rename it, so that a reader never maps a
+   * partially written image; failing to save only costs a rebuild next time */
+  char *tmpFP = new char[strlen(dbFP) + 32];
+  sprintf(tmpFP, "%s.tmp%d", dbFP, (int) getpid());
+  FILE *fp = fopen(tmpFP, "w");
+  bool saved = false;
+  if (fp) {
+    saved = (fwrite(image.data(), 1, image.size(), fp) == image.size());
+    saved = (fclose(fp) == 0) && saved;
+    saved = saved && (rename(tmpFP, dbFP) == 0);
+    if (!saved) unlink(tmpFP);
+  }
+  if (!saved && debug_verbose) {
+    printf("Could not save metric database %s\n", dbFP);
+  }
+  delete[] tmpFP;
+}
@@ -0,0 +1,131 @@
+/*
+ * This file is part of the ACT library
+ *
+ * Copyright (c) 2021 Rui Li
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef DFLOWMAP_SRC_CORE_METRICSDB_H_
+#define DFLOWMAP_SRC_CORE_METRICSDB_H_
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include "src/common/common.h"
+
+#define METRICS_DB_MAGIC 0x31424d4d57464444ULL
+#define METRICS_DB_VERSION 1
+
+/* Read-only, compiled form of a text metrics file ("<instance> <leak power>
+ * <dyn energy> <delay> <area>" per line). The compiled image is kept in
+ * "<metrics file>.db" and memory-mapped; it holds an open-addressing hash
+ * index over the instance names, so a lookup touches a few cache lines
+ * instead of parsing the text file. The image is rebuilt whenever the size
+ * or the modification time of the text file changes.
+ *
+ * A shared file (the FU cache) is appended to by concurrent runs, so it is
+ * read under a shared advisory lock, and lines that are torn or fail their
+ * "### sum=<checksum>" are skipped instead of rejected. */
+class MetricsDB {
+ public:
+  explicit MetricsDB(const char *metricsFP, bool shared = false);
+
+  ~MetricsDB();
+
+  /* false if the text metrics file does not exist */
+  bool exists();
+
+  /* the metric of "instance", or nullptr; loads the database on first use */
+  const double *lookup(const char *instance);
+
+  unsigned size();
+
+  /* the idx-th entry, for idx < size() */
+  void getEntry(unsigned idx, String &instance, const double *&metric);
+
+  /* FNV-1a, which is stable across runs and machines */
+  static uint64_t hashName(const char *name, size_t len);
+
+  /* checksum of the "<instance> <m0> <m1> <m2> <m3>" part of a line */
+  static uint32_t checksum(const char *line, size_t len);
+
+  /* parse one line into instance and metric; returns the # of metrics, -1 for
+   * a blank line, or -2 if the line does not match its checksum */
+  static int parseLine(const char *line,
+                       size_t len,
+                       String &instance,
+                       double metric[4]);
+
+ private:
+  typedef struct dbHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t numEntries;
+    /* stamp of the text file the image was compiled from */
+    uint64_t srcSize;
+    int64_t srcMtimeNs;
+    /* # of hash slots, a power of 2 */
+    uint32_t numSlots;
+    uint32_t padding;
+    uint64_t namesOffset;
+  } DBHeader;
+
+  typedef struct dbEntry {
+    uint64_t hash;
+    uint32_t nameOffset;
+    uint32_t nameLen;
+    double metric[4];
+  } DBEntry;
+
+  const char *metricsFP;
+
+  char *dbFP;
+
+  bool shared;
+
+  bool loaded;
+
+  /* the image, either mapped from dbFP or built in memory */
+  const char *base;
+
+  size_t baseLen;
+
+  bool mapped;
+
+  String image;
+
+  const DBHeader *header;
+
+  const DBEntry *entries;
+
+  const uint32_t *slots;
+
+  const char *names;
+
+  void load();
+
+  bool mapImage(uint64_t srcSize, int64_t srcMtimeNs);
+
+  void buildImage(FILE *fp, uint64_t srcSize, int64_t srcMtimeNs);
+
+  void saveImage();
+
+  void useImage(const char *data, size_t len);
+};
+
+#endif //DFLOWMAP_SRC_CORE_METRICSDB_H_
@@ -24,78 +24,80 @@
 const char *NameGenerator::genMergeInstName(unsigned guardBW,
                                             unsigned inBW,
                                             int numInputs,
+                                            bool pipelined,
                                             char *&procName) {
-  if (PIPELINE) {
+  if (pipelined) {
     sprintf(procName, "pipe_%s", Constant::MERGE_PREFIX);
   } else {
     sprintf(procName, "unpipe_%s", Constant::MERGE_PREFIX);
   }
-  char *instance = new char[MAX_INSTANCE_LEN];
+  char instance[SHORT_STRING_LEN];
   sprintf(instance, "%s<%d,%u,%u>", procName, numInputs, guardBW, inBW);
-  return instance;
+  return SymbolTable::getName(SymbolTable::intern(instance));
 }
 
 const char *NameGenerator::genMixerInstName(unsigned ctrlBW,
                                             unsigned inBW,
                                             int numInputs,
+                                            bool pipelined,
                                             char *&procName) {
-  if (PIPELINE) {
+  if (pipelined) {
     sprintf(procName, "pipe_%s", Constant::MIXER_PREFIX);
   } else {
     sprintf(procName, "unpipe_%s", Constant::MIXER_PREFIX);
   }
-  char *instance = new char[MAX_INSTANCE_LEN];
+  char instance[SHORT_STRING_LEN];
   sprintf(instance, "%s<%d,%u,%u>", procName, numInputs, inBW, ctrlBW);
-  return instance;
+  return SymbolTable::getName(SymbolTable::intern(instance));
 }
 
 const char *NameGenerator::genArbiterInstName(unsigned ctrlBW,
                                               unsigned inBW,
                                               int numInputs,
+                                              bool pipelined,
                                               char *&procName) {
-  if (PIPELINE) {
+  if (pipelined) {
     sprintf(procName, "pipe_%s", Constant::ARBITER_PREFIX);
   } else {
     sprintf(procName, "unpipe_%s", Constant::ARBITER_PREFIX);
   }
-  char *instance = new char[MAX_INSTANCE_LEN];
+  char instance[SHORT_STRING_LEN];
   sprintf(instance, "%s<%d,%u,%u>", procName, numInputs, inBW, ctrlBW);
-  return instance;
+  return SymbolTable::getName(SymbolTable::intern(instance));
 }
 
 const char *NameGenerator::genSplitInstName(unsigned guardBW,
                                             unsigned outBW,
                                             int numOut,
+                                            bool pipelined,
                                             char *&procName) {
-  if (PIPELINE) {
+  if (pipelined) {
     sprintf(procName, "pipe_%s", Constant::SPLIT_PREFIX);
   } else {
     sprintf(procName, "unpipe_%s", Constant::SPLIT_PREFIX);
   }
-  char *instance = new char[MAX_INSTANCE_LEN];
+  char instance[SHORT_STRING_LEN];
   sprintf(instance, "%s<%d,%u,%u>", procName, numOut, guardBW, outBW);
-  return instance;
+  return SymbolTable::getName(SymbolTable::intern(instance));
 }
 
 const char *NameGenerator::genCopyInstName(unsigned bw, unsigned numOut) {
-  char *procName = new char[1024];
-  sprintf(procName, "copy");
-  char *instance = new char[1024];
-  sprintf(instance, "%s<%u,%u>", procName, bw, numOut);
-  return instance;
+  char instance[SHORT_STRING_LEN];
+  sprintf(instance, "copy<%u,%u>", bw, numOut);
+  return SymbolTable::getName(SymbolTable::intern(instance));
 }
 
 const char *NameGenerator::genSinkInstName(unsigned bw) {
-  char *instance = new char[1500];
+  char instance[SHORT_STRING_LEN];
   sprintf(instance, "sink<%u>", bw);
-  return instance;
+  return SymbolTable::getName(SymbolTable::intern(instance));
 }
 
 const char *NameGenerator::genSourceInstName(unsigned long val,
                                              unsigned bitwidth) {
-  char *instance = new char[1500];
+  char instance[SHORT_STRING_LEN];
   sprintf(instance, "source<%lu,%u>", val, bitwidth);
-  return instance;
+  return SymbolTable::getName(SymbolTable::intern(instance));
 }
 
 const char *NameGenerator::genExprName(Expr *expr) {
@@ -104,25 +106,14 @@ const char *NameGenerator::genExprName(Expr *expr) {
   return act_expr_to_string(arg_list, expr);
 }
 
-const char *NameGenerator::genExprClusterName(list_t *dflow_cluster) {
-  Vector<Expr *> exprList;
-  for (listitem_t *li = list_first (dflow_cluster); li; li = list_next (li)) {
-    auto *d = (act_dataflow_element *) list_value (li);
-    if (d->t != ACT_DFLOW_FUNC) {
-      dflow_print(stdout, d);
-      printf("\nThis dflow statement should not appear in dflow-cluster!\n");
-      exit(-1);
-    }
-    Expr *expr = d->u.func.lhs;
-    exprList.push_back(expr);
-  }
+const char *NameGenerator::genExprClusterName(Vector<Expr *> &exprList) {
   list_t *argList = list_new();
   for (auto &e: exprList) {
     act_expr_collect_ids(argList, e);
   }
-  char *name = new char[MAX_CLUSTER_PROC_NAME_LEN];
+  char *name = newScratchChars(MAX_CLUSTER_PROC_NAME_LEN);
   name[0] = '\0';
-  char *delimiter = new char[2];
+  char *delimiter = newScratchChars(2);
   sprintf(delimiter, "_");
   for (auto &e: exprList) {
     if (name[0] != '\0') strcat(name, delimiter);
@@ -135,17 +126,18 @@ const char *NameGenerator::genFUName(const char *procName,
                                      StringVec &argList,
                                      UIntVec &outBWList,
                                      UIntVec &argBWList) {
-  char *instance = new char[MAX_INSTANCE_LEN];
-  sprintf(instance, "%s<", procName);
   unsigned numArgs = argList.size();
   unsigned numOuts = outBWList.size();
+  char *instance =
+      newScratchChars(strlen(procName) + 12 * (numArgs + numOuts) + 2);
+  sprintf(instance, "%s<", procName);
   for (unsigned i = 0; i < numArgs; i++) {
-    char *subInstance = new char[100];
+    char subInstance[16];
     sprintf(subInstance, "%u,", argBWList[i]);
     strcat(instance, subInstance);
   }
   for (unsigned i = 0; i < numOuts; i++) {
-    char *subInstance = new char[100];
+    char subInstance[16];
     if (i == (numOuts - 1)) {
       sprintf(subInstance, "%u>", outBWList[i]);
     } else {
@@ -153,5 +145,109 @@ const char *NameGenerator::genFUName(const char *procName,
     }
     strcat(instance, subInstance);
   }
-  return instance;
-}
\ No newline at end of file
+  return SymbolTable::getName(SymbolTable::intern(instance));
+}
+static uint64_t hashMix(uint64_t hash, uint64_t val) {
+  /* splitmix64 finalizer of the combined value */
+  uint64_t x = hash ^ (val + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2));
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+static uint64_t hashStr(uint64_t hash, const char *str) {
+  for (; *str; str++) {
+    hash = hashMix(hash, (unsigned char) *str);
+  }
+  return hash;
+}
+
+uint64_t NameGenerator::hashFUExpr(Expr *expr,
+                                   StringMap<unsigned> &inBW,
+                                   StringMap<unsigned> &hiddenBW,
+                                   Map<Expr *, Expr *> &hiddenExprs,
+                                   Map<Expr *, uint64_t> &exprHashes) {
+  if (!expr) {
+    return hashMix(0, 0x6e756c6c);
+  }
+  auto exprHashesIt = exprHashes.find(expr);
+  if (exprHashesIt != exprHashes.end()) {
+    return exprHashesIt->second;
+  }
+  uint64_t hash = hashMix(1, expr->type);
+  switch (expr->type) {
+    case E_INT: {
+      hash = hashMix(hash, expr->u.v);
+      break;
+    }
+    case E_VAR: {
+      char name[SHORT_STRING_LEN];
+      ((ActId *) expr->u.e.l)->sPrint(name, SHORT_STRING_LEN);
+      auto hiddenExprsIt = hiddenExprs.find(expr);
+      if (hiddenExprsIt != hiddenExprs.end()) {
+        /* an intermediate result: hash what computes it, not its name */
+        auto hiddenBWIt = hiddenBW.find(name);
+        hash = hashMix(hash, (hiddenBWIt != hiddenBW.end())
+                             ? hiddenBWIt->second : 0);
+        hash = hashMix(hash, hashFUExpr(hiddenExprsIt->second, inBW,
+                                        hiddenBW, hiddenExprs, exprHashes));
+      } else {
+        /* an input port "x<i>"; ports are numbered by first use, so the
+         * channel names do not matter */
+        auto inBWIt = inBW.find(name);
+        hash = hashStr(hash, name);
+        hash = hashMix(hash, (inBWIt != inBW.end()) ? inBWIt->second : 0);
+      }
+      break;
+    }
+    default: {
+      uint64_t lHash =
+          hashFUExpr(expr->u.e.l, inBW, hiddenBW, hiddenExprs, exprHashes);
+      uint64_t rHash = 0;
+      if ((expr->type != E_NOT) && (expr->type != E_UMINUS)
+          && (expr->type != E_COMPLEMENT)) {
+        rHash =
+            hashFUExpr(expr->u.e.r, inBW, hiddenBW, hiddenExprs, exprHashes);
+      }
+      bool commutative = (expr->type == E_AND) || (expr->type == E_OR)
+          || (expr->type == E_XOR) || (expr->type == E_PLUS)
+          || (expr->type == E_MULT) || (expr->type == E_EQ)
+          || (expr->type == E_NE);
+      if (commutative && (lHash > rHash)) {
+        std::swap(lHash, rHash);
+      }
+      hash = hashMix(hashMix(hash, lHash), rHash);
+      break;
+    }
+  }
+  exprHashes.insert({expr, hash});
+  return hash;
+}
+
+const char *NameGenerator::genFUKey(uint64_t envHash,
+                                    StringMap<unsigned> &inBW,
+                                    StringMap<unsigned> &hiddenBW,
+                                    Map<const char *, Expr *> &exprMap,
+                                    Map<Expr *, Expr *> &hiddenExprs,
+                                    Map<unsigned int, unsigned int> &outRecord,
+                                    UIntVec &outBWList) {
+  Map<Expr *, uint64_t> exprHashes;
+  unsigned numOuts = outBWList.size();
+  uint64_t hash = hashMix(envHash, numOuts);
+  for (unsigned i = 0; i < numOuts; i++) {
+    auto outRecordIt = outRecord.find(i);
+    if (outRecordIt == outRecord.end()) {
+      printf("We could not find the result of output %u!\n", i);
+      exit(-1);
+    }
+    char resName[32];
+    sprintf(resName, "res%u", outRecordIt->second);
+    Expr *res = getExprFromName(resName, exprMap, true, -1);
+    hash = hashMix(hash,
+                   hashFUExpr(res, inBW, hiddenBW, hiddenExprs, exprHashes));
+    hash = hashMix(hash, outBWList[i]);
+  }
+  char key[32];
+  sprintf(key, "fu_%016llx", (unsigned long long) hash);
+  return SymbolTable::getName(SymbolTable::intern(key));
+}
@@ -26,6 +26,9 @@
 #include <act/lang.h>
 #include <cstring>
 #include "src/common/common.h"
+#include "src/common/Arena.h"
+#include "src/common/SymbolTable.h"
+#include "src/common/Helper.h"
 #include "src/common/Constant.h"
 #include "src/common/config.h"
 
@@ -34,21 +37,25 @@ class NameGenerator {
   static const char *genMergeInstName(unsigned guardBW,
                                       unsigned inBW,
                                       int numInputs,
+                                      bool pipelined,
                                       char *&procName);
 
   static const char *genMixerInstName(unsigned ctrlBW,
                                       unsigned inBW,
                                       int numInputs,
+                                      bool pipelined,
                                       char *&procName);
 
   static const char *genArbiterInstName(unsigned ctrlBW,
                                         unsigned inBW,
                                         int numInputs,
+                                        bool pipelined,
                                         char *&procName);
 
   static const char *genSplitInstName(unsigned guardBW,
                                       unsigned outBW,
                                       int numOut,
+                                      bool pipelined,
                                       char *&procName);
 
   static const char *genCopyInstName(unsigned bw, unsigned numOut);
@@ -59,12 +66,31 @@ class NameGenerator {
 
   static const char *genExprName(Expr *expr);
 
-  static const char *genExprClusterName(list_t *dflow_cluster);
+  static const char *genExprClusterName(Vector<Expr *> &exprList);
 
   static const char *genFUName(const char *procName,
                                StringVec &argList,
                                UIntVec &outBWList,
                                UIntVec &argBWList);
+
+  /* content address of an FU: a structural hash of its expression DAG
+   * (operators, constants, input/hidden/output bitwidths); channel names
+   * and the order of commutative operands do not change it; envHash is
+   * mixed in to tie the key to the environment it is valid for */
+  static const char *genFUKey(uint64_t envHash,
+                              StringMap<unsigned> &inBW,
+                              StringMap<unsigned> &hiddenBW,
+                              Map<const char *, Expr *> &exprMap,
+                              Map<Expr *, Expr *> &hiddenExprs,
+                              Map<unsigned int, unsigned int> &outRecord,
+                              UIntVec &outBWList);
+
+ private:
+  static uint64_t hashFUExpr(Expr *expr,
+                             StringMap<unsigned> &inBW,
+                             StringMap<unsigned> &hiddenBW,
+                             Map<Expr *, Expr *> &hiddenExprs,
+                             Map<Expr *, uint64_t> &exprHashes);
 };
 
 #endif //DFLOWMAP_SRC_CORE_NAMEGENERATOR_H_
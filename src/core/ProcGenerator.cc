@@ -22,10 +22,8 @@
 #include "ProcGenerator.h"
 
 const char *ProcGenerator::getActIdOrCopyName(ActId *actId) {
-  char *str = new char[10240];
   if (actId) {
-    char *actName = new char[10240];
-    getActIdName(sc, actId, actName, 10240);
+    const char *actName = getActIdName(sc, actId);
     unsigned outUses = getOpUses(actId);
     if (debug_verbose) {
       printf("actIdCopyUse (%s, %u)\n", actName, outUses);
@@ -37,18 +35,17 @@ const char *ProcGenerator::getActIdOrCopyName(ActId *actId) {
       }
       if (copyUse <= outUses) {
         const char *normalizedName = getNormActIdName(actName);
+        char *str = newScratchChars(strlen(normalizedName) + 24);
         sprintf(str, "%scopy.out[%u]", normalizedName, copyUse);
+        return str;
       } else {
         printf("We use %s more than total uses!\n", actName);
         exit(-1);
       }
-    } else {
-      sprintf(str, "%s", actName);
     }
-  } else {
-    sprintf(str, "*");
+    return actName;
   }
-  return str;
+  return "*";
 }
 
 void ProcGenerator::collectBitwidthInfo() {
@@ -78,8 +75,7 @@ void ProcGenerator::collectBitwidthInfo() {
 void ProcGenerator::printBitwidthInfo() {
   printf("bitwidth info:\n");
   for (auto &bitwidthMapIt: bitwidthMap) {
-    char *connectName = new char[10240];
-    getActConnectionName(bitwidthMapIt.first, connectName, 10240);
+    const char *connectName = getActConnectionName(bitwidthMapIt.first);
     printf("(%s, %u) ", connectName, bitwidthMapIt.second);
   }
   printf("\n");
@@ -101,8 +97,7 @@ unsigned ProcGenerator::getBitwidth(act_connection *actConnection) {
   if (bitwidthMapIt != bitwidthMap.end()) {
     return bitwidthMapIt->second;
   }
-  char *varName = new char[10240];
-  getActConnectionName(actConnection, varName, 10240);
+  const char *varName = getActConnectionName(actConnection);
   printf("We could not find bitwidth info for %s\n", varName);
   printBitwidthInfo();
   exit(-1);
@@ -133,11 +128,11 @@ const char *ProcGenerator::EMIT_QUERY(DflowGenerator *dflowGenerator,
                                      rExpr,
                                      resSuffix,
                                      resBW);
-  char *cVal = new char[100];
+  char *cVal = newScratchChars(100);
   getCurProc(cexpr_name, cVal);
-  char *lVal = new char[100];
+  char *lVal = newScratchChars(100);
   getCurProc(lexpr_name, lVal);
-  char *rVal = new char[100];
+  char *rVal = newScratchChars(100);
   getCurProc(rexpr_name, rVal);
   if (!strcmp(lexpr_name, rexpr_name)) {
     printf("This query expr has the same true/false branch!\n");
@@ -145,7 +140,7 @@ const char *ProcGenerator::EMIT_QUERY(DflowGenerator *dflowGenerator,
     printf("!\n");
     exit(-1);
   }
-  char *finalExprName = new char[100];
+  char *finalExprName = newScratchChars(100);
   resSuffix++;
   sprintf(finalExprName, "res%d", resSuffix);
   dflowGenerator->printChpQueryExpr(cexpr_name,
@@ -193,11 +188,11 @@ const char *ProcGenerator::EMIT_BIN(DflowGenerator *dflowGenerator,
                                      rExpr,
                                      resSuffix,
                                      resBW);
-  char *lVal = new char[100];
+  char *lVal = newScratchChars(100);
   getCurProc(lexpr_name, lVal);
-  char *rVal = new char[100];
+  char *rVal = newScratchChars(100);
   getCurProc(rexpr_name, rVal);
-  char *finalExprName = new char[100];
+  char *finalExprName = newScratchChars(100);
   resSuffix++;
   sprintf(finalExprName, "res%d", resSuffix);
   dflowGenerator->printChpBinExpr(op,
@@ -234,9 +229,9 @@ const char *ProcGenerator::EMIT_UNI(DflowGenerator *dflowGenerator,
                                      lExpr,
                                      resSuffix,
                                      resBW);
-  char *val = new char[100];
+  char *val = newScratchChars(100);
   getCurProc(lexpr_name, val);
-  char *finalExprName = new char[100];
+  char *finalExprName = newScratchChars(100);
   resSuffix++;
   sprintf(finalExprName, "res%d", resSuffix);
   dflowGenerator->printChpUniExpr(op, lexpr_name, resSuffix, resBW);
@@ -256,7 +251,7 @@ const char *ProcGenerator::EMIT_CONCAT(DflowGenerator *dflowGenerator,
                                        unsigned &resBW) {
   StringVec operandList;
   IntVec opTypeList;
-  char *finalExprName = new char[100];
+  char *finalExprName = newScratchChars(100);
   resSuffix++;
   sprintf(finalExprName, "res%d", resSuffix);
   while (expr) {
@@ -284,15 +279,14 @@ const char *ProcGenerator::printExpr(DflowGenerator *dflowGenerator,
   switch (type) {
     case E_INT: {
       unsigned long val = expr->u.v;
-      const char *valStr = strdup(std::to_string(val).c_str());
+      const char *valStr = newScratchStr(std::to_string(val).c_str());
       return valStr;
     }
     case E_VAR: {
       auto actId = (ActId *) expr->u.e.l;
       act_connection *actConnection = actId->Canonical(sc);
       unsigned argBW = getBitwidth(actConnection);
-      char *oriVarName = new char[10240];
-      getActIdName(sc, actId, oriVarName, 10240);
+      const char *oriVarName = getActIdName(sc, actId);
       const char *mappedVarName = nullptr;
       if (dflowGenerator->isNewArg(oriVarName)) {
         mappedVarName = getActIdOrCopyName(actId);
@@ -406,12 +400,228 @@ const char *ProcGenerator::printExpr(DflowGenerator *dflowGenerator,
   exit(-1);
 }
 
+static bool isCommutative(int type) {
+  return (type == E_AND) || (type == E_OR) || (type == E_XOR)
+      || (type == E_PLUS) || (type == E_MULT) || (type == E_EQ)
+      || (type == E_NE);
+}
+
+static bool isAssociative(int type) {
+  return (type == E_AND) || (type == E_OR) || (type == E_XOR)
+      || (type == E_PLUS) || (type == E_MULT);
+}
+
+static bool isBinary(int type) {
+  switch (type) {
+    case E_AND:
+    case E_OR:
+    case E_PLUS:
+    case E_MINUS:
+    case E_MULT:
+    case E_DIV:
+    case E_MOD:
+    case E_LSL:
+    case E_LSR:
+    case E_ASR:
+    case E_XOR:
+    case E_LT:
+    case E_GT:
+    case E_LE:
+    case E_GE:
+    case E_EQ:
+    case E_NE:return true;
+    default:return false;
+  }
+}
+
+/* "a < b" is "b > a", etc.; -1 if the operands cannot be swapped this way */
+static int getMirroredType(int type) {
+  switch (type) {
+    case E_LT:return E_GT;
+    case E_GT:return E_LT;
+    case E_LE:return E_GE;
+    case E_GE:return E_LE;
+    default:return -1;
+  }
+}
+
+/* whether expr contains a bool(); printExpr sets the bitwidth of the
+ * operands printed after a bool() to 1, so their order matters */
+static bool hasBoolCast(Expr *expr) {
+  if (!expr) {
+    return false;
+  }
+  int type = expr->type;
+  switch (type) {
+    case E_BUILTIN_BOOL:return true;
+    case E_NOT:
+    case E_UMINUS:
+    case E_COMPLEMENT:
+    case E_BUILTIN_INT:return hasBoolCast(expr->u.e.l);
+    case E_QUERY:
+      return hasBoolCast(expr->u.e.l) || hasBoolCast(expr->u.e.r->u.e.l)
+          || hasBoolCast(expr->u.e.r->u.e.r);
+    case E_CONCAT:return hasBoolCast(expr->u.e.l) || hasBoolCast(expr->u.e.r);
+    default:
+      return isBinary(type)
+          && (hasBoolCast(expr->u.e.l) || hasBoolCast(expr->u.e.r));
+  }
+}
+
+Expr *ProcGenerator::getCanonicalExpr(Expr *expr) {
+  auto canonicalExprsIt = canonicalExprs.find(expr);
+  if (canonicalExprsIt != canonicalExprs.end()) {
+    return canonicalExprsIt->second;
+  }
+  Expr *canonical = canonicalizeExpr(expr);
+  canonicalExprs.insert({expr, canonical});
+  if (debug_verbose) {
+    printf("canonical form of ");
+    print_expr(stdout, expr);
+    printf(" is ");
+    print_expr(stdout, canonical);
+    printf("\n");
+  }
+  return canonical;
+}
+
+const String &ProcGenerator::getExprSignature(Expr *expr) {
+  auto exprSignaturesIt = exprSignatures.find(expr);
+  if (exprSignaturesIt != exprSignatures.end()) {
+    return exprSignaturesIt->second;
+  }
+  /* variables only count by their bitwidth, so that equivalent FUs over
+   * different channels sort their operands the same way */
+  String signature;
+  int type = expr->type;
+  if (type == E_VAR) {
+    auto actId = (ActId *) expr->u.e.l;
+    signature = "v" + std::to_string(getBitwidth(actId->Canonical(sc)));
+  } else if (type == E_INT) {
+    signature = "i" + std::to_string(expr->u.v);
+  } else {
+    signature = "(" + std::to_string(type);
+    if (type == E_BUILTIN_INT) {
+      signature += " " + getExprSignature(expr->u.e.l);
+      if (expr->u.e.r) {
+        signature += " w" + std::to_string(expr->u.e.r->u.v);
+      }
+    } else if (type == E_QUERY) {
+      signature += " " + getExprSignature(expr->u.e.l);
+      signature += " " + getExprSignature(expr->u.e.r->u.e.l);
+      signature += " " + getExprSignature(expr->u.e.r->u.e.r);
+    } else {
+      if (expr->u.e.l) {
+        signature += " " + getExprSignature(expr->u.e.l);
+      }
+      if ((isBinary(type) || (type == E_CONCAT)) && expr->u.e.r) {
+        signature += " " + getExprSignature(expr->u.e.r);
+      }
+    }
+    signature += ")";
+  }
+  return exprSignatures.insert({expr, signature}).first->second;
+}
+
+void ProcGenerator::collectChainOperands(Expr *expr,
+                                         int type,
+                                         Vector<Expr *> &operands) {
+  if (expr->type == type) {
+    collectChainOperands(expr->u.e.l, type, operands);
+    collectChainOperands(expr->u.e.r, type, operands);
+  } else {
+    operands.push_back(canonicalizeExpr(expr));
+  }
+}
+
+Expr *ProcGenerator::canonicalizeExpr(Expr *expr) {
+  int type = expr->type;
+  switch (type) {
+    case E_NOT:
+    case E_UMINUS:
+    case E_COMPLEMENT:
+    case E_BUILTIN_INT:
+    case E_BUILTIN_BOOL: {
+      Expr *result = newScratch<Expr>();
+      *result = *expr;
+      result->u.e.l = canonicalizeExpr(expr->u.e.l);
+      return result;
+    }
+    case E_QUERY: {
+      Expr *branches = newScratch<Expr>();
+      *branches = *expr->u.e.r;
+      branches->u.e.l = canonicalizeExpr(expr->u.e.r->u.e.l);
+      branches->u.e.r = canonicalizeExpr(expr->u.e.r->u.e.r);
+      Expr *result = newScratch<Expr>();
+      *result = *expr;
+      result->u.e.l = canonicalizeExpr(expr->u.e.l);
+      result->u.e.r = branches;
+      return result;
+    }
+    case E_CONCAT: {
+      Expr *result = newScratch<Expr>();
+      *result = *expr;
+      result->u.e.l = canonicalizeExpr(expr->u.e.l);
+      if (expr->u.e.r) {
+        result->u.e.r = canonicalizeExpr(expr->u.e.r);
+      }
+      return result;
+    }
+    default: {
+      if (!isBinary(type)) {
+        return expr;
+      }
+      break;
+    }
+  }
+  if (hasBoolCast(expr)) {
+    /* keep the order of the operands; see hasBoolCast */
+    Expr *result = newScratch<Expr>();
+    *result = *expr;
+    result->u.e.l = canonicalizeExpr(expr->u.e.l);
+    result->u.e.r = canonicalizeExpr(expr->u.e.r);
+    return result;
+  }
+  auto bySignature = [&](Expr *l, Expr *r) {
+    return getExprSignature(l) < getExprSignature(r);
+  };
+  if (isAssociative(type)) {
+    /* flatten the chain of this operator, sort its operands, and rebuild it
+     * left-deep; every intermediate result has the same bitwidth, so this
+     * computes the same value */
+    Vector<Expr *> operands;
+    collectChainOperands(expr, type, operands);
+    std::stable_sort(operands.begin(), operands.end(), bySignature);
+    Expr *chain = operands[0];
+    for (unsigned i = 1; i < operands.size(); i++) {
+      Expr *node = newScratch<Expr>();
+      *node = *expr;
+      node->u.e.l = chain;
+      node->u.e.r = operands[i];
+      chain = node;
+    }
+    return chain;
+  }
+  Expr *result = newScratch<Expr>();
+  *result = *expr;
+  result->u.e.l = canonicalizeExpr(expr->u.e.l);
+  result->u.e.r = canonicalizeExpr(expr->u.e.r);
+  int mirroredType = getMirroredType(type);
+  if ((isCommutative(type) || (mirroredType >= 0))
+      && bySignature(result->u.e.r, result->u.e.l)) {
+    std::swap(result->u.e.l, result->u.e.r);
+    if (mirroredType >= 0) {
+      result->type = mirroredType;
+    }
+  }
+  return result;
+}
+
 unsigned ProcGenerator::getCopyUses(ActId *actId) {
   act_connection *actConnection = actId->Canonical(sc);
   auto copyUsesIt = copyUses.find(actConnection);
   if (copyUsesIt == copyUses.end()) {
-    char buf[10240];
-    getActConnectionName(actConnection, buf, 10240);
+    const char *buf = getActConnectionName(actConnection);
     printf("We don't know how many times %s is used as COPY!\n", buf);
     exit(-1);
   }
@@ -447,8 +657,7 @@ void ProcGenerator::recordOpUses(ActId *actId,
 void ProcGenerator::printOpUses() {
   printf("OP USES:\n");
   for (auto &opUsesIt: opUses) {
-    char *opName = new char[10240];
-    getActConnectionName(opUsesIt.first, opName, 10240);
+    const char *opName = getActConnectionName(opUsesIt.first);
     printf("(%s, %u) ", opName, opUsesIt.second);
   }
   printf("\n");
@@ -465,8 +674,7 @@ unsigned ProcGenerator::getOpUses(ActId *actId) {
   if (opUsesIt != opUses.end()) {
     return opUsesIt->second;
   }
-  char *buf = new char[10240];
-  getActConnectionName(actConnection, buf, 10240);
+  const char *buf = getActConnectionName(actConnection);
   printf("We don't know how many times %s is used!\n", buf);
   printOpUses();
   exit(-1);
@@ -532,8 +740,7 @@ void ProcGenerator::collectExprUses(Expr *expr, StringVec &recordedOps) {
     }
     case E_VAR: {
       auto actId = (ActId *) expr->u.e.l;
-      char *varName = new char[10240];
-      getActIdName(sc, actId, varName, 10240);
+      const char *varName = getActIdName(sc, actId);
       if (searchStringVec(recordedOps, varName) == -1) {
         updateOpUses(actId);
         recordedOps.push_back(varName);
@@ -784,11 +991,13 @@ void ProcGenerator::createCopyProcs() {
       unsigned numOut = uses + 1;
       act_connection *actConnection = opUsesIt.first;
       unsigned bitwidth = getBitwidth(actConnection);
-      char *inName = new char[10240];
-      getActConnectionName(actConnection, inName, 10240);
+      const char *inName = getActConnectionName(actConnection);
       double *metric = metrics->getOrGenCopyMetric(bitwidth, numOut);
       const char
           *instance = NameGenerator::genCopyInstName(bitwidth, numOut);
+      String copyName = String(getNormActIdName(inName)) + "copy";
+      throughput.addCopy(throughput.addNode(copyName.c_str(), metric),
+                         actConnection);
       chpBackend->printCopyProcs(
           metric,
           instance,
@@ -801,7 +1010,7 @@ void ProcGenerator::createCopyProcs() {
   }
 }
 
-void ProcGenerator::createSink(const char *name, unsigned bitwidth) {
+double *ProcGenerator::createSink(const char *name, unsigned bitwidth) {
   double *metric = metrics->getSinkMetric();
   const char *instance = NameGenerator::genSinkInstName(bitwidth);
   chpBackend->printSink(
@@ -811,11 +1020,12 @@ void ProcGenerator::createSink(const char *name, unsigned bitwidth) {
       metric,
       instance,
       name);
+  return metric;
 }
 
-void ProcGenerator::createSource(const char *outName,
-                                 unsigned long val,
-                                 unsigned bitwidth) {
+double *ProcGenerator::createSource(const char *outName,
+                                    unsigned long val,
+                                    unsigned bitwidth) {
   const char *instance = NameGenerator::genSourceInstName(val, bitwidth);
   double *metric = metrics->getSourceMetric();
   chpBackend->printSource(
@@ -826,6 +1036,45 @@ void ProcGenerator::createSource(const char *outName,
       metric,
       instance,
       outName);
+  return metric;
+}
+
+void ProcGenerator::addExprInputs(Expr *expr, unsigned node) {
+  switch (expr->type) {
+    case E_VAR: {
+      auto actId = (ActId *) expr->u.e.l;
+      throughput.addInput(node, actId->Canonical(sc));
+      break;
+    }
+    case E_NOT:
+    case E_UMINUS:
+    case E_COMPLEMENT:
+    case E_BUILTIN_INT:
+    case E_BUILTIN_BOOL: {
+      addExprInputs(expr->u.e.l, node);
+      break;
+    }
+    case E_QUERY: {
+      addExprInputs(expr->u.e.l, node);
+      addExprInputs(expr->u.e.r->u.e.l, node);
+      addExprInputs(expr->u.e.r->u.e.r, node);
+      break;
+    }
+    case E_CONCAT: {
+      addExprInputs(expr->u.e.l, node);
+      if (expr->u.e.r) {
+        addExprInputs(expr->u.e.r, node);
+      }
+      break;
+    }
+    default: {
+      if (isBinary(expr->type)) {
+        addExprInputs(expr->u.e.l, node);
+        addExprInputs(expr->u.e.r, node);
+      }
+      break;
+    }
+  }
 }
 
 void ProcGenerator::printDFlowFunc(DflowGenerator *dflowGenerator,
@@ -833,7 +1082,8 @@ void ProcGenerator::printDFlowFunc(DflowGenerator *dflowGenerator,
                                    UIntVec &outBWList,
                                    StringVec &outList,
                                    Map<unsigned int, unsigned int> &outRecord,
-                                   Vector<BuffInfo> &buffInfos) {
+                                   Vector<BuffInfo> &buffInfos,
+                                   unsigned node) {
   if (debug_verbose) {
     printf("PRINT DFLOW FUNCTION\n");
     printf("size: %zu\n", strlen(procName));
@@ -862,12 +1112,30 @@ void ProcGenerator::printDFlowFunc(DflowGenerator *dflowGenerator,
   UIntVec &resBWList = dflowGenerator->getResBWList();
   const char *instance =
       NameGenerator::genFUName(procName, argList, outBWList, argBWList);
-#if LOGIC_OPTIMIZER
   Map<const char *, Expr *> &exprMap = dflowGenerator->getExprMap();
   StringMap<unsigned> &inBW = dflowGenerator->getInBW();
   StringMap<unsigned> &hiddenBW = dflowGenerator->getHiddenBWs();
   Map<Expr *, Expr *> &hiddenExprs = dflowGenerator->getHiddenExprs();
+  const char *fuKey = NameGenerator::genFUKey(metrics->getCacheFingerprint(),
+                                              inBW,
+                                              hiddenBW,
+                                              exprMap,
+                                              hiddenExprs,
+                                              outRecord,
+                                              outBWList);
+  if (collectFUs) {
+#if LOGIC_OPTIMIZER
+    metrics->queueFUMetric(inBW,
+                           hiddenBW,
+                           exprMap,
+                           hiddenExprs,
+                           outRecord,
+                           outBWList,
+                           instance,
+                           fuKey);
 #endif
+    return;
+  }
   double *fuMetric = metrics->getOrGenFUMetric(
 #if LOGIC_OPTIMIZER
       inBW,
@@ -877,36 +1145,331 @@ void ProcGenerator::printDFlowFunc(DflowGenerator *dflowGenerator,
       outRecord,
       outBWList,
 #endif
-      instance);
-  chpBackend->printFU(
-      fuMetric,
       instance,
-      procName,
-      argList,
-      outList,
-      resBWList,
+      fuKey);
+  throughput.setMetric(node, fuMetric);
+  PendingFU pendingFU = {fuMetric, instance, procName, argList, outList,
+                         resBWList, argBWList, outBWList, calc, outRecord,
+                         buffInfos, node};
+  pendingFUs.push_back(pendingFU);
+}
+
+void ProcGenerator::insertSlackBuffers() {
+  double *buffMetric = metrics->getOpMetric("latch1");
+  Map<act_connection *, unsigned long> addedBuffs =
+      throughput.matchSlack(target_cycle_time, buffMetric);
+  /* node of an FU, its index in pendingFUs */
+  Map<unsigned, unsigned> pendingFUIdx;
+  for (unsigned i = 0; i < pendingFUs.size(); i++) {
+    pendingFUIdx.insert({pendingFUs[i].node, i});
+  }
+  for (auto &addedBuffsIt: addedBuffs) {
+    Pair<unsigned, unsigned> &fuOutput = fuOutputs.at(addedBuffsIt.first);
+    auto pendingFUIdxIt = pendingFUIdx.find(fuOutput.first);
+    if (pendingFUIdxIt == pendingFUIdx.end()) {
+      continue;
+    }
+    PendingFU &pendingFU = pendingFUs[pendingFUIdxIt->second];
+    unsigned outID = fuOutput.second;
+    unsigned long nBuff = addedBuffsIt.second;
+    unsigned bw = pendingFU.outBWList[outID];
+    const char *outName = pendingFU.outList[outID].c_str();
+    if (debug_verbose) {
+      printf("slack matching adds %lu buffers to %s\n", nBuff, outName);
+    }
+    double *metric = metrics->getBuffMetric(nBuff, bw);
+    metrics->updateSlackMetrics(nBuff, metric);
+    bool buffered = false;
+    for (auto &buffInfo: pendingFU.buffInfos) {
+      if (buffInfo.outputID == outID) {
+        buffInfo.nBuff += nBuff;
+        /* the metric covers all the buffers of the output; only the added
+         * ones are new to the statistics */
+        buffInfo.metric = metrics->genBuffMetric(buffInfo.nBuff, bw);
+        buffered = true;
+      }
+    }
+    if (!buffered) {
+      BuffInfo buffInfo;
+      buffInfo.outputID = outID;
+      buffInfo.bw = bw;
+      buffInfo.nBuff = nBuff;
+      buffInfo.initVal = -1;
+      buffInfo.finalOutput = newScratchChars(1 + strlen(outName));
+      sprintf(buffInfo.finalOutput, "%s", outName);
+      buffInfo.hasInitVal = false;
+      buffInfo.metric = metric;
+      pendingFU.buffInfos.push_back(buffInfo);
+    }
+  }
+}
+
+void ProcGenerator::printPendingFUs() {
+  for (auto &pendingFU: pendingFUs) {
+    chpBackend->printFU(
+        pendingFU.metric,
+        pendingFU.instance,
+        pendingFU.procName,
+        pendingFU.argList,
+        pendingFU.outList,
+        pendingFU.resBWList,
 #if GEN_NETLIST
-      argBWList,
-      outBWList,
+        pendingFU.argBWList,
+        pendingFU.outBWList,
 #endif
-      calc,
-      outRecord,
-      buffInfos);
-  chpBackend->printBuff(buffInfos);
+        pendingFU.calc.c_str(),
+        pendingFU.outRecord,
+        pendingFU.buffInfos);
+    chpBackend->printBuff(pendingFU.buffInfos);
+  }
+  pendingFUs.clear();
+}
+
+double *ProcGenerator::getCtrlMetric(PendingCtrl &pendingCtrl,
+                                     bool pipelined,
+                                     bool record) {
+  unsigned ctrlBW = pendingCtrl.ctrlBW;
+  unsigned dataBW = pendingCtrl.dataBW;
+  int numIO = pendingCtrl.numIO;
+  switch (pendingCtrl.type) {
+    case ACT_DFLOW_SPLIT: {
+      return record
+             ? metrics->getOrGenSplitMetric(ctrlBW, dataBW, numIO, pipelined)
+             : metrics->genSplitMetric(ctrlBW, dataBW, numIO, pipelined);
+    }
+    case ACT_DFLOW_MERGE: {
+      return record
+             ? metrics->getOrGenMergeMetric(ctrlBW, dataBW, numIO, pipelined)
+             : metrics->genMergeMetric(ctrlBW, dataBW, numIO, pipelined);
+    }
+    default: {
+      bool arbiter = (pendingCtrl.type == ACT_DFLOW_ARBITER);
+      return record
+             ? metrics->getOrGenNondetMetric(arbiter,
+                                             numIO,
+                                             dataBW,
+                                             ctrlBW,
+                                             pipelined)
+             : metrics->genNondetMetric(arbiter,
+                                        numIO,
+                                        dataBW,
+                                        ctrlBW,
+                                        pipelined);
+    }
+  }
+}
+
+unsigned ProcGenerator::queueCtrl(PendingCtrl &pendingCtrl) {
+  pendingCtrl.pipelined = (pipeline_mode == PIPELINE_ALL);
+  for (int variant = 0; variant < 2; variant++) {
+    if ((pipeline_mode == PIPELINE_EXPLORE)
+        || (variant == pendingCtrl.pipelined)) {
+      pendingCtrl.metrics[variant] =
+          getCtrlMetric(pendingCtrl, variant, false);
+    }
+  }
+  pendingCtrl.node = throughput.addNode(
+      pendingCtrl.name, pendingCtrl.metrics[pendingCtrl.pipelined]);
+  throughput.setPipelined(pendingCtrl.node, pendingCtrl.pipelined);
+  pendingCtrls.push_back(pendingCtrl);
+  return pendingCtrl.node;
+}
+
+void ProcGenerator::setCtrlVariant(PendingCtrl &pendingCtrl, bool pipelined) {
+  pendingCtrl.pipelined = pipelined;
+  throughput.setMetric(pendingCtrl.node, pendingCtrl.metrics[pipelined]);
+  throughput.setPipelined(pendingCtrl.node, pipelined);
+}
+
+/* Greedy walk along the area/cycle time trade-off of the process: starting
+ * from all control units unpipelined, pipeline the unit on the critical
+ * cycle that saves the most cycle time per um^2 of extra area, until the
+ * target cycle time is met, the area budget is spent, or no unit speeds the
+ * process up. A pipelined unit whose latches no longer shorten the cycle
+ * time is then unpipelined again, so the result is not dominated by a
+ * smaller assignment of the same cycle time. Slack matching runs on the
+ * result. */
+void ProcGenerator::explorePipelining() {
+  if (!metrics->validMetrics() || pendingCtrls.empty()) {
+    return;
+  }
+  /* node of a control unit, its index in pendingCtrls */
+  Map<unsigned, unsigned> pendingCtrlIdx;
+  for (unsigned i = 0; i < pendingCtrls.size(); i++) {
+    pendingCtrlIdx.insert({pendingCtrls[i].node, i});
+  }
+  double addedArea = 0;
+  UIntVec criticalNodes;
+  double cycleTime = throughput.analyze(criticalNodes);
+  while ((cycleTime > 0) && (cycleTime > target_cycle_time)) {
+    int best = -1;
+    double bestGain = 0;
+    double bestArea = 0;
+    for (auto &node: criticalNodes) {
+      auto pendingCtrlIdxIt = pendingCtrlIdx.find(node);
+      if (pendingCtrlIdxIt == pendingCtrlIdx.end()) {
+        continue;
+      }
+      PendingCtrl &pendingCtrl = pendingCtrls[pendingCtrlIdxIt->second];
+      if (pendingCtrl.pipelined) {
+        continue;
+      }
+      double area = pendingCtrl.metrics[1][3] - pendingCtrl.metrics[0][3];
+      if ((pipeline_area_budget > 0)
+          && (addedArea + area > pipeline_area_budget)) {
+        continue;
+      }
+      UIntVec newCriticalNodes;
+      setCtrlVariant(pendingCtrl, true);
+      double newCycleTime = throughput.analyze(newCriticalNodes);
+      setCtrlVariant(pendingCtrl, false);
+      if ((newCycleTime < 0) || (newCycleTime >= cycleTime)) {
+        continue;
+      }
+      double gain = (cycleTime - newCycleTime) / std::max(area, 1e-6);
+      if ((best < 0) || (gain > bestGain)) {
+        best = pendingCtrlIdxIt->second;
+        bestGain = gain;
+        bestArea = area;
+      }
+    }
+    if (best < 0) {
+      break;
+    }
+    setCtrlVariant(pendingCtrls[best], true);
+    addedArea += bestArea;
+    cycleTime = throughput.analyze(criticalNodes);
+    if (debug_verbose) {
+      printf("pipeline %s: cycle time %.2f ps, %.2f um^2 added\n",
+             pendingCtrls[best].name,
+             cycleTime,
+             addedArea);
+    }
+  }
+  for (auto &pendingCtrl: pendingCtrls) {
+    if (!pendingCtrl.pipelined) {
+      continue;
+    }
+    UIntVec newCriticalNodes;
+    setCtrlVariant(pendingCtrl, false);
+    double newCycleTime = throughput.analyze(newCriticalNodes);
+    if ((newCycleTime < 0) || (newCycleTime > cycleTime)) {
+      setCtrlVariant(pendingCtrl, true);
+      continue;
+    }
+    cycleTime = newCycleTime;
+    addedArea -= pendingCtrl.metrics[1][3] - pendingCtrl.metrics[0][3];
+    if (debug_verbose) {
+      printf("unpipeline %s: cycle time %.2f ps, %.2f um^2 added\n",
+             pendingCtrl.name,
+             cycleTime,
+             addedArea);
+    }
+  }
+}
+
+void ProcGenerator::printPendingCtrls() {
+  for (auto &pendingCtrl: pendingCtrls) {
+    bool pipelined = pendingCtrl.pipelined;
+    double *metric = getCtrlMetric(pendingCtrl, pipelined, true);
+    unsigned ctrlBW = pendingCtrl.ctrlBW;
+    unsigned dataBW = pendingCtrl.dataBW;
+    int numIO = pendingCtrl.numIO;
+    char *procName = newScratchChars(SHORT_STRING_LEN);
+    switch (pendingCtrl.type) {
+      case ACT_DFLOW_SPLIT: {
+        const char *instance = NameGenerator::genSplitInstName(ctrlBW,
+                                                               dataBW,
+                                                               numIO,
+                                                               pipelined,
+                                                               procName);
+        chpBackend->printSplit(
+            metric,
+            instance,
+#if GEN_NETLIST
+            ctrlBW,
+            pipelined,
+#endif
+            pendingCtrl.name,
+            pendingCtrl.ctrlName,
+            pendingCtrl.inputName,
+            pendingCtrl.ioNames,
+            dataBW);
+        break;
+      }
+      case ACT_DFLOW_MERGE: {
+        const char *instance = NameGenerator::genMergeInstName(ctrlBW,
+                                                               dataBW,
+                                                               numIO,
+                                                               pipelined,
+                                                               procName);
+        chpBackend->printMerge(
+            metric,
+            instance,
+#if GEN_NETLIST
+            ctrlBW,
+            pipelined,
+#endif
+            pendingCtrl.name,
+            pendingCtrl.ctrlName,
+            pendingCtrl.ioNames,
+            dataBW);
+        break;
+      }
+      case ACT_DFLOW_MIXER: {
+        const char *instance = NameGenerator::genMixerInstName(ctrlBW,
+                                                               dataBW,
+                                                               numIO,
+                                                               pipelined,
+                                                               procName);
+        chpBackend->printMixer(
+            metric,
+            instance,
+#if GEN_NETLIST
+            ctrlBW,
+            pipelined,
+#endif
+            pendingCtrl.name,
+            pendingCtrl.ctrlName,
+            dataBW,
+            pendingCtrl.ioNames);
+        break;
+      }
+      default: {
+        const char *instance = NameGenerator::genArbiterInstName(ctrlBW,
+                                                                 dataBW,
+                                                                 numIO,
+                                                                 pipelined,
+                                                                 procName);
+        chpBackend->printArbiter(
+            metric,
+            instance,
+#if GEN_NETLIST
+            ctrlBW,
+            pipelined,
+#endif
+            pendingCtrl.name,
+            pendingCtrl.ctrlName,
+            dataBW,
+            pendingCtrl.ioNames);
+        break;
+      }
+    }
+  }
 }
 
 void ProcGenerator::handleDFlowFunc(DflowGenerator *dflowGenerator,
                                     act_dataflow_element *d,
+                                    unsigned node,
                                     int &resSuffix,
                                     StringVec &outList,
                                     UIntVec &outBWList,
                                     Map<unsigned int, unsigned int> &outRecord,
                                     Vector<BuffInfo> &buffInfos) {
-  Expr *expr = d->u.func.lhs;
+  Expr *expr = getCanonicalExpr(d->u.func.lhs);
   int type = expr->type;
   ActId *rhs = d->u.func.rhs;
-  char outName[10240];
-  getActIdName(sc, rhs, outName, 10240);
+  const char *outName = getActIdName(sc, rhs);
   unsigned outBW = getActIdBW(rhs);
   Expr *initExpr = d->u.func.init;
   Expr *bufExpr = d->u.func.nbufs;
@@ -927,9 +1490,14 @@ void ProcGenerator::handleDFlowFunc(DflowGenerator *dflowGenerator,
       }
     }
   }
+  act_connection *outConnection = rhs->Canonical(sc);
   if (type == E_INT) {
     unsigned long val = expr->u.v;
-    createSource(outName, val, outBW);
+    double *metric = nullptr;
+    if (!collectFUs) {
+      metric = createSource(outName, val, outBW);
+    }
+    throughput.addOutput(throughput.addNode(outName, metric), outConnection);
     if (bufExpr) {
       print_expr(stdout, expr);
       printf(" has const lOp, but its rOp has buffer!\n");
@@ -946,8 +1514,20 @@ void ProcGenerator::handleDFlowFunc(DflowGenerator *dflowGenerator,
     outBWList.push_back(outBW);
     unsigned outID = outList.size() - 1;
     outRecord.insert({outID, resSuffix});
-    if (bufExpr)
+    addExprInputs(expr, node);
+    fuOutputs.insert({outConnection, {node, outID}});
+    throughput.setBufferable(outConnection);
+    if (bufExpr && !collectFUs) {
       handleBuff(bufExpr, initExpr, outName, outID, outBW, buffInfos);
+      BuffInfo &buffInfo = buffInfos.back();
+      throughput.addOutput(node,
+                           outConnection,
+                           buffInfo.nBuff,
+                           buffInfo.hasInitVal ? 1 : 0,
+                           buffInfo.metric);
+    } else {
+      throughput.addOutput(node, outConnection);
+    }
     if (debug_verbose) {
       printf("For dataflow element: ");
       dflow_print(stdout, d);
@@ -987,7 +1567,7 @@ void ProcGenerator::handleBuff(Expr *bufExpr,
   buff_info.bw = outBW;
   buff_info.nBuff = numBuff;
   buff_info.initVal = initVal;
-  buff_info.finalOutput = new char[1 + strlen(outName)];
+  buff_info.finalOutput = newScratchChars(1 + strlen(outName));
   sprintf(buff_info.finalOutput, "%s", outName);
   buff_info.hasInitVal = hasInitVal;
   buff_info.metric = buffMetric;
@@ -1016,7 +1596,7 @@ void ProcGenerator::handlePort(const Expr *expr,
     }
     resSuffix++;
     dflowGenerator->printChpPort(exprName, resSuffix, resBW);
-    char *resName = new char[128];
+    char *resName = newScratchChars(128);
     sprintf(resName, "res%d", resSuffix);
     dflowGenerator->preparePortForOpt(resName, exprName, resBW);
   }
@@ -1024,11 +1604,11 @@ void ProcGenerator::handlePort(const Expr *expr,
 
 void ProcGenerator::handleSelectionUnit(act_dataflow_element *d,
                                         CharPtrVec &inNameVec,
-                                        char *&outputName,
+                                        const char *&outputName,
                                         unsigned &dataBW,
                                         int &numInputs) {
   ActId *output = d->u.splitmerge.single;
-  getActIdName(sc, output, outputName, 10240);
+  outputName = getActIdName(sc, output);
   const char *normalizedOutput = getNormActIdName(outputName);
   if (debug_verbose) {
     printf("[merge]: %s_inst\n", normalizedOutput);
@@ -1065,32 +1645,37 @@ void ProcGenerator::handleNormDflowElement(act_dataflow_element *d,
       StringMap<unsigned> hiddenBW;
       Map<unsigned int, unsigned int> outRecord;
       Map<Expr *, Expr *> hiddenExprs;
-      auto dflowGenerator = new DflowGenerator(argList,
-                                               oriArgList,
-                                               argBWList,
-                                               resBWList,
-                                               exprMap,
-                                               inBW,
-                                               hiddenBW,
-                                               hiddenExprs);
-      handleDFlowFunc(dflowGenerator,
+      DflowGenerator dflowGenerator(argList,
+                                    oriArgList,
+                                    argBWList,
+                                    resBWList,
+                                    exprMap,
+                                    inBW,
+                                    hiddenBW,
+                                    hiddenExprs);
+      unsigned node =
+          throughput.addNode(getActIdName(sc, d->u.func.rhs), nullptr);
+      handleDFlowFunc(&dflowGenerator,
                       d,
+                      node,
                       resSuffix,
                       outList,
                       outBWList,
                       outRecord,
                       buffInfos);
-      const char *calc = dflowGenerator->getCalc();
+      const char *calc = dflowGenerator.getCalc();
       if (strlen(calc) > 1) {
-        const char *auto_procName = NameGenerator::genExprName(d->u.func.lhs);
-        char *procName = new char[6 + strlen(auto_procName)];
+        const char *auto_procName =
+            NameGenerator::genExprName(getCanonicalExpr(d->u.func.lhs));
+        char *procName = newScratchChars(6 + strlen(auto_procName));
         sprintf(procName, "func_%s", auto_procName);
-        printDFlowFunc(dflowGenerator,
+        printDFlowFunc(&dflowGenerator,
                        procName,
                        outBWList,
                        outList,
                        outRecord,
-                       buffInfos);
+                       buffInfos,
+                       node);
       }
       break;
     }
@@ -1101,13 +1686,11 @@ void ProcGenerator::handleNormDflowElement(act_dataflow_element *d,
       int numOutputs = d->u.splitmerge.nmulti;
       ActId *guard = d->u.splitmerge.guard;
       unsigned guardBW = getActIdBW(guard);
-      char *splitName = new char[2000];
-      char *inputName = new char[10240];
-      getActIdName(sc, input, inputName, 10240);
+      char *splitName = newScratchChars(2000);
+      const char *inputName = getActIdName(sc, input);
       const char *normalizedInput = getNormActIdName(inputName);
       sprintf(splitName, "%s", normalizedInput);
-      char *guardName = new char[10240];
-      getActIdName(sc, guard, guardName, 10240);
+      const char *guardName = getActIdName(sc, guard);
       const char *normalizedGuard = getNormActIdName(guardName);
       strcat(splitName, normalizedGuard);
       CharPtrVec sinkVec;
@@ -1116,14 +1699,13 @@ void ProcGenerator::handleNormDflowElement(act_dataflow_element *d,
         ActId *out = outputs[i];
         if (!out) {
           strcat(splitName, "sink_");
-          char *sinkName = new char[2100];
+          char *sinkName = newScratchChars(2100);
           sprintf(sinkName, "sink%d", sinkCnt);
           sinkCnt++;
           sinkVec.push_back(sinkName);
           outNameVec.push_back(sinkName);
         } else {
-          char *outName = new char[10240];
-          getActIdName(sc, out, outName, 10240);
+          const char *outName = getActIdName(sc, out);
           const char *normalizedOut = getNormActIdName(outName);
           strcat(splitName, normalizedOut);
           outNameVec.push_back(outName);
@@ -1138,100 +1720,58 @@ void ProcGenerator::handleNormDflowElement(act_dataflow_element *d,
       }
       const char *guardStr = getActIdOrCopyName(guard);
       const char *inputStr = getActIdOrCopyName(input);
-      double *metric = metrics->getOrGenSplitMetric(guardBW, outBW, numOutputs);
-      char *procName = new char[MAX_PROC_NAME_LEN];
-      const char *instance =
-          NameGenerator::genSplitInstName(guardBW, outBW, numOutputs, procName);
-      chpBackend->printSplit(
-          metric,
-          instance,
-#if GEN_NETLIST
-          guardBW,
-#endif
-          splitName,
-          guardStr,
-          inputStr,
-          outNameVec,
-          outBW);
+      PendingCtrl pendingCtrl = {d->t, guardBW, outBW, numOutputs, splitName,
+                                 guardStr, inputStr, outNameVec,
+                                 {nullptr, nullptr}, false, 0};
+      unsigned node = queueCtrl(pendingCtrl);
+      throughput.addInput(node, input->Canonical(sc));
+      throughput.addInput(node, guard->Canonical(sc));
+      for (int i = 0; i < numOutputs; i++) {
+        if (outputs[i]) {
+          throughput.addOutput(node, outputs[i]->Canonical(sc));
+        }
+      }
       break;
     }
     case ACT_DFLOW_MERGE: {
       CharPtrVec inNameVec;
-      char *outputName = new char[10240];
+      const char *outputName = nullptr;
       unsigned dataBW = 0;
       int numInputs = 0;
       handleSelectionUnit(d, inNameVec, outputName, dataBW, numInputs);
       ActId *ctrlIn = d->u.splitmerge.guard;
       unsigned ctrlBW = getActIdBW(ctrlIn);
       const char *ctrlInName = getActIdOrCopyName(ctrlIn);
-      double *metric = metrics->getOrGenMergeMetric(ctrlBW, dataBW, numInputs);
-      char *procName = new char[MAX_PROC_NAME_LEN];
-      const char *instance =
-          NameGenerator::genMergeInstName(ctrlBW,
-                                          dataBW,
-                                          numInputs,
-                                          procName);
-      chpBackend->printMerge(
-          metric,
-          instance,
-#if GEN_NETLIST
-          ctrlBW,
-#endif
-          outputName,
-          ctrlInName,
-          inNameVec,
-          dataBW);
+      PendingCtrl pendingCtrl = {d->t, ctrlBW, dataBW, numInputs, outputName,
+                                 ctrlInName, nullptr, inNameVec,
+                                 {nullptr, nullptr}, false, 0};
+      unsigned node = queueCtrl(pendingCtrl);
+      throughput.addInput(node, ctrlIn->Canonical(sc));
+      for (int i = 0; i < numInputs; i++) {
+        throughput.addInput(node, d->u.splitmerge.multi[i]->Canonical(sc));
+      }
+      throughput.addOutput(node, d->u.splitmerge.single->Canonical(sc));
       break;
     }
     case ACT_DFLOW_MIXER:
     case ACT_DFLOW_ARBITER: {
       CharPtrVec inNameVec;
-      char *outputName = new char[MAX_INSTANCE_LEN];
+      const char *outputName = nullptr;
       unsigned dataBW = 0;
       int numInputs = 0;
       handleSelectionUnit(d, inNameVec, outputName, dataBW, numInputs);
       ActId *ctrlOut = d->u.splitmerge.nondetctrl;
       unsigned ctrlBW = getActIdBW(ctrlOut);
-      char *ctrlOutName = new char[MAX_INSTANCE_LEN];
-      getActIdName(sc, ctrlOut, ctrlOutName, MAX_INSTANCE_LEN);
-      double *metric = nullptr;
-      if (d->t == ACT_DFLOW_MIXER) {
-        metrics->getMixerMetric(numInputs, dataBW, ctrlBW);
-        char *procName = new char[MAX_PROC_NAME_LEN];
-        const char *instance =
-            NameGenerator::genMixerInstName(ctrlBW,
-                                            dataBW,
-                                            numInputs,
-                                            procName);
-        chpBackend->printMixer(
-            metric,
-            instance,
-#if GEN_NETLIST
-            ctrlBW,
-#endif
-            outputName,
-            ctrlOutName,
-            dataBW,
-            inNameVec);
-      } else {
-        metrics->getArbiterMetric(numInputs, dataBW, ctrlBW);
-        char *procName = new char[MAX_PROC_NAME_LEN];
-        const char *instance =
-            NameGenerator::genArbiterInstName(ctrlBW,
-                                              dataBW,
-                                              numInputs,
-                                              procName);
-        chpBackend->printArbiter(
-            metric,
-            instance,
-#if GEN_NETLIST
-            ctrlBW,
-#endif
-            outputName,
-            ctrlOutName,
-            dataBW,
-            inNameVec);
+      const char *ctrlOutName = getActIdName(sc, ctrlOut);
+      PendingCtrl pendingCtrl = {d->t, ctrlBW, dataBW, numInputs, outputName,
+                                 ctrlOutName, nullptr, inNameVec,
+                                 {nullptr, nullptr}, false, 0};
+      unsigned node = queueCtrl(pendingCtrl);
+      for (int i = 0; i < numInputs; i++) {
+        throughput.addInput(node, d->u.splitmerge.multi[i]->Canonical(sc));
       }
+      throughput.addOutput(node, d->u.splitmerge.single->Canonical(sc));
+      throughput.addOutput(node, ctrlOut->Canonical(sc));
       break;
     }
     case ACT_DFLOW_CLUSTER: {
@@ -1241,10 +1781,11 @@ void ProcGenerator::handleNormDflowElement(act_dataflow_element *d,
     }
     case ACT_DFLOW_SINK: {
       ActId *input = d->u.sink.chan;
-      char *inputName = new char[10240];
-      getActIdName(sc, input, inputName, 10240);
+      const char *inputName = getActIdName(sc, input);
       unsigned bw = getBitwidth(input->Canonical(sc));
-      createSink(inputName, bw);
+      double *metric = createSink(inputName, bw);
+      throughput.addInput(throughput.addNode(inputName, metric),
+                          input->Canonical(sc));
       if (debug_verbose) {
         printf("%s is not used anywhere!\n", inputName);
       }
@@ -1258,7 +1799,7 @@ void ProcGenerator::handleNormDflowElement(act_dataflow_element *d,
 }
 
 void ProcGenerator::handleDFlowCluster(list_t *dflow_cluster) {
-  char *def = new char[10240];
+  char *def = newScratchChars(10240);
   sprintf(def, "\n");
   StringVec argList;
   StringVec oriArgList;
@@ -1273,14 +1814,16 @@ void ProcGenerator::handleDFlowCluster(list_t *dflow_cluster) {
   StringMap<unsigned> hiddenBW;
   Map<unsigned int, unsigned int> outRecord;
   Map<Expr *, Expr *> hiddenExprs;
-  auto dflowGenerator = new DflowGenerator(argList,
-                                           oriArgList,
-                                           argBWList,
-                                           resBWList,
-                                           exprMap,
-                                           inBW,
-                                           hiddenBW,
-                                           hiddenExprs);
+  DflowGenerator dflowGenerator(argList,
+                                oriArgList,
+                                argBWList,
+                                resBWList,
+                                exprMap,
+                                inBW,
+                                hiddenBW,
+                                hiddenExprs);
+  Vector<Expr *> exprList;
+  int node = -1;
   listitem_t *li;
   for (li = list_first (dflow_cluster); li; li = list_next (li)) {
     auto *d = (act_dataflow_element *) list_value (li);
@@ -1290,13 +1833,18 @@ void ProcGenerator::handleDFlowCluster(list_t *dflow_cluster) {
       printf("\n");
     }
     if (d->t == ACT_DFLOW_FUNC) {
-      handleDFlowFunc(dflowGenerator,
+      if (node < 0) {
+        node = throughput.addNode(getActIdName(sc, d->u.func.rhs), nullptr);
+      }
+      handleDFlowFunc(&dflowGenerator,
                       d,
+                      node,
                       resSuffix,
                       outList,
                       outBWList,
                       outRecord,
                       buffInfos);
+      exprList.push_back(getCanonicalExpr(d->u.func.lhs));
     } else {
       dflow_print(stdout, d);
       printf(
@@ -1305,8 +1853,8 @@ void ProcGenerator::handleDFlowCluster(list_t *dflow_cluster) {
     }
   }
   const char
-      *auto_clusterName = NameGenerator::genExprClusterName(dflow_cluster);
-  char *clusterName = new char[6 + strlen(auto_clusterName)];
+      *auto_clusterName = NameGenerator::genExprClusterName(exprList);
+  char *clusterName = newScratchChars(6 + strlen(auto_clusterName));
   sprintf(clusterName, "func_%s", auto_clusterName);
   if (debug_verbose) {
     printf("Process cluster dflow_cluster:\n");
@@ -1314,26 +1862,33 @@ void ProcGenerator::handleDFlowCluster(list_t *dflow_cluster) {
     printf("\n");
     printf("Its name is %s\n", clusterName);
   }
-  const char *calc = dflowGenerator->getCalc();
+  const char *calc = dflowGenerator.getCalc();
   if (strlen(calc) > 1) {
-    printDFlowFunc(dflowGenerator,
+    printDFlowFunc(&dflowGenerator,
                    clusterName,
                    outBWList,
                    outList,
                    outRecord,
-                   buffInfos);
+                   buffInfos,
+                   node);
   }
 }
 
 ProcGenerator::ProcGenerator(Metrics *metrics,
-                             ChpBackend *chpBackend) {
+                             ChpBackend *chpBackend,
+                             bool collectFUs) {
   this->metrics = metrics;
   this->chpBackend = chpBackend;
+  this->collectFUs = collectFUs;
 }
 
 int ProcGenerator::run(Process *p) {
   auto stdNS = ActNamespace::Global()->findNS(Constant::STD_NAMESPACE);
   if (p->getns() == stdNS) return 0;
+  /* scratch names and exprs die with the process; FUs queued in collect mode
+   * keep pointing at theirs, so that arena lives until the jobs have run */
+  Arena procArena;
+  ArenaScope arenaScope(collectFUs ? metrics->newJobArena() : &procArena);
   this->sc = p->CurScope();
   this->p = p;
   const char *pName = p->getName();
@@ -1341,17 +1896,25 @@ int ProcGenerator::run(Process *p) {
     printf("processing %s\n", pName);
   }
   if (p->getlang()->getchp()) {
-    chpBackend->createChpBlock(p,0);
+    if (!collectFUs) {
+      chpBackend->createChpBlock(p,0);
+    }
     return 0;
   }
   if (!p->getlang()->getdflow()) {
-    chpBackend->createChpBlock(p,1);
+    if (!collectFUs) {
+      chpBackend->createChpBlock(p,1);
+    }
     return 0;
   }
-  chpBackend->printProcHeader(p);
+  if (!collectFUs) {
+    chpBackend->printProcHeader(p);
+  }
   collectBitwidthInfo();
   collectOpUses();
-  createCopyProcs();
+  if (!collectFUs) {
+    createCopyProcs();
+  }
   listitem_t *li = nullptr;
   unsigned sinkCnt = 0;
   for (li = list_first (p->getlang()->getdflow()->dflow); li;
@@ -1360,11 +1923,33 @@ int ProcGenerator::run(Process *p) {
     if (d->t == ACT_DFLOW_CLUSTER) {
       list_t *dflow_cluster = d->u.dflow_cluster;
       handleDFlowCluster(dflow_cluster);
-    } else {
+    } else if (!collectFUs || (d->t == ACT_DFLOW_FUNC)) {
       handleNormDflowElement(d, sinkCnt);
     }
   }
-  chpBackend->printProcEnding();
+  if (!collectFUs) {
+    if (pipeline_mode == PIPELINE_EXPLORE) {
+      explorePipelining();
+    }
+    printPendingCtrls();
+    if (target_cycle_time > 0) {
+      insertSlackBuffers();
+    }
+    printPendingFUs();
+    /* slack matching above only looks at corner 0 */
+    for (unsigned c = 0; c < num_corners; c++) {
+      throughput.setCorner(c);
+      String criticalCycle;
+      double cycleTime = throughput.analyze(criticalCycle);
+      if (debug_verbose) {
+        printf("cycle time of %s at corner %s: %.2f ps, critical cycle: %s\n",
+               pName, corner_names[c], cycleTime, criticalCycle.c_str());
+      }
+      metrics->updateThroughput(pName, cycleTime, criticalCycle.c_str(), c);
+    }
+    throughput.setCorner(0);
+    chpBackend->printProcEnding();
+  }
   return 0;
 }
 
@@ -39,6 +39,7 @@
 #include "src/core/Metrics.h"
 #include "src/core/DflowGenerator.h"
 #include "src/core/NameGenerator.h"
+#include "src/core/ThroughputAnalyzer.h"
 #include "src/common/common.h"
 #include "src/common/Helper.h"
 #include "src/common/config.h"
@@ -47,10 +48,47 @@
 #include <act/expropt.h>
 #endif
 
+/* an FU whose printing waits until slack matching has seen the whole
+ * process */
+typedef struct pendingFU {
+  double *metric;
+  const char *instance;
+  const char *procName;
+  StringVec argList;
+  StringVec outList;
+  UIntVec resBWList;
+  UIntVec argBWList;
+  UIntVec outBWList;
+  String calc;
+  Map<unsigned int, unsigned int> outRecord;
+  Vector<BuffInfo> buffInfos;
+  unsigned node;
+} PendingFU;
+
+/* a merge, split, mixer or arbiter, printed once the pipeline mode has
+ * picked its variant */
+typedef struct pendingCtrl {
+  int type;
+  unsigned ctrlBW;
+  unsigned dataBW;
+  int numIO;
+  const char *name;
+  const char *ctrlName;
+  /* the data input of a split */
+  const char *inputName;
+  CharPtrVec ioNames;
+  /* metric of the unpipelined and of the pipelined variant; only the one in
+   * use is looked up unless the variants are explored */
+  double *metrics[2];
+  bool pipelined;
+  unsigned node;
+} PendingCtrl;
+
 class ProcGenerator {
  public:
   ProcGenerator(Metrics *metrics,
-                ChpBackend *chpBackend);
+                ChpBackend *chpBackend,
+                bool collectFUs = false);
 
   const char *getActIdOrCopyName(ActId *actId);
 
@@ -90,6 +128,12 @@ class ProcGenerator {
                         int &resSuffix,
                         unsigned &resBW);
 
+  /* the canonical form of an FU expression: commutative operands sorted,
+   * chains of associative operators flattened, and "<"/"<=" mirrored into
+   * ">"/">=" where that sorts the operands; equivalent FUs then get the
+   * same name and the same port order */
+  Expr *getCanonicalExpr(Expr *expr);
+
   unsigned getCopyUses(ActId *actId);
 
   void updateOpUses(ActId *actId);
@@ -125,10 +169,12 @@ class ProcGenerator {
                       UIntVec &outBWList,
                       StringVec &outList,
                       Map<unsigned int, unsigned int> &outRecord,
-                      Vector<BuffInfo> &buffInfos);
+                      Vector<BuffInfo> &buffInfos,
+                      unsigned node);
 
   void handleDFlowFunc(DflowGenerator *dflowGenerator,
                        act_dataflow_element *d,
+                       unsigned node,
                        int &resSuffix,
                        StringVec &outList,
                        UIntVec &outBWList,
@@ -137,7 +183,7 @@ class ProcGenerator {
 
   void handleSelectionUnit(act_dataflow_element *d,
                            CharPtrVec &inNameVec,
-                           char *&outputName,
+                           const char *&outputName,
                            unsigned &dataBW,
                            int &numInputs);
 
@@ -171,14 +217,58 @@ class ProcGenerator {
   Map<act_connection *, unsigned> copyUses;
   Metrics *metrics;
   ChpBackend *chpBackend;
+  /* only queue the FUs that need the logic optimizer; print nothing */
+  bool collectFUs;
   Process *p;
   Scope *sc;
 
-  void createSink(const char *name, unsigned bitwidth);
+  /* expression, its canonical form */
+  Map<Expr *, Expr *> canonicalExprs;
+  /* canonical expression, the key its operands are sorted by */
+  Map<Expr *, String> exprSignatures;
+
+  Expr *canonicalizeExpr(Expr *expr);
+
+  const String &getExprSignature(Expr *expr);
+
+  void collectChainOperands(Expr *expr, int type, Vector<Expr *> &operands);
+
+  /* the process instances and channels of the process */
+  ThroughputAnalyzer throughput;
+
+  /* FU output channel, (node of the FU, output id) */
+  Map<act_connection *, Pair<unsigned, unsigned>> fuOutputs;
+
+  Vector<PendingFU> pendingFUs;
+
+  /* add the buffers slack matching asks for to the FU outputs */
+  void insertSlackBuffers();
+
+  void printPendingFUs();
+
+  Vector<PendingCtrl> pendingCtrls;
+
+  double *getCtrlMetric(PendingCtrl &pendingCtrl, bool pipelined, bool record);
+
+  /* look up the variants of the control unit and add it to the throughput
+   * model; returns its node */
+  unsigned queueCtrl(PendingCtrl &pendingCtrl);
+
+  void setCtrlVariant(PendingCtrl &pendingCtrl, bool pipelined);
+
+  /* pick the pipelined control units under the cycle time and area budgets */
+  void explorePipelining();
+
+  void printPendingCtrls();
+
+  /* the node reads every channel in the expression */
+  void addExprInputs(Expr *expr, unsigned node);
+
+  double *createSink(const char *name, unsigned bitwidth);
 
-  void createSource(const char *outName,
-                    unsigned long val,
-                    unsigned bitwidth);
+  double *createSource(const char *outName,
+                       unsigned long val,
+                       unsigned bitwidth);
 
 };
 
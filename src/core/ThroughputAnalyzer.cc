@@ -0,0 +1,501 @@
+/*
+ * This file is part of the ACT library
+ *
+ * Copyright (c) 2021 Rui Li
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include "ThroughputAnalyzer.h"
+
+/* Howard's iteration converges in a handful of rounds in practice */
+#define MAX_HOWARD_ITERATIONS 1000
+#define HOWARD_EPSILON 1e-9
+/* slack matching gives up on a process after this many buffers */
+#define MAX_SLACK_BUFFERS 1024
+
+static bool greater(double lhs, double rhs) {
+  return lhs > rhs + HOWARD_EPSILON * (1 + std::fabs(rhs));
+}
+
+ThroughputAnalyzer::ThroughputAnalyzer() {
+  corner = 0;
+}
+
+unsigned ThroughputAnalyzer::addNode(const char *name, double *metric) {
+  nodeNames.emplace_back(name);
+  nodeMetrics.push_back(metric);
+  nodePipelined.push_back(false);
+  return nodeNames.size() - 1;
+}
+
+void ThroughputAnalyzer::setMetric(unsigned node, double *metric) {
+  nodeMetrics[node] = metric;
+}
+
+void ThroughputAnalyzer::setPipelined(unsigned node, bool pipelined) {
+  nodePipelined[node] = pipelined;
+}
+
+double ThroughputAnalyzer::getNodeDelay(unsigned node) {
+  double *metric = nodeMetrics[node];
+  return metric ? metric[4 * corner + 2] : 0;
+}
+
+double ThroughputAnalyzer::getChannelDelay(ChannelInfo &channelInfo) {
+  double *metric = channelInfo.buffMetric;
+  return metric ? (channelInfo.slots - 1) * metric[4 * corner + 2] : 0;
+}
+
+ThroughputAnalyzer::ChannelInfo &ThroughputAnalyzer::getChannel(
+    act_connection *channel) {
+  auto channelsIt = channels.find(channel);
+  if (channelsIt == channels.end()) {
+    ChannelInfo channelInfo = {-1, -1, 1, 0, nullptr, false, {}};
+    channelsIt = channels.insert({channel, channelInfo}).first;
+  }
+  return channelsIt->second;
+}
+
+void ThroughputAnalyzer::addInput(unsigned node, act_connection *channel) {
+  getChannel(channel).readers.push_back(node);
+}
+
+void ThroughputAnalyzer::addOutput(unsigned node,
+                                   act_connection *channel,
+                                   unsigned long nBuff,
+                                   unsigned tokens,
+                                   double *buffMetric) {
+  ChannelInfo &channelInfo = getChannel(channel);
+  channelInfo.driver = node;
+  channelInfo.slots = nBuff + 1;
+  channelInfo.tokens = tokens;
+  channelInfo.buffMetric = buffMetric;
+}
+
+void ThroughputAnalyzer::addCopy(unsigned node, act_connection *channel) {
+  getChannel(channel).copy = node;
+}
+
+void ThroughputAnalyzer::setBufferable(act_connection *channel) {
+  getChannel(channel).bufferable = true;
+}
+
+/* the edges of a channel from "from" to "to"; channelInfo is nullptr for the
+ * plain channels from a copy to its readers */
+void ThroughputAnalyzer::connect(Vector<Edge> &edges,
+                                 unsigned from,
+                                 unsigned to,
+                                 act_connection *channel,
+                                 ChannelInfo *channelInfo) {
+  double delay = channelInfo ? getChannelDelay(*channelInfo) : 0;
+  unsigned tokens = channelInfo ? channelInfo->tokens : 0;
+  unsigned long slots = channelInfo ? channelInfo->slots : 1;
+  if (channelInfo && nodePipelined[from]) {
+    slots++;
+  }
+  /* a channel inside a cluster FU is not a handshake of its own */
+  if ((from == to) && !tokens) {
+    return;
+  }
+  if (!channelInfo || !channelInfo->bufferable) {
+    channel = nullptr;
+  }
+  unsigned freeSlots = (slots > tokens) ? (slots - tokens) : 0;
+  edges.push_back({from, to, getNodeDelay(from) + delay, tokens, channel,
+                   false});
+  edges.push_back({to, from, getNodeDelay(to), freeSlots, channel, true});
+}
+
+Vector<ThroughputAnalyzer::Edge> ThroughputAnalyzer::buildEdges() {
+  Vector<Edge> edges;
+  for (auto &channelsIt: channels) {
+    act_connection *channel = channelsIt.first;
+    ChannelInfo &channelInfo = channelsIt.second;
+    int driver = channelInfo.driver;
+    if (channelInfo.copy >= 0) {
+      if (driver >= 0) {
+        connect(edges, driver, channelInfo.copy, channel, &channelInfo);
+      }
+      for (auto &reader: channelInfo.readers) {
+        connect(edges, channelInfo.copy, reader, nullptr, nullptr);
+      }
+    } else if (driver >= 0) {
+      for (auto &reader: channelInfo.readers) {
+        connect(edges, driver, reader, channel, &channelInfo);
+      }
+    }
+  }
+  return edges;
+}
+
+/* Tarjan's strongly connected components; only edges inside a component can
+ * be on a cycle */
+Vector<int> ThroughputAnalyzer::findComponents(Vector<Edge> &edges) {
+  unsigned numNodes = nodeNames.size();
+  Vector<UIntVec> succs(numNodes);
+  for (auto &edge: edges) {
+    succs[edge.from].push_back(edge.to);
+  }
+  Vector<int> index(numNodes, -1);
+  Vector<int> lowLink(numNodes, 0);
+  Vector<int> components(numNodes, -1);
+  Vector<bool> onStack(numNodes, false);
+  UIntVec stack;
+  int nextIndex = 0;
+  int numComponents = 0;
+  for (unsigned root = 0; root < numNodes; root++) {
+    if (index[root] >= 0) {
+      continue;
+    }
+    /* node, index of its next successor to visit */
+    Vector<Pair<unsigned, unsigned>> callStack = {{root, 0}};
+    index[root] = lowLink[root] = nextIndex++;
+    stack.push_back(root);
+    onStack[root] = true;
+    while (!callStack.empty()) {
+      unsigned u = callStack.back().first;
+      unsigned next = callStack.back().second;
+      if (next < succs[u].size()) {
+        callStack.back().second++;
+        unsigned v = succs[u][next];
+        if (index[v] < 0) {
+          index[v] = lowLink[v] = nextIndex++;
+          stack.push_back(v);
+          onStack[v] = true;
+          callStack.emplace_back(v, 0);
+        } else if (onStack[v]) {
+          lowLink[u] = std::min(lowLink[u], index[v]);
+        }
+        continue;
+      }
+      callStack.pop_back();
+      if (!callStack.empty()) {
+        unsigned parent = callStack.back().first;
+        lowLink[parent] = std::min(lowLink[parent], lowLink[u]);
+      }
+      if (lowLink[u] == index[u]) {
+        unsigned w;
+        do {
+          w = stack.back();
+          stack.pop_back();
+          onStack[w] = false;
+          components[w] = numComponents;
+        } while (w != u);
+        numComponents++;
+      }
+    }
+  }
+  return components;
+}
+
+bool ThroughputAnalyzer::findZeroTokenCycle(Vector<Edge> &edges,
+                                            UIntVec &cycle) {
+  unsigned numNodes = nodeNames.size();
+  Vector<UIntVec> outEdges(numNodes);
+  for (unsigned i = 0; i < edges.size(); i++) {
+    if (!edges[i].tokens) {
+      outEdges[edges[i].from].push_back(i);
+    }
+  }
+  /* 0: not visited, 1: on the DFS path, 2: done */
+  Vector<int> color(numNodes, 0);
+  for (unsigned root = 0; root < numNodes; root++) {
+    if (color[root]) {
+      continue;
+    }
+    Vector<Pair<unsigned, unsigned>> callStack = {{root, 0}};
+    /* the edge from every node on the DFS path to the next one */
+    UIntVec pathEdges;
+    color[root] = 1;
+    while (!callStack.empty()) {
+      unsigned u = callStack.back().first;
+      unsigned next = callStack.back().second;
+      if (next >= outEdges[u].size()) {
+        color[u] = 2;
+        callStack.pop_back();
+        if (!pathEdges.empty()) {
+          pathEdges.pop_back();
+        }
+        continue;
+      }
+      callStack.back().second++;
+      unsigned e = outEdges[u][next];
+      unsigned v = edges[e].to;
+      if (color[v] == 1) {
+        /* the cycle is the part of the DFS path from v on */
+        unsigned pos = 0;
+        while (callStack[pos].first != v) {
+          pos++;
+        }
+        cycle.assign(pathEdges.begin() + pos, pathEdges.end());
+        cycle.push_back(e);
+        return true;
+      }
+      if (!color[v]) {
+        color[v] = 1;
+        callStack.emplace_back(v, 0);
+        pathEdges.push_back(e);
+      }
+    }
+  }
+  return false;
+}
+
+/* Howard's policy iteration for the maximum cycle ratio (Cochet-Terrasson et
+ * al.). Every node keeps one out-edge (its policy); the policy graph has one
+ * cycle per component, whose ratio every node of the component inherits,
+ * and a node switches to an edge that leads to a higher ratio or, on a tie,
+ * to a higher potential. Every node here has an out-edge, and every cycle
+ * holds a token. */
+double ThroughputAnalyzer::runHoward(Vector<Edge> &edges, UIntVec &cycle) {
+  unsigned numNodes = nodeNames.size();
+  Vector<UIntVec> outEdges(numNodes);
+  for (unsigned i = 0; i < edges.size(); i++) {
+    outEdges[edges[i].from].push_back(i);
+  }
+  Vector<int> policy(numNodes, -1);
+  for (unsigned u = 0; u < numNodes; u++) {
+    for (auto &e: outEdges[u]) {
+      if ((policy[u] < 0) || (edges[e].delay > edges[policy[u]].delay)) {
+        policy[u] = e;
+      }
+    }
+  }
+  Vector<double> ratio(numNodes, 0);
+  Vector<double> value(numNodes, 0);
+  Vector<int> state(numNodes, 0);
+  for (unsigned iter = 0; iter < MAX_HOWARD_ITERATIONS; iter++) {
+    /* value determination */
+    std::fill(state.begin(), state.end(), 0);
+    for (unsigned u = 0; u < numNodes; u++) {
+      if ((policy[u] < 0) || state[u]) {
+        continue;
+      }
+      UIntVec path;
+      unsigned v = u;
+      while (!state[v]) {
+        state[v] = 1;
+        path.push_back(v);
+        v = edges[policy[v]].to;
+      }
+      if (state[v] == 1) {
+        /* the walk closed a new policy cycle at v */
+        double delay = 0;
+        unsigned tokens = 0;
+        unsigned w = v;
+        do {
+          Edge &edge = edges[policy[w]];
+          delay += edge.delay;
+          tokens += edge.tokens;
+          w = edge.to;
+        } while (w != v);
+        if (!tokens) {
+          printf("Throughput analysis hit a cycle without tokens!\n");
+          exit(-1);
+        }
+        ratio[v] = delay / tokens;
+        value[v] = 0;
+        state[v] = 2;
+      }
+      for (auto pathIt = path.rbegin(); pathIt != path.rend(); pathIt++) {
+        unsigned w = *pathIt;
+        if (state[w] == 2) {
+          continue;
+        }
+        Edge &edge = edges[policy[w]];
+        ratio[w] = ratio[edge.to];
+        value[w] = edge.delay - ratio[w] * edge.tokens + value[edge.to];
+        state[w] = 2;
+      }
+    }
+    /* policy improvement */
+    bool changed = false;
+    for (unsigned u = 0; u < numNodes; u++) {
+      for (auto &e: outEdges[u]) {
+        if (greater(ratio[edges[e].to], ratio[edges[policy[u]].to])) {
+          policy[u] = e;
+          changed = true;
+        }
+      }
+    }
+    if (!changed) {
+      for (unsigned u = 0; u < numNodes; u++) {
+        double bestValue = value[u];
+        for (auto &e: outEdges[u]) {
+          Edge &edge = edges[e];
+          if (greater(ratio[edge.to], ratio[u])
+              || greater(ratio[u], ratio[edge.to])) {
+            continue;
+          }
+          double newValue =
+              edge.delay - ratio[u] * edge.tokens + value[edge.to];
+          if (greater(newValue, bestValue)) {
+            policy[u] = e;
+            bestValue = newValue;
+            changed = true;
+          }
+        }
+      }
+    }
+    if (!changed) {
+      break;
+    }
+  }
+  int critical = -1;
+  for (unsigned u = 0; u < numNodes; u++) {
+    if ((policy[u] >= 0) && ((critical < 0) || (ratio[u] > ratio[critical]))) {
+      critical = u;
+    }
+  }
+  /* walk the policy from the critical node into its cycle */
+  std::fill(state.begin(), state.end(), 0);
+  unsigned v = critical;
+  while (!state[v]) {
+    state[v] = 1;
+    v = edges[policy[v]].to;
+  }
+  cycle.clear();
+  unsigned w = v;
+  do {
+    cycle.push_back(policy[w]);
+    w = edges[policy[w]].to;
+  } while (w != v);
+  return ratio[critical];
+}
+
+String ThroughputAnalyzer::printCycle(Vector<Edge> &edges, UIntVec &cycle) {
+  String res;
+  for (auto &e: cycle) {
+    res += nodeNames[edges[e].from] + " -> ";
+  }
+  res += nodeNames[edges[cycle[0]].from];
+  return res;
+}
+
+double ThroughputAnalyzer::findCriticalCycle(Vector<Edge> &edges,
+                                             UIntVec &cycle) {
+  cycle.clear();
+  Vector<int> components = findComponents(edges);
+  /* index of each edge that can be on a cycle in edges */
+  UIntVec cyclicIdx;
+  Vector<Edge> cyclicEdges;
+  for (unsigned i = 0; i < edges.size(); i++) {
+    if (components[edges[i].from] == components[edges[i].to]) {
+      cyclicIdx.push_back(i);
+      cyclicEdges.push_back(edges[i]);
+    }
+  }
+  if (cyclicEdges.empty()) {
+    return 0;
+  }
+  double cycleTime = -1;
+  if (!findZeroTokenCycle(cyclicEdges, cycle)) {
+    cycleTime = runHoward(cyclicEdges, cycle);
+  }
+  for (auto &e: cycle) {
+    e = cyclicIdx[e];
+  }
+  return cycleTime;
+}
+
+double ThroughputAnalyzer::analyze(String &criticalCycle) {
+  criticalCycle.clear();
+  Vector<Edge> edges = buildEdges();
+  UIntVec cycle;
+  double cycleTime = findCriticalCycle(edges, cycle);
+  if (!cycle.empty()) {
+    criticalCycle = printCycle(edges, cycle);
+  }
+  return cycleTime;
+}
+
+double ThroughputAnalyzer::analyze(UIntVec &criticalNodes) {
+  criticalNodes.clear();
+  Vector<Edge> edges = buildEdges();
+  UIntVec cycle;
+  double cycleTime = findCriticalCycle(edges, cycle);
+  for (auto &e: cycle) {
+    criticalNodes.push_back(edges[e].from);
+  }
+  return cycleTime;
+}
+
+Map<act_connection *, unsigned long> ThroughputAnalyzer::matchSlack(
+    double targetCycleTime,
+    double *buffMetric) {
+  double buffDelay = buffMetric ? buffMetric[4 * corner + 2] : 0;
+  Map<act_connection *, unsigned long> addedBuffs;
+  act_connection *lastBuffered = nullptr;
+  double lastCycleTime = -1;
+  for (unsigned i = 0; i <= MAX_SLACK_BUFFERS; i++) {
+    Vector<Edge> edges = buildEdges();
+    UIntVec cycle;
+    double cycleTime = findCriticalCycle(edges, cycle);
+    if (lastBuffered && greater(cycleTime, lastCycleTime)) {
+      /* the delay of the buffer slowed down another cycle */
+      ChannelInfo &channelInfo = channels[lastBuffered];
+      channelInfo.slots--;
+      if (!--addedBuffs[lastBuffered]) {
+        addedBuffs.erase(lastBuffered);
+      }
+      break;
+    }
+    if ((cycleTime < 0) || !greater(cycleTime, targetCycleTime)
+        || (i == MAX_SLACK_BUFFERS)) {
+      break;
+    }
+    double delay = 0;
+    unsigned tokens = 0;
+    for (auto &e: cycle) {
+      delay += edges[e].delay;
+      tokens += edges[e].tokens;
+    }
+    act_connection *best = nullptr;
+    for (auto &e: cycle) {
+      Edge &edge = edges[e];
+      if (!edge.backward || !edge.channel) {
+        continue;
+      }
+      /* the buffer also delays the cycle if it runs forward through the
+       * channel as well, i.e., it is the handshake of the channel */
+      double newDelay = delay;
+      for (auto &f: cycle) {
+        if ((edges[f].channel == edge.channel) && !edges[f].backward) {
+          newDelay += buffDelay;
+        }
+      }
+      if (greater(cycleTime, newDelay / (tokens + 1))
+          && (!best || (channels[edge.channel].slots < channels[best].slots))) {
+        best = edge.channel;
+      }
+    }
+    if (!best) {
+      break;
+    }
+    ChannelInfo &channelInfo = channels[best];
+    channelInfo.slots++;
+    if (!channelInfo.buffMetric) {
+      channelInfo.buffMetric = buffMetric;
+    }
+    addedBuffs[best]++;
+    lastBuffered = best;
+    lastCycleTime = cycleTime;
+  }
+  return addedBuffs;
+}
@@ -0,0 +1,145 @@
+/*
+ * This file is part of the ACT library
+ *
+ * Copyright (c) 2021 Rui Li
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+#ifndef DFLOWMAP_SRC_CORE_THROUGHPUTANALYZER_H_
+#define DFLOWMAP_SRC_CORE_THROUGHPUTANALYZER_H_
+
+#include <cstdio>
+#include "src/common/common.h"
+
+/* Steady-state throughput of one dataflow process. The process instances
+ * are the nodes of a marked graph; every channel is a forward edge carrying
+ * its initial tokens and a backward (acknowledge) edge carrying its free
+ * slots, so a channel with n buffers holds n + 1 tokens. A cycle through
+ * nodes of total delay D that holds T tokens cannot complete faster than
+ * D / T; the cycle time of the process is the maximum of this ratio over all
+ * cycles, found with Howard's policy iteration. */
+class ThroughputAnalyzer {
+ public:
+  ThroughputAnalyzer();
+
+  /* a process instance with the given metric (or nullptr); returns its id */
+  unsigned addNode(const char *name, double *metric);
+
+  void setMetric(unsigned node, double *metric);
+
+  /* the output latches of a pipelined node hold a token of their own, i.e.,
+   * add a slot to every channel the node drives */
+  void setPipelined(unsigned node, bool pipelined);
+
+  /* the node reads the channel */
+  void addInput(unsigned node, act_connection *channel);
+
+  /* the node drives the channel through nBuff buffers with the delay of
+   * buffMetric each, tokens of which hold an initial value */
+  void addOutput(unsigned node,
+                 act_connection *channel,
+                 unsigned long nBuff = 0,
+                 unsigned tokens = 0,
+                 double *buffMetric = nullptr);
+
+  /* the copy node forwards the channel to all of its readers */
+  void addCopy(unsigned node, act_connection *channel);
+
+  /* buffers may be added at the driver of the channel */
+  void setBufferable(act_connection *channel);
+
+  /* analyze with the delays of the given corner of the metrics */
+  void setCorner(unsigned c) { corner = c; }
+
+  /* cycle time (ps) of the process and the names along its critical cycle;
+   * 0 if nothing is cyclic, and -1 if a cycle holds no token (the process
+   * deadlocks), in which case that cycle is returned */
+  double analyze(String &criticalCycle);
+
+  /* the same, with the nodes along the critical cycle */
+  double analyze(UIntVec &criticalNodes);
+
+  /* Slack matching: add buffers of the given delay to bufferable channels
+   * until the cycle time is at most targetCycleTime. A buffer adds a free
+   * slot to every cycle through the acknowledge edge of its channel, which
+   * is what a short branch of a reconvergent fork/join lacks. Buffers are
+   * added one at a time to the critical cycle, preferring the channels with
+   * the fewest buffers; this stops at a cycle no buffer can speed up (a
+   * loop of the process itself). Returns the buffers added per channel. */
+  Map<act_connection *, unsigned long> matchSlack(double targetCycleTime,
+                                                  double *buffMetric);
+
+ private:
+  typedef struct channelInfo {
+    int driver;
+    int copy;
+    unsigned long slots;
+    unsigned tokens;
+    /* each of the slots - 1 buffers has the delay of this metric */
+    double *buffMetric;
+    bool bufferable;
+    UIntVec readers;
+  } ChannelInfo;
+
+  typedef struct edge {
+    unsigned from;
+    unsigned to;
+    double delay;
+    unsigned tokens;
+    /* the channel whose driver the edge starts or ends at, or nullptr */
+    act_connection *channel;
+    bool backward;
+  } Edge;
+
+  StringVec nodeNames;
+
+  Vector<double *> nodeMetrics;
+
+  Vector<bool> nodePipelined;
+
+  unsigned corner;
+
+  double getNodeDelay(unsigned node);
+
+  double getChannelDelay(ChannelInfo &channelInfo);
+
+  Map<act_connection *, ChannelInfo> channels;
+
+  ChannelInfo &getChannel(act_connection *channel);
+
+  void connect(Vector<Edge> &edges,
+               unsigned from,
+               unsigned to,
+               act_connection *channel,
+               ChannelInfo *channelInfo);
+
+  Vector<Edge> buildEdges();
+
+  Vector<int> findComponents(Vector<Edge> &edges);
+
+  /* the cycles below are lists of edge indices */
+  bool findZeroTokenCycle(Vector<Edge> &edges, UIntVec &cycle);
+
+  double runHoward(Vector<Edge> &edges, UIntVec &cycle);
+
+  /* cycle time and critical cycle over the edges that can be on a cycle */
+  double findCriticalCycle(Vector<Edge> &edges, UIntVec &cycle);
+
+  String printCycle(Vector<Edge> &edges, UIntVec &cycle);
+};
+
+#endif //DFLOWMAP_SRC_CORE_THROUGHPUTANALYZER_H_
@@ -0,0 +1,196 @@
+/*
+ * This file is part of the ACT library
+ *
+ * Copyright (c) 2021 Rui Li
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+
+#include <csignal>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "src/common/Helper.h"
+#include "src/common/config.h"
+#include "src/core/CacheBackend.h"
+
+/* Cache server for the FU cache of dflowmap (see RemoteCacheBackend for the
+ * protocol); the entries are kept in a cache directory of its own. */
+
+int debug_verbose;
+
+static unsigned long maxBytes;
+
+static unsigned maxEntries;
+
+static LocalCacheBackend *cache;
+
+/* # of entries stored since the last compaction */
+static unsigned numPuts;
+
+static std::mutex compactMutex;
+
+/* compact the cache after this many new entries */
+#define COMPACT_INTERVAL 64
+
+static void usage(char *name) {
+  fprintf(stderr,
+          "Usage: %s [-v] [-c <MB>] [-n <entries>] <cache dir> <address>\n",
+          name);
+  fprintf(stderr,
+          " <address> : unix:<socket path> or tcp:[<host>]:<port> to listen on\n");
+  fprintf(stderr,
+          " -c <MB> : evict least recently used entries beyond <MB> megabytes (default unbounded)\n");
+  fprintf(stderr,
+          " -n <entries> : keep at most <entries> entries (default unbounded)\n");
+  fprintf(stderr, " -v : increase verbosity\n");
+  exit(1);
+}
+
+static bool handlePut(int fd, const char *fuKey, const char *sizes) {
+  unsigned long entryLen, netlistLen;
+  String entry, netlist;
+  if ((sscanf(sizes, "%lu %lu", &entryLen, &netlistLen) != 2)
+      || (entryLen > MAX_CACHE_PAYLOAD) || (netlistLen > MAX_CACHE_PAYLOAD)
+      || !RemoteCacheBackend::recvAll(fd, entry, entryLen)
+      || !RemoteCacheBackend::recvAll(fd, netlist, netlistLen)) {
+    return false;
+  }
+  /* the first client to store an entry wins */
+  int lockFd = cache->lock(fuKey);
+  String oldEntry;
+  bool stored = false;
+  if (!cache->getEntry(fuKey, oldEntry)) {
+    cache->put(fuKey, entry, netlist);
+    cache->flush();
+    stored = true;
+  }
+  unlockFile(lockFd);
+  if (debug_verbose) {
+    printf("PUT %s%s\n", fuKey, stored ? "" : " (already cached)");
+  }
+  if (stored && ((maxBytes > 0) || (maxEntries > 0))) {
+    std::lock_guard<std::mutex> guard(compactMutex);
+    if (++numPuts >= COMPACT_INTERVAL) {
+      numPuts = 0;
+      cache->compact(maxBytes, maxEntries);
+    }
+  }
+  return RemoteCacheBackend::sendAll(fd, "OK\n", 3);
+}
+
+static bool handleGet(int fd, const char *fuKey) {
+  String entry, netlist;
+  if (!cache->get(fuKey, entry, netlist)) {
+    if (debug_verbose) {
+      printf("GET %s: miss\n", fuKey);
+    }
+    return RemoteCacheBackend::sendAll(fd, "MISS\n", 5);
+  }
+  cache->touch(fuKey);
+  if (debug_verbose) {
+    printf("GET %s: hit\n", fuKey);
+  }
+  char reply[64];
+  snprintf(reply, sizeof(reply), "HIT %zu %zu\n", entry.size(),
+           netlist.size());
+  return RemoteCacheBackend::sendAll(fd, reply, strlen(reply))
+      && RemoteCacheBackend::sendAll(fd, entry.c_str(), entry.size())
+      && RemoteCacheBackend::sendAll(fd, netlist.c_str(), netlist.size());
+}
+
+static void serveClient(int fd) {
+  String request;
+  while (RemoteCacheBackend::recvLine(fd, request)) {
+    char cmd[8];
+    char fuKey[128];
+    int pos = 0;
+    if ((sscanf(request.c_str(), "%7s %127s %n", cmd, fuKey, &pos) < 2)
+        || !CacheBackend::isValidKey(fuKey)) {
+      break;
+    }
+    bool ok;
+    if (!strcmp(cmd, "GET")) {
+      ok = handleGet(fd, fuKey);
+    } else if (!strcmp(cmd, "PUT")) {
+      ok = handlePut(fd, fuKey, request.c_str() + pos);
+    } else {
+      ok = false;
+    }
+    if (!ok) break;
+  }
+  close(fd);
+}
+
+int main(int argc, char **argv) {
+  int ch;
+  debug_verbose = 0;
+  maxBytes = 0;
+  maxEntries = 0;
+  numPuts = 0;
+  while ((ch = getopt(argc, argv, "vc:n:")) != -1) {
+    switch (ch) {
+      case 'v':debug_verbose++;
+        break;
+      case 'c':
+        if (!parseCount(optarg, 20, ULONG_MAX, maxBytes)) {
+          usage(argv[0]);
+        }
+        break;
+      case 'n': {
+        unsigned long numEntries;
+        if (!parseCount(optarg, 0, UINT_MAX, numEntries)) {
+          usage(argv[0]);
+        }
+        maxEntries = numEntries;
+        break;
+      }
+      case '?':
+      default:usage(argv[0]);
+        break;
+    }
+  }
+  if (optind != argc - 2) {
+    usage(argv[0]);
+  }
+  const char *dir = argv[optind];
+  const char *address = argv[optind + 1];
+  signal(SIGPIPE, SIG_IGN);
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+  cache = new LocalCacheBackend(dir);
+  cache->compact(maxBytes, maxEntries);
+  int listenFd = RemoteCacheBackend::listenOn(address);
+  if (listenFd < 0) {
+    printf("Could not listen on %s!\n", address);
+    exit(-1);
+  }
+  printf("Serve the FU cache %s on %s\n", dir, address);
+  fflush(stdout);
+  while (true) {
+    int fd = accept(listenFd, nullptr, nullptr);
+    if (fd < 0) {
+      continue;
+    }
+    std::thread(serveClient, fd).detach();
+  }
+  return 0;
+}
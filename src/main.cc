@@ -19,6 +19,7 @@
  * Boston, MA  02110-1301, USA.
  */
 
+#include <climits>
 #include <cstdio>
 #include <cstring>
 #include <unistd.h>
@@ -30,32 +31,100 @@
 #include <algorithm>
 #include "DflowMapPass.h"
 #include "src/core/Metrics.h"
+#include "src/common/OutputStream.h"
 
 int debug_verbose;
 bool invalidate_cache;
 bool quiet_mode;
 char *outputDir;
 char *cache_dir;
+char *proc_cache_dir;
+unsigned long cache_max_bytes;
+unsigned cache_max_entries;
+char *cache_server;
+double target_cycle_time;
+int pipeline_mode;
+double pipeline_area_budget;
 char *cached_metrics;
 char *custom_metrics;
 char *custom_fu_dir;
+unsigned num_corners;
+char **corner_names;
+
+/* every generated file, closed at the end of main */
+static Vector<OutputStream *> outputStreams;
+
+static FILE *open_outfile(const char *path) {
+  OutputStream *stream = OutputStream::openFile(path);
+  if (!stream) {
+    fatal_error("Could not open file `%s' for writing", path);
+  }
+  outputStreams.push_back(stream);
+  return stream->getFp();
+}
 
 static void usage(char *name) {
-  fprintf(stderr, "Usage: %s [-qiv] [-p <procname>] [-m <metrics>] <actfile>\n", name);
+  fprintf(stderr, "Usage: %s [-qiv] [-j <jobs>] [-c <MB>] [-n <entries>] [-r <cache>] [-t <ps>] [-P <mode>] [-A <um2>] [-a <log>] [-C <corners>] [-p <procname>] [-m <metrics>] <actfile>\n", name);
   fprintf(stderr,
           " -m <metrics> : provide file name for energy/delay/area metrics\n");
   fprintf(stderr,
           " -p <process>: specify the top-level process; unexpanded process allowed\n");
   fprintf(stderr, " -v : increase verbosity (default 1)\n");
   fprintf(stderr, " -q : quiet mode CHP output (no auto-generated log statements)\n");
-  fprintf(stderr, " -i : invalidate dflowmap cache (default false)\n");
+  fprintf(stderr, " -i : invalidate dflowmap cache and remap every process (default false)\n");
+  fprintf(stderr,
+          " -c <MB> : evict least recently used cache entries beyond <MB> megabytes (default unbounded)\n");
+  fprintf(stderr,
+          " -n <entries> : keep at most <entries> FUs in the cache (default unbounded)\n");
+  fprintf(stderr,
+          " -r <cache> : share FUs through a cache server (unix:<path> or tcp:<host>:<port>) or directory\n");
+  fprintf(stderr,
+          " -t <ps> : insert buffers on reconvergent paths to reach a cycle time of <ps> picoseconds\n");
+  fprintf(stderr,
+          " -P <mode> : unpipe (default), pipe, or explore: pipeline only the merges, splits, mixers and arbiters that speed up their process, up to the cycle time of -t and the area of -A\n");
+  fprintf(stderr,
+          " -A <um2> : area the pipelined units may add to a process with -P explore (default unbounded)\n");
+  fprintf(stderr,
+          " -a <log> : estimate the dynamic energy from the actsim log of a simulation of the generated CHP\n");
+  fprintf(stderr,
+          " -C <corners> : comma-separated process corners (default typ); corner X other than typ reads the metric files with _X before their extension, the first corner drives the mapping and the others get <name>_X.stat/.conf\n");
+  fprintf(stderr,
+          " -j <jobs> : run up to <jobs> logic optimizer and mapping jobs in parallel (default 1)\n");
   exit(1);
 }
 
+/* split the comma-separated list of corners into corner_names */
+static bool parse_corners(const char *corners) {
+  num_corners = 0;
+  corner_names = new char *[MAX_CORNERS];
+  const char *start = corners;
+  while (true) {
+    const char *end = strchr(start, ',');
+    size_t len = end ? (size_t) (end - start) : strlen(start);
+    if ((len == 0) || (num_corners == MAX_CORNERS)) {
+      return false;
+    }
+    char *name = new char[len + 1];
+    snprintf(name, len + 1, "%s", start);
+    for (unsigned i = 0; i < num_corners; i++) {
+      if (strcmp(corner_names[i], name) == 0) {
+        return false;
+      }
+    }
+    corner_names[num_corners++] = name;
+    if (!end) {
+      return true;
+    }
+    start = end + 1;
+  }
+}
+
 static void create_outfiles(char *&statsFilePath,
+                            Vector<char *> &cornerStatsFilePaths,
                             FILE **chpFp,
                             FILE **chpLibfp,
                             FILE **conffp,
+                            Vector<FILE *> &cornerConfFps,
 #if GEN_NETLIST
                             FILE **netlistFp,
                             FILE **netlistLibFp,
@@ -104,8 +173,14 @@ static void create_outfiles(char *&statsFilePath,
   }
   custom_metrics = new char[16 + strlen(custom_fu_dir)];
   sprintf(custom_metrics, "%s/fu.metrics", custom_fu_dir);
+  proc_cache_dir = new char[16 + outputPathLen];
+  sprintf(proc_cache_dir, "%s/procs", outputDir);
+  if (invalidate_cache) {
+    removeDirectoryIfExist(proc_cache_dir);
+  }
   createDirectoryIfNotExist(outputDir);
   createDirectoryIfNotExist(custom_fu_dir);
+  createDirectoryIfNotExist(proc_cache_dir);
   createFileIfNotExist(custom_metrics, std::fstream::app);
   char *errMsg = new char[128];
   sprintf(errMsg, "Fail to copy raw input ACT file into the output dir!\n");
@@ -116,18 +191,12 @@ static void create_outfiles(char *&statsFilePath,
   /* generate chp file */
   char *chp_file = new char[outputPathLen + workloadNameLen + 16];
   sprintf(chp_file, "%s/%s_chp.act", outputDir, workload_name);
-  *chpFp = fopen(chp_file, "w");
-  if (!*chpFp) {
-    fatal_error("Could not open file `%s' for writing", chp_file);
-  }
+  *chpFp = open_outfile(chp_file);
   fprintf(*chpFp, "import \"%s_chplib.act\";\n\n", workload_name);
   /* generate chp lib file */
   char *chp_lib = new char[outputPathLen + workloadNameLen + 16];
   sprintf(chp_lib, "%s/%s_chplib.act", outputDir, workload_name);
-  *chpLibfp = fopen(chp_lib, "w");
-  if (!*chpLibfp) {
-    fatal_error("Could not open file `%s' for writing", chp_lib);
-  }
+  *chpLibfp = open_outfile(chp_lib);
   fprintf(*chpLibfp, R"(import globals;
 import std;
 import std::cells;
@@ -141,18 +210,26 @@ open dflow_std::dflow_stdlib;
   /* create configuration file */
   char *conf_file = new char[outputPathLen + workloadNameLen + 16];
   sprintf(conf_file, "%s/%s.conf", outputDir, workload_name);
-  *conffp = fopen(conf_file, "w");
-  if (!*conffp) {
-    fatal_error("Could not open file `%s' for writing", conf_file);
+  *conffp = open_outfile(conf_file);
+  /* the corners after corner 0 are named after the corner */
+  for (unsigned c = 1; c < num_corners; c++) {
+    size_t cornerLen = strlen(corner_names[c]);
+    char *cornerStats =
+        new char[outputPathLen + workloadNameLen + cornerLen + 16];
+    sprintf(cornerStats, "%s/%s_%s.stat", outputDir, workload_name,
+            corner_names[c]);
+    cornerStatsFilePaths.push_back(cornerStats);
+    char *cornerConf =
+        new char[outputPathLen + workloadNameLen + cornerLen + 16];
+    sprintf(cornerConf, "%s/%s_%s.conf", outputDir, workload_name,
+            corner_names[c]);
+    cornerConfFps.push_back(open_outfile(cornerConf));
   }
 #if GEN_NETLIST
   /* generate netlist file */
   char *netlist_lib = new char[outputPathLen + workloadNameLen + 16];
   sprintf(netlist_lib, "%s/%s_netlib.act", outputDir, workload_name);
-  *netlistLibFp = fopen(netlist_lib, "w");
-  if (!*netlistLibFp) {
-    fatal_error("Could not open file `%s' for writing", netlist_lib);
-  }
+  *netlistLibFp = open_outfile(netlist_lib);
   fprintf(*netlistLibFp,
           "import \"%s_netlist_include.act\";\n\n",
           workload_name);
@@ -162,10 +239,7 @@ open dflow_std::dflow_stdlib;
           "%s/%s_netlist_include.act",
           outputDir,
           workload_name);
-  *netlistIncludeFp = fopen(netlist_include, "w");
-  if (!*netlistIncludeFp) {
-    fatal_error("Could not open file `%s' for writing", netlist_include);
-  }
+  *netlistIncludeFp = open_outfile(netlist_include);
   fprintf(*netlistIncludeFp, R"(import globals;
 import std;
 import std::cells;
@@ -181,10 +255,7 @@ open dflow_std::dflow_stdlib_refine;
   /* generate netlist file */
   char *netlist_file = new char[outputPathLen + workloadNameLen + 16];
   sprintf(netlist_file, "%s/%s_netlist.act", outputDir, workload_name);
-  *netlistFp = fopen(netlist_file, "w");
-  if (!*netlistFp) {
-    fatal_error("Could not open file `%s' for writing", netlist_file);
-  }
+  *netlistFp = open_outfile(netlist_file);
   fprintf(*netlistFp, "import \"%s_chp.act\";\n", workload_name);
   fprintf(*netlistFp, "import \"%s_netlib.act\";\n\n", workload_name);
 #endif
@@ -214,7 +285,8 @@ open dflow_std::dflow_stdlib_refine;
 }
 
 static Metrics *createMetrics(const char *metricFile,
-                              const char *statsFilePath) {
+                              const char *statsFilePath,
+                              Vector<char *> &cornerStatsFilePaths) {
   size_t metricFPLen = (metricFile) ? 1 + strlen(metricFile) : MAX_INSTANCE_LEN;
   char *customFUMetricsFP = new char[metricFPLen];
   if (metricFile) {
@@ -230,20 +302,71 @@ static Metrics *createMetrics(const char *metricFile,
   auto metrics = new Metrics(customFUMetricsFP,
                              stdFUMetricsFP,
                              statsFilePath);
-  metrics->readMetricsFile();
+  for (unsigned c = 1; c < num_corners; c++) {
+    metrics->setCornerStatistics(c, cornerStatsFilePaths[c - 1]);
+  }
+  metrics->openMetricsDB();
   return metrics;
 }
 
+/* the metric of every expanded process of the mem namespace */
+static void getMemMetrics(ActNamespace *ns,
+                          Metrics *metrics,
+                          Map<Process *, double *> &memMetrics) {
+  if (strcmp(ns->getName(), Constant::MEM_NAMESPACE) != 0) return;
+  ActTypeiter it(ns);
+  for (it = it.begin(); it != it.end(); it++) {
+    auto p = dynamic_cast<Process *>(*it);
+    if (!p || !p->isExpanded()) continue;
+    memMetrics.insert({p, metrics->getOrGenMemMetric(p)});
+  }
+}
+
+/* add every instance of a mem process in the design under sc, which is
+ * instantiated numInstances times, to the statistics */
+static void addMemInstances(Scope *sc,
+                            unsigned numInstances,
+                            Metrics *metrics,
+                            Map<Process *, double *> &memMetrics) {
+  ActInstiter inst(sc);
+  for (inst = inst.begin(); inst != inst.end(); inst++) {
+    ValueIdx *vx = *inst;
+    auto subProc = dynamic_cast<Process *>(vx->t->BaseType());
+    if (!subProc) continue;
+    unsigned num = numInstances;
+    if (vx->t->arrayInfo()) {
+      num *= vx->t->arrayInfo()->size();
+    }
+    auto memMetricsIt = memMetrics.find(subProc);
+    if (memMetricsIt == memMetrics.end()) {
+      addMemInstances(subProc->CurScope(), num, metrics, memMetrics);
+    } else if (memMetricsIt->second) {
+      for (unsigned i = 0; i < num; i++) {
+        metrics->updateMemStatistics(subProc, memMetricsIt->second);
+      }
+    }
+  }
+}
+
 int main(int argc, char **argv) {
   int ch;
   char *mfile = nullptr;
   char *procname = nullptr;
+  char *activityFile = nullptr;
+  char *corners = nullptr;
+  int numJobs = 1;
   /* initialize ACT library */
   Act::Init(&argc, &argv);
   debug_verbose = 0;
   invalidate_cache = false;
   quiet_mode = false;
-  while ((ch = getopt(argc, argv, "vqm:p:i")) != -1) {
+  cache_max_bytes = 0;
+  cache_max_entries = 0;
+  cache_server = nullptr;
+  target_cycle_time = 0;
+  pipeline_mode = PIPELINE_NONE;
+  pipeline_area_budget = 0;
+  while ((ch = getopt(argc, argv, "vqm:p:ij:c:n:r:t:P:A:a:C:")) != -1) {
     switch (ch) {
       case 'q': 
         quiet_mode = true;
@@ -265,6 +388,66 @@ int main(int argc, char **argv) {
       case 'i':
         invalidate_cache = true;
         break;;
+      case 'j':
+        numJobs = atoi(optarg);
+        if (numJobs < 1) {
+          usage(argv[0]);
+        }
+        break;
+      case 'c':
+        if (!parseCount(optarg, 20, ULONG_MAX, cache_max_bytes)) {
+          usage(argv[0]);
+        }
+        break;
+      case 'n': {
+        unsigned long numEntries;
+        if (!parseCount(optarg, 0, UINT_MAX, numEntries)) {
+          usage(argv[0]);
+        }
+        cache_max_entries = numEntries;
+        break;
+      }
+      case 'r':
+        if (cache_server) {
+          FREE (cache_server);
+        }
+        cache_server = Strdup(optarg);
+        break;
+      case 't':
+        target_cycle_time = atof(optarg);
+        if (target_cycle_time <= 0) {
+          usage(argv[0]);
+        }
+        break;
+      case 'P':
+        if (!strcmp(optarg, "unpipe")) {
+          pipeline_mode = PIPELINE_NONE;
+        } else if (!strcmp(optarg, "pipe")) {
+          pipeline_mode = PIPELINE_ALL;
+        } else if (!strcmp(optarg, "explore")) {
+          pipeline_mode = PIPELINE_EXPLORE;
+        } else {
+          usage(argv[0]);
+        }
+        break;
+      case 'A':
+        pipeline_area_budget = atof(optarg);
+        if (pipeline_area_budget <= 0) {
+          usage(argv[0]);
+        }
+        break;
+      case 'a':
+        if (activityFile) {
+          FREE (activityFile);
+        }
+        activityFile = Strdup(optarg);
+        break;
+      case 'C':
+        if (corners) {
+          FREE (corners);
+        }
+        corners = Strdup(optarg);
+        break;
       case '?':
       default:usage(argv[0]);
         break;
@@ -274,6 +457,9 @@ int main(int argc, char **argv) {
     usage(argv[0]);
   }
   char *act_file = argv[optind];
+  if (!parse_corners(corners ? corners : "typ")) {
+    usage(argv[0]);
+  }
 
   /* read in the ACT file */
   Act *a = new Act(act_file);
@@ -299,16 +485,20 @@ int main(int argc, char **argv) {
     printf("\n\n\n");
   }
   FILE *chpFp, *chpLibFp, *confFp;
+  Vector<FILE *> cornerConfFps;
 #if GEN_NETLIST
   FILE *netlistFp, *netlistLibFp, *netlistIncludeFp;
 #endif
   char *statsFilePath = nullptr;
+  Vector<char *> cornerStatsFilePaths;
 
   create_outfiles(
       statsFilePath,
+      cornerStatsFilePaths,
       &chpFp,
       &chpLibFp,
       &confFp,
+      cornerConfFps,
 #if GEN_NETLIST
       &netlistFp,
       &netlistLibFp,
@@ -316,9 +506,13 @@ int main(int argc, char **argv) {
 #endif
       act_file);
 
-  Metrics *metrics = createMetrics(mfile, statsFilePath);
+  Metrics *metrics =
+      createMetrics(mfile, statsFilePath, cornerStatsFilePaths);
   auto chpGenerator = new ChpGenerator(chpFp);
   auto chpLibGenerator = new ChpLibGenerator(chpLibFp, chpFp, confFp);
+  for (auto &cornerConfFp: cornerConfFps) {
+    chpLibGenerator->addCornerConf(cornerConfFp);
+  }
 #if GEN_NETLIST
   auto dflowNetGenerator = new DflowNetGenerator(netlistFp);
   auto dflowNetLibGenerator =
@@ -330,22 +524,59 @@ int main(int argc, char **argv) {
   auto backend = new ChpBackend(chpGenerator, chpLibGenerator);
 #endif
 
-  /* declare custom namespace */
+  /* declare custom namespace; the metric of a mem process is computed
+   * once, and added to the statistics for each of its instances */
+  Map<Process *, double *> memMetrics;
   ActNamespaceiter i(a->Global());
   for (i = i.begin(); i != i.end(); i++) {
     ActNamespace *ns = *i;
     if (!ns) continue;
     if (!ns->isExported()) {
-      backend->printCustomNamespace(ns);
+      getMemMetrics(ns, metrics, memMetrics);
+      backend->printCustomNamespace(ns, memMetrics);
     }
   }
-  /* generate chp implementation for each act process */
+  if (metrics->validMetrics()) {
+    /* without -p, the design is every top-level instance */
+    Scope *topScope =
+        spec_proc ? spec_proc->CurScope() : a->Global()->CurScope();
+    addMemInstances(topScope, 1, metrics, memMetrics);
+  }
+  /* characterize the custom FUs with parallel logic optimizer jobs first, so
+   * that the mapping pass below finds all of their metrics */
+  if (LOGIC_OPTIMIZER && (numJobs > 1)) {
+    auto collect_pass =
+        new DflowMapPass(a, "dflowmap_collect", metrics, backend, true);
+    collect_pass->run(spec_proc);
+    metrics->runFUJobs(numJobs);
+  }
+  /* generate chp implementation for each act process, reusing the output of
+   * the processes that have not changed since the last run; with several
+   * jobs, the others are mapped in forked workers */
   auto dflowmap_pass = new DflowMapPass(a, "dflowmap", metrics, backend);
-  dflowmap_pass->run(spec_proc);
+  if (GEN_NETLIST || (numJobs <= 1)) {
+    /* the netlist backend writes its own files directly, so it maps every
+     * process in this process */
+    dflowmap_pass->run(spec_proc);
+  } else {
+    dflowmap_pass->runParallel(spec_proc, numJobs);
+  }
   backend->printFileEnding();
 
   if (metrics->validMetrics()) {
+    if (activityFile) {
+      auto activityLog =
+          new ActivityLog(backend->getInstanceRecords(), spec_proc);
+      activityLog->read(activityFile);
+      metrics->setActivityLog(activityLog);
+    }
     metrics->dump();
+    metrics->flushMetricFiles();
+    metrics->compactCache();
+  }
+
+  for (auto &stream: outputStreams) {
+    stream->close();
   }
 
   if (dflowmap_pass->numTranslated() == 0) {